@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace dxiided {
+
+// Runtime toggles read once from the environment.
+class Config {
+   public:
+    static const Config& Instance();
+
+    // DXIIDED_LAZY_RESOURCES=0 creates D3D11 resources up front
+    bool LazyResources() const { return m_lazyResources; }
+
+    // DXIIDED_BACKGROUND_CREATE=1 creates large lazy resources on a worker
+    // thread instead of waiting for their first use
+    bool BackgroundCreate() const { return m_backgroundCreate; }
+    uint64_t BackgroundCreateMinSize() const {
+        return m_backgroundCreateMinSize;
+    }
+
+    // DXIIDED_MEMORY_STATS_INTERVAL logs memory use every that many
+    // submissions, 0 disables it; DXIIDED_MEMORY_STATS_ON_EXIT=1 also logs
+    // it, with high-water marks, when the process exits
+    uint64_t MemoryStatsInterval() const { return m_memoryStatsInterval; }
+    bool MemoryStatsOnExit() const { return m_memoryStatsOnExit; }
+
+    // DXIIDED_ASYNC_PSO=1 returns pipeline states at once and compiles them
+    // on DXIIDED_PSO_COMPILE_THREADS workers, 0 for half the cores
+    bool AsyncPipelineCompile() const { return m_asyncPipelineCompile; }
+    uint64_t PipelineCompileThreads() const {
+        return m_pipelineCompileThreads;
+    }
+
+    // DXIIDED_PIPELINE_CACHE_PATH keeps pipeline states in that file across
+    // runs, unset disables it; DXIIDED_PIPELINE_CACHE_PREWARM=0 skips
+    // compiling the cached states in the background at device creation
+    const std::string& PipelineCachePath() const { return m_pipelineCachePath; }
+    bool PipelineCachePrewarm() const { return m_pipelineCachePrewarm; }
+
+   private:
+    Config();
+
+    static bool GetEnvBool(const char* name, bool defaultValue);
+    static uint64_t GetEnvUInt(const char* name, uint64_t defaultValue);
+    static std::string GetEnvString(const char* name);
+
+    bool m_lazyResources;
+    bool m_backgroundCreate;
+    uint64_t m_backgroundCreateMinSize;
+    uint64_t m_memoryStatsInterval;
+    bool m_memoryStatsOnExit;
+    bool m_asyncPipelineCompile;
+    uint64_t m_pipelineCompileThreads;
+    std::string m_pipelineCachePath;
+    bool m_pipelineCachePrewarm;
+};
+
+}  // namespace dxiided
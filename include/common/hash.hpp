@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dxiided {
+
+struct Hash128 {
+    uint64_t lo{0};
+    uint64_t hi{0};
+
+    bool operator==(const Hash128& other) const {
+        return lo == other.lo && hi == other.hi;
+    }
+    bool operator!=(const Hash128& other) const { return !(*this == other); }
+};
+
+struct Hash128Hasher {
+    size_t operator()(const Hash128& hash) const {
+        return static_cast<size_t>(hash.lo);
+    }
+};
+
+// Streaming MurmurHash3 x64_128. Input is consumed in 16-byte blocks, so
+// the result only depends on the bytes fed in, not on how they were split
+// across Update calls.
+class Hasher128 {
+   public:
+    void Update(const void* data, size_t size);
+
+    template <typename T>
+    void UpdateValue(const T& value) {
+        Update(&value, sizeof(value));
+    }
+
+    // Includes the terminator so adjacent strings can't run together,
+    // null hashes like an empty string
+    void UpdateString(const char* str);
+
+    Hash128 Finalize() const;
+
+   private:
+    void ProcessBlock(const uint8_t* block);
+
+    uint64_t m_h1{0};
+    uint64_t m_h2{0};
+    uint64_t m_length{0};
+    uint8_t m_tail[16];
+    size_t m_tailSize{0};
+};
+
+Hash128 ComputeHash128(const void* data, size_t size);
+
+}  // namespace dxiided
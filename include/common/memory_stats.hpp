@@ -0,0 +1,81 @@
+#pragma once
+
+#include <windows.h>
+#include <initguid.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace dxiided {
+
+// Memory the layer holds on behalf of the application, by what it is for.
+// GPU resources are split by the D3D12 heap type they were created on.
+enum class MemoryCategory : uint32_t {
+    DefaultHeap,
+    UploadHeap,
+    ReadbackHeap,
+    CustomHeap,
+    UploadShadow,
+    UploadStaging,
+    ReadbackShadow,
+    ReadbackStaging,
+    TransientPool,
+    ScratchBuffers,
+    TilePool,
+    DescriptorHeaps,
+    ViewCache,
+    PipelineStateCache,
+    ShaderModules,
+    Count
+};
+
+constexpr UINT kMemoryCategoryCount =
+    static_cast<UINT>(MemoryCategory::Count);
+
+struct MemoryCounter {
+    UINT64 current;
+    UINT64 peak;
+};
+
+// Process-wide byte counters with high-water marks, updated at every
+// allocation and free of the memory they describe.
+class MemoryStats {
+   public:
+    static MemoryStats& Instance();
+
+    void Add(MemoryCategory category, UINT64 bytes);
+    void Remove(MemoryCategory category, UINT64 bytes);
+    MemoryCounter Get(MemoryCategory category) const;
+    static const char* GetName(MemoryCategory category);
+
+    // Writes every category that was ever used on one log line
+    void Log() const;
+
+    // Logs at the interval set by DXIIDED_MEMORY_STATS_INTERVAL
+    void OnSubmitted(UINT64 serial);
+
+   private:
+    MemoryStats();
+    ~MemoryStats();
+
+    std::atomic<UINT64> m_current[kMemoryCategoryCount] = {};
+    std::atomic<UINT64> m_peak[kMemoryCategoryCount] = {};
+    std::atomic<UINT64> m_lastLogSerial{0};
+};
+
+// Private interface of the D3D12 device for reading the counters, e.g.
+// from a debugging overlay
+DEFINE_GUID(IID_IDxiidedMemoryStats,
+    0x9d1a6c53, 0x2f0e, 0x4b8a,
+    0xb6, 0x41, 0x7c, 0x3e, 0x52, 0x98, 0x0d, 0xe4);
+
+interface IDxiidedMemoryStats : IUnknown {
+    // Copies up to *pCount counters, indexed by MemoryCategory, and
+    // returns the number of categories in *pCount
+    virtual HRESULT STDMETHODCALLTYPE GetMemoryCounters(
+        UINT* pCount, MemoryCounter* pCounters) = 0;
+    virtual const char* STDMETHODCALLTYPE GetMemoryCategoryName(
+        UINT category) = 0;
+};
+
+}  // namespace dxiided
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+namespace dxiided {
+
+// First-fit allocator over a linear range of units, such as the tiles of a
+// tile pool. It only does the bookkeeping; the owner grows the backing
+// memory and hands the new units over with AddFree.
+class RangeAllocator {
+   public:
+    // Reserves count consecutive units, false if no free range fits
+    bool Allocate(uint32_t count, uint32_t* first);
+    // Returns units, merging them with neighbouring free ranges
+    void AddFree(uint32_t first, uint32_t count);
+
+    size_t GetFreeRangeCount() const { return m_freeRanges.size(); }
+
+   private:
+    // Free unit counts keyed by first unit, neighbours are always merged
+    std::map<uint32_t, uint32_t> m_freeRanges;
+};
+
+}  // namespace dxiided
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dxiided {
+
+// Chooses which of a small ring of buffer versions the next upload writes,
+// from the submission serial that last read each version. It never touches
+// the buffers; the owner creates one whenever Grow adds a version.
+class VersionRing {
+   public:
+    // Flushed, but not yet part of a submission
+    static constexpr uint64_t kUnsubmittedSerial = ~0ull;
+    static constexpr size_t kNoVersion = ~size_t{0};
+
+    explicit VersionRing(size_t maxVersions) : m_maxVersions(maxVersions) {}
+
+    size_t GetCount() const { return m_serials.size(); }
+    bool CanGrow() const { return m_serials.size() < m_maxVersions; }
+    uint64_t GetSerial(size_t version) const { return m_serials[version]; }
+
+    // Next version in ring order whose last reader has completed, or
+    // kNoVersion if every version is in flight
+    size_t AcquireIdle(uint64_t completedSerial);
+    // Adds an idle version and returns it
+    size_t Grow();
+    // Version with the oldest submitted reader, which the caller has to wait
+    // for. kNoVersion if every version still awaits submission.
+    size_t AcquireOldest();
+
+    void MarkFlushed(size_t version) {
+        m_serials[version] = kUnsubmittedSerial;
+    }
+    void MarkSubmitted(size_t version, uint64_t serial) {
+        m_serials[version] = serial;
+    }
+
+   private:
+    const size_t m_maxVersions;
+    std::vector<uint64_t> m_serials;
+    size_t m_next{0};
+};
+
+}  // namespace dxiided
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <d3d12.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "common/debug.hpp"
+
+namespace dxiided {
+
+// Field-wise hashing and comparison, the struct has padding
+struct ResourceDescHash {
+    size_t operator()(const D3D12_RESOURCE_DESC& desc) const;
+};
+
+struct ResourceDescEqual {
+    bool operator()(const D3D12_RESOURCE_DESC& a,
+                    const D3D12_RESOURCE_DESC& b) const;
+};
+
+// Size and alignment a resource would take when placed in a heap, following
+// the D3D12 placement rules: 64 KB by default, 4 KB for small textures that
+// ask for it, 4 MB for MSAA unless a small one asks for 64 KB. Results are
+// memoized per desc since engines query the same descs over and over.
+class AllocationInfoCache {
+   public:
+    static constexpr size_t kMaxEntries = 4096;
+
+    AllocationInfoCache();
+    ~AllocationInfoCache();
+
+    // Combined info for resources packed back to back in one heap
+    D3D12_RESOURCE_ALLOCATION_INFO GetInfo(UINT numDescs,
+                                           const D3D12_RESOURCE_DESC* descs);
+    D3D12_RESOURCE_ALLOCATION_INFO GetInfo(const D3D12_RESOURCE_DESC& desc);
+
+    static D3D12_RESOURCE_ALLOCATION_INFO Calculate(
+        const D3D12_RESOURCE_DESC& desc);
+
+   private:
+    std::mutex m_mutex;
+    std::unordered_map<D3D12_RESOURCE_DESC, D3D12_RESOURCE_ALLOCATION_INFO,
+                       ResourceDescHash, ResourceDescEqual>
+        m_cache;
+};
+
+// Copyable footprints of a subresource range, laid out from offset 0
+struct FootprintSet {
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts;
+    std::vector<UINT> numRows;
+    std::vector<UINT64> rowSizes;
+    UINT64 totalBytes{0};
+};
+
+// Backs GetCopyableFootprints. Each plane and mip's pitch and row count is
+// computed once per desc and every subresource in the range reuses it; sets
+// are memoized whole since streamers ask for the same chains over and over.
+class FootprintCache {
+   public:
+    static constexpr size_t kMaxEntries = 4096;
+
+    FootprintCache();
+    ~FootprintCache();
+
+    // Null if the range has no copyable layout
+    std::shared_ptr<const FootprintSet> Get(const D3D12_RESOURCE_DESC& desc,
+                                            UINT firstSubresource,
+                                            UINT numSubresources);
+
+    static bool Calculate(const D3D12_RESOURCE_DESC& desc,
+                          UINT firstSubresource, UINT numSubresources,
+                          FootprintSet* set);
+
+   private:
+    struct Key {
+        D3D12_RESOURCE_DESC desc;
+        UINT firstSubresource;
+        UINT numSubresources;
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+    struct KeyEqual {
+        bool operator()(const Key& a, const Key& b) const;
+    };
+
+    std::mutex m_mutex;
+    std::unordered_map<Key, std::shared_ptr<const FootprintSet>, KeyHash,
+                       KeyEqual>
+        m_cache;
+};
+
+}  // namespace dxiided
@@ -8,6 +8,8 @@
 #include <vector>
 #include <atomic>
 #include "common/debug.hpp"
+#include "d3d11_impl/pipeline_state.hpp"
+#include "d3d11_impl/readback_manager.hpp"
 #include "d3d11_impl/resource.hpp"
 
 namespace dxiided {
@@ -21,8 +23,20 @@ class WrappedD3D12ToD3D11CommandList final : public ID3D12GraphicsCommandList {
                           ID3D12PipelineState* initial_state, REFIID riid,
                           void** command_list);
 
-    // Get the native D3D11 command list
-    HRESULT GetD3D11CommandList(ID3D11CommandList** ppCommandList);
+    // Plays the recorded commands on the immediate context, closing the
+    // list first if it is still open
+    HRESULT Execute(ID3D11DeviceContext* immediate);
+
+    // Readback copies recorded since the last Reset, queued on every submit
+    const std::vector<ReadbackCopy>& GetPendingReadbacks() const {
+        return m_readbackCopies;
+    }
+    void OnSubmitted(UINT64 serial) { m_lastSubmittedSerial = serial; }
+
+    // Resources this list touches directly, for residency tracking
+    const std::vector<WrappedD3D12ToD3D11Resource*>& GetResidencyUses() const {
+        return m_residencyUses;
+    }
 
     // IUnknown methods
     HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid,
@@ -243,7 +257,68 @@ class WrappedD3D12ToD3D11CommandList final : public ID3D12GraphicsCommandList {
         WrappedD3D12ToD3D11Device* device,
         D3D12_COMMAND_LIST_TYPE type,
                      Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
-
+    ~WrappedD3D12ToD3D11CommandList();
+
+    // Routes a GPU copy into a readback buffer through pooled staging
+    bool RecordReadbackCopy(WrappedD3D12ToD3D11Resource* dst, UINT64 dstOffset,
+                            ID3D11Resource* src, const D3D11_BOX* srcBox,
+                            UINT size);
+    void ReleaseReadbackStaging();
+    // Texture reads land in a pooled staging texture and are repacked into
+    // the footprint once the submission completes
+    bool RecordTextureReadback(WrappedD3D12ToD3D11Resource* dst,
+                               const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& placed,
+                               UINT dstX, UINT dstY, UINT dstZ,
+                               WrappedD3D12ToD3D11Resource* src,
+                               UINT srcSubresource, const D3D12_BOX* srcBox);
+
+    // A buffer-to-texture copy out of an upload heap, issued at execution
+    // as UpdateSubresource straight from the heap's CPU shadow
+    struct PendingUpload {
+        Microsoft::WRL::ComPtr<ID3D11Resource> dst;
+        Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11Resource> src;
+        UINT subresource;
+        D3D11_BOX box;
+        const uint8_t* data;
+        UINT rowPitch;
+        UINT depthPitch;
+        DXGI_FORMAT format;
+    };
+
+    bool RecordTextureUpload(ID3D11Resource* dst, UINT dstSubresource,
+                             UINT dstX, UINT dstY, UINT dstZ,
+                             WrappedD3D12ToD3D11Resource* src,
+                             const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& placed,
+                             const D3D12_BOX* srcBox);
+    // Uploads are batched until something could observe the destination
+    void FlushTextureUploads();
+
+    // Commands recorded up to a batch of texture uploads. The uploads read
+    // the shadow when the list executes, like D3D12 reads upload heaps.
+    struct Segment {
+        Microsoft::WRL::ComPtr<ID3D11CommandList> commands;
+        std::vector<PendingUpload> uploads;
+    };
+
+    // Back-to-back buffer copies between the same pair of buffers are
+    // merged into one copy, issued once the run ends
+    struct PendingBufferCopy {
+        Microsoft::WRL::ComPtr<ID3D11Buffer> dst;
+        Microsoft::WRL::ComPtr<ID3D11Buffer> src;
+        UINT dstOffset;
+        UINT srcOffset;
+        UINT size;
+    };
+
+    void FlushBufferCopy();
+    void FlushPendingCopies() {
+        FlushBufferCopy();
+        FlushTextureUploads();
+    }
+    void CopyWithinBuffer(ID3D11Buffer* buffer, UINT dstOffset,
+                          UINT srcOffset, UINT size);
+
+    void NoteResidencyUse(ID3D12Resource* resource);
 
     // Helper functions for resource access
     HRESULT GetD3D11Resource(ID3D12Resource* d3d12Resource,
@@ -257,7 +332,33 @@ class WrappedD3D12ToD3D11CommandList final : public ID3D12GraphicsCommandList {
     LONG m_refCount{1};
     bool m_isOpen{true};
     Microsoft::WRL::ComPtr<ID3D11CommandList> m_deferred;
-    Microsoft::WRL::ComPtr<ID3D11CommandList> m_d3d11CommandList;
+    std::vector<Segment> m_segments;
+    std::vector<ReadbackCopy> m_readbackCopies;
+    UINT64 m_lastSubmittedSerial{0};
+    std::vector<PendingUpload> m_pendingUploads;
+    PendingBufferCopy m_pendingBufferCopy{};
+    std::vector<WrappedD3D12ToD3D11Resource*> m_residencyUses;
+    // Last state applied to m_context since it was last cleared
+    Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState> m_boundState;
+    // Set separately in D3D12, but with the state objects in D3D11, so
+    // every blend or depth stencil state switch passes them again
+    FLOAT m_blendFactor[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    UINT m_stencilRef{0};
+
+    // Setter masks of recent pipeline state switches, direct-mapped by the
+    // IDs of the two states. Sorted draw streams cycle through few pairs,
+    // and since IDs are never reused entries stay valid across resets.
+    struct PipelineTransition {
+        UINT64 from{0};
+        UINT64 to{0};
+        uint32_t setters{0};
+    };
+    static constexpr size_t kPipelineTransitionCount = 64;
+    PipelineTransition m_pipelineTransitions[kPipelineTransitionCount];
+
+    uint32_t GetPipelineTransition(
+        const WrappedD3D12ToD3D11PipelineState* previous,
+        WrappedD3D12ToD3D11PipelineState* next);
 };
 
 }  // namespace dxiided
@@ -22,6 +22,7 @@ public:
 
     WrappedD3D12ToD3D11DescriptorHeap(WrappedD3D12ToD3D11Device* device,
                         const D3D12_DESCRIPTOR_HEAP_DESC* desc);
+    ~WrappedD3D12ToD3D11DescriptorHeap();
 
     // IUnknown methods
     HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid,
@@ -10,8 +10,25 @@
 #include <vector>
 #include <mutex>
 #include "common/debug.hpp"
+#include "common/memory_stats.hpp"
+#include "d3d11_impl/allocation_info.hpp"
 #include "d3d11_impl/command_queue.hpp"
 #include "d3d11_impl/device_features.hpp"
+#include "d3d11_impl/format_info.hpp"
+#include "d3d11_impl/gpu_va_mgr.hpp"
+#include "d3d11_impl/pipeline_compiler.hpp"
+#include "d3d11_impl/pipeline_disk_cache.hpp"
+#include "d3d11_impl/pipeline_state.hpp"
+#include "d3d11_impl/readback_manager.hpp"
+#include "d3d11_impl/residency_manager.hpp"
+#include "d3d11_impl/resource_materializer.hpp"
+#include "d3d11_impl/scratch_buffer_pool.hpp"
+#include "d3d11_impl/shader_module_cache.hpp"
+#include "d3d11_impl/state_object_cache.hpp"
+#include "d3d11_impl/submission_tracker.hpp"
+#include "d3d11_impl/tile_pool.hpp"
+#include "d3d11_impl/transient_pool.hpp"
+#include "d3d11_impl/upload_ring.hpp"
 
 namespace dxiided {
 
@@ -20,7 +37,9 @@ class WrappedD3D12ToD3D11CommandQueue;
 
 class WrappedD3D12ToD3D11Device final : public ID3D12Device2,
                          public ID3D12DebugDevice,
-                         public ID3D11Device2 {
+                         public ID3D11Device2,
+                         public IDxiidedMemoryStats,
+                         public IDxiidedPipelineCompiler {
    public:
     static HRESULT Create(IUnknown* adapter,
                           D3D_FEATURE_LEVEL minimum_feature_level, REFIID riid,
@@ -191,6 +210,16 @@ class WrappedD3D12ToD3D11Device final : public ID3D12Device2,
     HRESULT STDMETHODCALLTYPE
     ReportLiveDeviceObjects(D3D12_RLDO_FLAGS Flags) override;
 
+    // IDxiidedMemoryStats methods
+    HRESULT STDMETHODCALLTYPE GetMemoryCounters(
+        UINT* pCount, MemoryCounter* pCounters) override;
+    const char* STDMETHODCALLTYPE GetMemoryCategoryName(
+        UINT category) override;
+
+    // IDxiidedPipelineCompiler methods
+    HRESULT STDMETHODCALLTYPE PrioritizePipelineStates(
+        UINT NumStates, ID3D12PipelineState* const* ppStates) override;
+
     // ID3D11Device methods
     HRESULT STDMETHODCALLTYPE CreateBuffer(const D3D11_BUFFER_DESC* pDesc,
         const D3D11_SUBRESOURCE_DATA* pInitialData,
@@ -316,7 +345,36 @@ class WrappedD3D12ToD3D11Device final : public ID3D12Device2,
     ID3D11DeviceContext* GetD3D11Context() { return m_d3d11Context.Get(); }
     ID3D11Resource* GetD3D11Resource(ID3D12Resource* d3d12Resource);
     ID3D12Resource* GetD3D12Resource(ID3D11Resource* d3d11Resource);
-    void StoreD3D11ResourceMapping(ID3D12Resource* d3d12Resource, ID3D11Resource* d3d11Resource);
+    GPUVirtualAddressManager* GetGPUVAManager() { return m_gpuVAManager.get(); }
+    SubmissionTracker* GetSubmissionTracker() { return m_submissionTracker.get(); }
+    UploadRingManager* GetUploadRingManager() { return m_uploadRingManager.get(); }
+    ReadbackManager* GetReadbackManager() { return m_readbackManager.get(); }
+    TransientResourcePool* GetTransientPool() { return m_transientPool.get(); }
+    ResourceMaterializer* GetResourceMaterializer() {
+        return m_resourceMaterializer.get();
+    }
+    ScratchBufferPool* GetScratchBufferPool() {
+        return m_scratchBufferPool.get();
+    }
+    TilePoolManager* GetTilePoolManager() { return m_tilePoolManager.get(); }
+    ResidencyManager* GetResidencyManager() {
+        return m_residencyManager.get();
+    }
+    ShaderModuleCache* GetShaderModuleCache() {
+        return m_shaderModuleCache.get();
+    }
+    StateObjectCache* GetStateObjectCache() {
+        return m_stateObjectCache.get();
+    }
+    PipelineCompiler* GetPipelineCompiler() {
+        return m_pipelineCompiler.get();
+    }
+    PipelineDiskCache* GetPipelineDiskCache() {
+        return m_pipelineDiskCache.get();
+    }
+    PipelineStateCache* GetPipelineStateCache() {
+        return m_pipelineStateCache.get();
+    }
    private:
     WrappedD3D12ToD3D11Device(Microsoft::WRL::ComPtr<ID3D11Device> device,
                 Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
@@ -331,14 +389,35 @@ class WrappedD3D12ToD3D11Device final : public ID3D12Device2,
     LONG m_refCount{1};
 
     // Resource tracking
-    std::unordered_map<ID3D12Resource*, Microsoft::WRL::ComPtr<ID3D11Resource>>
-        m_resourceMap;
     std::vector<std::unique_ptr<WrappedD3D12ToD3D11CommandQueue>> m_commandQueues;
 
-    // Resource mapping
-    std::mutex m_resourceMappingMutex;
-    std::unordered_map<ID3D12Resource*, ID3D11Resource*> m_d3d12ToD3d11Resources;
-    std::unordered_map<ID3D11Resource*, ID3D12Resource*> m_d3d11ToD3d12Resources;
+    // GPU progress, upload heap renaming, asynchronous readback, recycling
+    // of short-lived resources, copy scratch space, tile memory for heaps,
+    // residency, and background resource creation, which uses the others
+    // and so is stopped before any of them goes away
+    std::unique_ptr<GPUVirtualAddressManager> m_gpuVAManager;
+    std::unique_ptr<SubmissionTracker> m_submissionTracker;
+    std::unique_ptr<UploadRingManager> m_uploadRingManager;
+    std::unique_ptr<ReadbackManager> m_readbackManager;
+    std::unique_ptr<TransientResourcePool> m_transientPool;
+    std::unique_ptr<ScratchBufferPool> m_scratchBufferPool;
+    std::unique_ptr<TilePoolManager> m_tilePoolManager;
+    std::unique_ptr<ResidencyManager> m_residencyManager;
+    std::unique_ptr<ResourceMaterializer> m_resourceMaterializer;
+
+    // Memoized placement sizes for GetResourceAllocationInfo
+    std::unique_ptr<AllocationInfoCache> m_allocationInfoCache;
+    std::unique_ptr<FootprintCache> m_footprintCache;
+
+    // D3D11 shader and state objects shared between pipeline states,
+    // serialized states kept across runs, the workers that compile states
+    // in the background, which use all of them, and the states themselves,
+    // released first
+    std::unique_ptr<ShaderModuleCache> m_shaderModuleCache;
+    std::unique_ptr<StateObjectCache> m_stateObjectCache;
+    std::unique_ptr<PipelineDiskCache> m_pipelineDiskCache;
+    std::unique_ptr<PipelineCompiler> m_pipelineCompiler;
+    std::unique_ptr<PipelineStateCache> m_pipelineStateCache;
 };
 
 }  // namespace dxiided
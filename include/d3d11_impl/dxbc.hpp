@@ -0,0 +1,66 @@
+#pragma once
+
+#include <windows.h>
+
+#include <cstdint>
+
+namespace dxiided {
+
+constexpr uint32_t MakeFourCC(char a, char b, char c, char d) {
+    return static_cast<uint32_t>(static_cast<uint8_t>(a)) |
+           static_cast<uint32_t>(static_cast<uint8_t>(b)) << 8 |
+           static_cast<uint32_t>(static_cast<uint8_t>(c)) << 16 |
+           static_cast<uint32_t>(static_cast<uint8_t>(d)) << 24;
+}
+
+constexpr uint32_t kDxbcMagic = MakeFourCC('D', 'X', 'B', 'C');
+constexpr uint32_t kDxbcChunkISGN = MakeFourCC('I', 'S', 'G', 'N');
+constexpr uint32_t kDxbcChunkISG1 = MakeFourCC('I', 'S', 'G', '1');
+constexpr uint32_t kDxbcChunkOSGN = MakeFourCC('O', 'S', 'G', 'N');
+constexpr uint32_t kDxbcChunkOSG1 = MakeFourCC('O', 'S', 'G', '1');
+constexpr uint32_t kDxbcChunkOSG5 = MakeFourCC('O', 'S', 'G', '5');
+constexpr uint32_t kDxbcChunkPCSG = MakeFourCC('P', 'C', 'S', 'G');
+constexpr uint32_t kDxbcChunkPSG1 = MakeFourCC('P', 'S', 'G', '1');
+
+struct DxbcChunk {
+    const uint8_t* data{nullptr};
+    uint32_t size{0};
+};
+
+// Where a chunk's data sits in its container, so it can be found again
+// without searching; size 0 if the container has no such chunk
+struct DxbcChunkLocation {
+    uint32_t offset{0};
+    uint32_t size{0};
+
+    DxbcChunk Resolve(const void* bytecode) const {
+        if (!size) {
+            return {};
+        }
+        return {static_cast<const uint8_t*>(bytecode) + offset, size};
+    }
+};
+
+// The chunks of a validated container pipeline states look at
+struct DxbcContainerInfo {
+    DxbcChunkLocation inputSignature;  // ISGN or ISG1
+};
+
+// Finds a chunk in a DXBC container, checking only the bounds of the
+// chunk table and of the chunk it returns
+bool FindDxbcChunk(const void* bytecode, SIZE_T length, uint32_t fourcc,
+                   DxbcChunk* chunk);
+
+// Checks a whole container in one pass: the header, the checksum, the
+// chunk table, and the element tables and names of every signature
+// chunk. Fills info with the chunks it found.
+HRESULT ValidateDxbc(const void* bytecode, SIZE_T length,
+                     DxbcContainerInfo* info);
+
+// The checksum D3D11 verifies before creating a shader: MD5 of everything
+// after the checksum, with the length folded into the padding differently
+// from plain MD5.
+void ComputeDxbcChecksum(const void* bytecode, SIZE_T length,
+                         uint32_t checksum[4]);
+
+}  // namespace dxiided
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <dxgiformat.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace dxiided {
+
+enum FormatFlags : uint8_t {
+    kFormatDepth = 0x1,
+    kFormatStencil = 0x2,
+    kFormatCompressed = 0x4,
+    kFormatSrgb = 0x8,
+};
+
+// Layout of one DXGI format. Uncompressed formats are 1x1 blocks. Formats
+// the table doesn't list fall back to 4 bytes per texel, as sizes always
+// have; only DXGI_FORMAT_UNKNOWN has a zero block size.
+struct FormatInfo {
+    uint8_t blockWidth;
+    uint8_t blockHeight;
+    uint8_t bytesPerBlock;
+    uint8_t planeCount;
+    DXGI_FORMAT typelessFormat;
+    uint8_t flags;
+};
+
+constexpr FormatInfo MakeFormatInfo(DXGI_FORMAT format) {
+    switch (format) {
+        case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        case DXGI_FORMAT_R32G32B32A32_UINT:
+        case DXGI_FORMAT_R32G32B32A32_SINT:
+            return {1, 1, 16, 1, DXGI_FORMAT_R32G32B32A32_TYPELESS, 0};
+        case DXGI_FORMAT_R32G32B32_TYPELESS:
+        case DXGI_FORMAT_R32G32B32_FLOAT:
+        case DXGI_FORMAT_R32G32B32_UINT:
+        case DXGI_FORMAT_R32G32B32_SINT:
+            return {1, 1, 12, 1, DXGI_FORMAT_R32G32B32_TYPELESS, 0};
+        case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+        case DXGI_FORMAT_R16G16B16A16_UINT:
+        case DXGI_FORMAT_R16G16B16A16_SNORM:
+        case DXGI_FORMAT_R16G16B16A16_SINT:
+            return {1, 1, 8, 1, DXGI_FORMAT_R16G16B16A16_TYPELESS, 0};
+        case DXGI_FORMAT_R32G32_TYPELESS:
+        case DXGI_FORMAT_R32G32_FLOAT:
+        case DXGI_FORMAT_R32G32_UINT:
+        case DXGI_FORMAT_R32G32_SINT:
+            return {1, 1, 8, 1, DXGI_FORMAT_R32G32_TYPELESS, 0};
+        case DXGI_FORMAT_R32G8X24_TYPELESS:
+        case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+        case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+            return {1, 1, 8, 2, DXGI_FORMAT_R32G8X24_TYPELESS, 0};
+        case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+            return {1, 1, 8, 2, DXGI_FORMAT_R32G8X24_TYPELESS, kFormatDepth | kFormatStencil};
+        case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+        case DXGI_FORMAT_R10G10B10A2_UNORM:
+        case DXGI_FORMAT_R10G10B10A2_UINT:
+            return {1, 1, 4, 1, DXGI_FORMAT_R10G10B10A2_TYPELESS, 0};
+        case DXGI_FORMAT_R11G11B10_FLOAT:
+            return {1, 1, 4, 1, DXGI_FORMAT_R11G11B10_FLOAT, 0};
+        case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UINT:
+        case DXGI_FORMAT_R8G8B8A8_SNORM:
+        case DXGI_FORMAT_R8G8B8A8_SINT:
+            return {1, 1, 4, 1, DXGI_FORMAT_R8G8B8A8_TYPELESS, 0};
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+            return {1, 1, 4, 1, DXGI_FORMAT_R8G8B8A8_TYPELESS, kFormatSrgb};
+        case DXGI_FORMAT_R16G16_TYPELESS:
+        case DXGI_FORMAT_R16G16_FLOAT:
+        case DXGI_FORMAT_R16G16_UNORM:
+        case DXGI_FORMAT_R16G16_UINT:
+        case DXGI_FORMAT_R16G16_SNORM:
+        case DXGI_FORMAT_R16G16_SINT:
+            return {1, 1, 4, 1, DXGI_FORMAT_R16G16_TYPELESS, 0};
+        case DXGI_FORMAT_R32_TYPELESS:
+        case DXGI_FORMAT_R32_FLOAT:
+        case DXGI_FORMAT_R32_UINT:
+        case DXGI_FORMAT_R32_SINT:
+            return {1, 1, 4, 1, DXGI_FORMAT_R32_TYPELESS, 0};
+        case DXGI_FORMAT_D32_FLOAT:
+            return {1, 1, 4, 1, DXGI_FORMAT_R32_TYPELESS, kFormatDepth};
+        case DXGI_FORMAT_R24G8_TYPELESS:
+        case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+        case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+            return {1, 1, 4, 2, DXGI_FORMAT_R24G8_TYPELESS, 0};
+        case DXGI_FORMAT_D24_UNORM_S8_UINT:
+            return {1, 1, 4, 2, DXGI_FORMAT_R24G8_TYPELESS, kFormatDepth | kFormatStencil};
+        case DXGI_FORMAT_R8G8_TYPELESS:
+        case DXGI_FORMAT_R8G8_UNORM:
+        case DXGI_FORMAT_R8G8_UINT:
+        case DXGI_FORMAT_R8G8_SNORM:
+        case DXGI_FORMAT_R8G8_SINT:
+            return {1, 1, 2, 1, DXGI_FORMAT_R8G8_TYPELESS, 0};
+        case DXGI_FORMAT_R16_TYPELESS:
+        case DXGI_FORMAT_R16_FLOAT:
+        case DXGI_FORMAT_R16_UNORM:
+        case DXGI_FORMAT_R16_UINT:
+        case DXGI_FORMAT_R16_SNORM:
+        case DXGI_FORMAT_R16_SINT:
+            return {1, 1, 2, 1, DXGI_FORMAT_R16_TYPELESS, 0};
+        case DXGI_FORMAT_D16_UNORM:
+            return {1, 1, 2, 1, DXGI_FORMAT_R16_TYPELESS, kFormatDepth};
+        case DXGI_FORMAT_R8_TYPELESS:
+        case DXGI_FORMAT_R8_UNORM:
+        case DXGI_FORMAT_R8_UINT:
+        case DXGI_FORMAT_R8_SNORM:
+        case DXGI_FORMAT_R8_SINT:
+            return {1, 1, 1, 1, DXGI_FORMAT_R8_TYPELESS, 0};
+        case DXGI_FORMAT_A8_UNORM:
+            return {1, 1, 1, 1, DXGI_FORMAT_A8_UNORM, 0};
+        case DXGI_FORMAT_R1_UNORM:
+            return {8, 1, 1, 1, DXGI_FORMAT_R1_UNORM, 0};
+        case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+            return {1, 1, 4, 1, DXGI_FORMAT_R9G9B9E5_SHAREDEXP, 0};
+        case DXGI_FORMAT_R8G8_B8G8_UNORM:
+            return {2, 1, 4, 1, DXGI_FORMAT_R8G8_B8G8_UNORM, 0};
+        case DXGI_FORMAT_G8R8_G8B8_UNORM:
+            return {2, 1, 4, 1, DXGI_FORMAT_G8R8_G8B8_UNORM, 0};
+        case DXGI_FORMAT_BC1_TYPELESS:
+        case DXGI_FORMAT_BC1_UNORM:
+            return {4, 4, 8, 1, DXGI_FORMAT_BC1_TYPELESS, kFormatCompressed};
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+            return {4, 4, 8, 1, DXGI_FORMAT_BC1_TYPELESS, kFormatCompressed | kFormatSrgb};
+        case DXGI_FORMAT_BC2_TYPELESS:
+        case DXGI_FORMAT_BC2_UNORM:
+            return {4, 4, 16, 1, DXGI_FORMAT_BC2_TYPELESS, kFormatCompressed};
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+            return {4, 4, 16, 1, DXGI_FORMAT_BC2_TYPELESS, kFormatCompressed | kFormatSrgb};
+        case DXGI_FORMAT_BC3_TYPELESS:
+        case DXGI_FORMAT_BC3_UNORM:
+            return {4, 4, 16, 1, DXGI_FORMAT_BC3_TYPELESS, kFormatCompressed};
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            return {4, 4, 16, 1, DXGI_FORMAT_BC3_TYPELESS, kFormatCompressed | kFormatSrgb};
+        case DXGI_FORMAT_BC4_TYPELESS:
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+            return {4, 4, 8, 1, DXGI_FORMAT_BC4_TYPELESS, kFormatCompressed};
+        case DXGI_FORMAT_BC5_TYPELESS:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+            return {4, 4, 16, 1, DXGI_FORMAT_BC5_TYPELESS, kFormatCompressed};
+        case DXGI_FORMAT_B5G6R5_UNORM:
+            return {1, 1, 2, 1, DXGI_FORMAT_B5G6R5_UNORM, 0};
+        case DXGI_FORMAT_B5G5R5A1_UNORM:
+            return {1, 1, 2, 1, DXGI_FORMAT_B5G5R5A1_UNORM, 0};
+        case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+            return {1, 1, 4, 1, DXGI_FORMAT_B8G8R8A8_TYPELESS, 0};
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+            return {1, 1, 4, 1, DXGI_FORMAT_B8G8R8A8_TYPELESS, kFormatSrgb};
+        case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+            return {1, 1, 4, 1, DXGI_FORMAT_B8G8R8X8_TYPELESS, 0};
+        case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+            return {1, 1, 4, 1, DXGI_FORMAT_B8G8R8X8_TYPELESS, kFormatSrgb};
+        case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+            return {1, 1, 4, 1, DXGI_FORMAT_R10G10B10A2_TYPELESS, 0};
+        case DXGI_FORMAT_BC6H_TYPELESS:
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+            return {4, 4, 16, 1, DXGI_FORMAT_BC6H_TYPELESS, kFormatCompressed};
+        case DXGI_FORMAT_BC7_TYPELESS:
+        case DXGI_FORMAT_BC7_UNORM:
+            return {4, 4, 16, 1, DXGI_FORMAT_BC7_TYPELESS, kFormatCompressed};
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            return {4, 4, 16, 1, DXGI_FORMAT_BC7_TYPELESS, kFormatCompressed | kFormatSrgb};
+        case DXGI_FORMAT_AYUV:
+            return {1, 1, 4, 1, DXGI_FORMAT_AYUV, 0};
+        case DXGI_FORMAT_Y410:
+            return {1, 1, 4, 1, DXGI_FORMAT_Y410, 0};
+        case DXGI_FORMAT_Y416:
+            return {1, 1, 8, 1, DXGI_FORMAT_Y416, 0};
+        case DXGI_FORMAT_NV12:
+            return {1, 1, 1, 2, DXGI_FORMAT_NV12, 0};
+        case DXGI_FORMAT_P010:
+            return {1, 1, 2, 2, DXGI_FORMAT_P010, 0};
+        case DXGI_FORMAT_P016:
+            return {1, 1, 2, 2, DXGI_FORMAT_P016, 0};
+        case DXGI_FORMAT_420_OPAQUE:
+            return {1, 1, 1, 2, DXGI_FORMAT_420_OPAQUE, 0};
+        case DXGI_FORMAT_YUY2:
+            return {2, 1, 4, 1, DXGI_FORMAT_YUY2, 0};
+        case DXGI_FORMAT_Y210:
+            return {2, 1, 8, 1, DXGI_FORMAT_Y210, 0};
+        case DXGI_FORMAT_Y216:
+            return {2, 1, 8, 1, DXGI_FORMAT_Y216, 0};
+        case DXGI_FORMAT_NV11:
+            return {1, 1, 1, 2, DXGI_FORMAT_NV11, 0};
+        case DXGI_FORMAT_AI44:
+            return {1, 1, 1, 1, DXGI_FORMAT_AI44, 0};
+        case DXGI_FORMAT_IA44:
+            return {1, 1, 1, 1, DXGI_FORMAT_IA44, 0};
+        case DXGI_FORMAT_P8:
+            return {1, 1, 1, 1, DXGI_FORMAT_P8, 0};
+        case DXGI_FORMAT_A8P8:
+            return {1, 1, 2, 1, DXGI_FORMAT_A8P8, 0};
+        case DXGI_FORMAT_B4G4R4A4_UNORM:
+            return {1, 1, 2, 1, DXGI_FORMAT_B4G4R4A4_UNORM, 0};
+        case DXGI_FORMAT_UNKNOWN:
+            return {1, 1, 0, 1, format, 0};
+        default:
+            return {1, 1, 4, 1, format, 0};
+    }
+}
+
+// Covers every format up to the sampler feedback ones
+constexpr size_t kFormatTableSize = 192;
+
+template <size_t... I>
+constexpr std::array<FormatInfo, sizeof...(I)> BuildFormatTable(
+    std::index_sequence<I...>) {
+    return {{MakeFormatInfo(static_cast<DXGI_FORMAT>(I))...}};
+}
+
+inline constexpr std::array<FormatInfo, kFormatTableSize> kFormatTable =
+    BuildFormatTable(std::make_index_sequence<kFormatTableSize>{});
+
+constexpr const FormatInfo& GetFormatInfo(DXGI_FORMAT format) {
+    return kFormatTable[static_cast<size_t>(format) < kFormatTableSize
+                            ? static_cast<size_t>(format)
+                            : 0];
+}
+
+constexpr bool IsBlockCompressed(DXGI_FORMAT format) {
+    return GetFormatInfo(format).flags & kFormatCompressed;
+}
+
+constexpr bool IsDepthStencilFormat(DXGI_FORMAT format) {
+    return GetFormatInfo(format).flags & (kFormatDepth | kFormatStencil);
+}
+
+// Format and chroma subsampling of one plane of a planar format, as
+// copies address it. Single-plane formats describe themselves.
+struct FormatPlane {
+    DXGI_FORMAT format;
+    uint8_t widthShift;
+    uint8_t heightShift;
+};
+
+constexpr FormatPlane GetFormatPlane(DXGI_FORMAT format, uint32_t plane) {
+    switch (format) {
+        case DXGI_FORMAT_NV12:
+        case DXGI_FORMAT_420_OPAQUE:
+            return plane ? FormatPlane{DXGI_FORMAT_R8G8_TYPELESS, 1, 1}
+                         : FormatPlane{DXGI_FORMAT_R8_TYPELESS, 0, 0};
+        case DXGI_FORMAT_P010:
+        case DXGI_FORMAT_P016:
+            return plane ? FormatPlane{DXGI_FORMAT_R16G16_TYPELESS, 1, 1}
+                         : FormatPlane{DXGI_FORMAT_R16_TYPELESS, 0, 0};
+        case DXGI_FORMAT_NV11:
+            return plane ? FormatPlane{DXGI_FORMAT_R8G8_TYPELESS, 2, 0}
+                         : FormatPlane{DXGI_FORMAT_R8_TYPELESS, 0, 0};
+        case DXGI_FORMAT_R24G8_TYPELESS:
+        case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+        case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+        case DXGI_FORMAT_D24_UNORM_S8_UINT:
+        case DXGI_FORMAT_R32G8X24_TYPELESS:
+        case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+        case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+        case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+            return plane ? FormatPlane{DXGI_FORMAT_R8_TYPELESS, 0, 0}
+                         : FormatPlane{DXGI_FORMAT_R32_TYPELESS, 0, 0};
+        default:
+            return {format, 0, 0};
+    }
+}
+
+// Bytes in one row of blocks covering width texels
+constexpr uint64_t GetFormatRowSize(DXGI_FORMAT format, uint64_t width) {
+    const FormatInfo& info = GetFormatInfo(format);
+    return (width + info.blockWidth - 1) / info.blockWidth *
+           info.bytesPerBlock;
+}
+
+// Rows of blocks covering height texels
+constexpr uint32_t GetFormatRowCount(DXGI_FORMAT format, uint32_t height) {
+    const FormatInfo& info = GetFormatInfo(format);
+    return (height + info.blockHeight - 1) / info.blockHeight;
+}
+
+static_assert(GetFormatInfo(DXGI_FORMAT_BC1_UNORM).bytesPerBlock == 8,
+              "BC1 blocks are 8 bytes");
+static_assert(GetFormatRowSize(DXGI_FORMAT_BC7_UNORM, 13) == 64,
+              "BC7 rows round up to whole blocks");
+static_assert(GetFormatPlane(DXGI_FORMAT_NV12, 1).format ==
+                  DXGI_FORMAT_R8G8_TYPELESS,
+              "NV12 chroma is an R8G8 plane");
+
+}  // namespace dxiided
@@ -4,6 +4,8 @@
 #include <d3d12.h>
 #include <wrl/client.h>
 
+#include <mutex>
+
 namespace dxiided {
 
 class WrappedD3D12ToD3D11Device;
@@ -31,15 +33,25 @@ public:
     D3D12_HEAP_DESC* STDMETHODCALLTYPE GetDesc(D3D12_HEAP_DESC* desc) override;
 
     // WrappedD3D12ToD3D11Heap methods
-    ID3D11Buffer* GetD3D11Buffer() { return m_buffer.Get(); }
+    // First tile of this heap in the device tile pool, reserved on the
+    // first tile mapping that references the heap
+    HRESULT GetFirstTile(UINT* firstTile);
+
+    // Maps every tile of a tiled resource placed at offset to this heap's
+    // tiles, which is all the memory a placed resource has
+    HRESULT MapPlacedResource(ID3D11Resource* resource, UINT64 offset);
 
 private:
     WrappedD3D12ToD3D11Heap(WrappedD3D12ToD3D11Device* device, const D3D12_HEAP_DESC& desc);
+    ~WrappedD3D12ToD3D11Heap();
 
     WrappedD3D12ToD3D11Device* const m_device;
     D3D12_HEAP_DESC m_desc;
-    Microsoft::WRL::ComPtr<ID3D11Buffer> m_buffer;
     LONG m_refCount = 1;
+
+    std::mutex m_tileMutex;
+    UINT m_firstTile = 0;
+    UINT m_tileCount = 0;
 };
 
 }  // namespace dxiided
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <d3d12.h>
+#include <initguid.h>
+#include <wrl/client.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/debug.hpp"
+
+namespace dxiided {
+
+class WrappedD3D12ToD3D11PipelineState;
+
+// Deep copy of a pipeline state desc. The application may free its
+// bytecode and layout arrays as soon as the create call returns, so a
+// deferred compile can't use the original desc.
+class PipelineDescCopy {
+   public:
+    explicit PipelineDescCopy(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+    explicit PipelineDescCopy(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc);
+
+    bool IsCompute() const { return m_isCompute; }
+    const D3D12_GRAPHICS_PIPELINE_STATE_DESC* Graphics() const {
+        return &m_graphics;
+    }
+    const D3D12_COMPUTE_PIPELINE_STATE_DESC* Compute() const {
+        return &m_compute;
+    }
+
+   private:
+    D3D12_SHADER_BYTECODE CopyShader(const D3D12_SHADER_BYTECODE& shader);
+    const char* CopyString(const char* str);
+
+    bool m_isCompute;
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC m_graphics{};
+    D3D12_COMPUTE_PIPELINE_STATE_DESC m_compute{};
+
+    // Deques so earlier entries never move while later ones are added
+    std::deque<std::vector<uint8_t>> m_bytecode;
+    std::deque<std::string> m_strings;
+    std::vector<D3D12_INPUT_ELEMENT_DESC> m_inputElements;
+    std::vector<D3D12_SO_DECLARATION_ENTRY> m_soEntries;
+    std::vector<UINT> m_soStrides;
+};
+
+// Compiles pipeline states created with DXIIDED_ASYNC_PSO on a pool of
+// worker threads. ID3D11Device is free-threaded; the workers never touch
+// the immediate context. A state that is needed before a worker gets to
+// it is compiled by the thread that needs it.
+class PipelineCompiler {
+   public:
+    PipelineCompiler();
+    ~PipelineCompiler();
+
+    void Enqueue(WrappedD3D12ToD3D11PipelineState* state);
+
+    // Moves a state that is still waiting to the front of the queue
+    void Prioritize(WrappedD3D12ToD3D11PipelineState* state);
+
+   private:
+    void WorkerMain();
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState>>
+        m_queue;
+    std::vector<std::thread> m_workers;
+    bool m_stop{false};
+};
+
+// Private interface of the D3D12 device for hinting which pipeline states
+// are about to be used, e.g. by a loading screen
+DEFINE_GUID(IID_IDxiidedPipelineCompiler,
+    0x4e7b2d19, 0x8c31, 0x4f06,
+    0x9a, 0x5e, 0x13, 0xd7, 0x6b, 0x20, 0xc4, 0x8f);
+
+interface IDxiidedPipelineCompiler : IUnknown {
+    // Compiles the given states ahead of the ones created before them
+    virtual HRESULT STDMETHODCALLTYPE PrioritizePipelineStates(
+        UINT NumStates, ID3D12PipelineState* const* ppStates) = 0;
+};
+
+}  // namespace dxiided
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <d3d12.h>
+#include <windows.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/debug.hpp"
+#include "common/hash.hpp"
+
+namespace dxiided {
+
+class PipelineDescCopy;
+
+// Serialized pipeline state descs. The bytes hold everything needed to
+// create the state again, shaders and strings included.
+std::vector<uint8_t> SerializePipelineDesc(
+    const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+std::vector<uint8_t> SerializePipelineDesc(
+    const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc);
+std::unique_ptr<PipelineDescCopy> DeserializePipelineDesc(const uint8_t* data,
+                                                          size_t size);
+
+// Serialized pipeline state descs persisted across runs, keyed by the
+// pipeline state cache key. Only used with DXIIDED_PIPELINE_CACHE_PATH
+// set: the file is memory-mapped at device creation, and the descs of
+// states created since are appended when the device goes away. Several
+// processes may share the file.
+class PipelineDiskCache {
+   public:
+    // Bumped whenever the record or desc serialization changes
+    static constexpr uint32_t kVersion = 1;
+
+    PipelineDiskCache();
+    ~PipelineDiskCache();
+
+    // False without a cache path, then nothing needs to be stored
+    bool IsPersistent() const { return !m_path.empty(); }
+
+    bool Contains(const Hash128& key);
+    void Store(const Hash128& key, std::vector<uint8_t> desc);
+
+    // A serialized desc as a self-describing blob, for GetCachedBlob
+    static HRESULT CreateBlob(const Hash128& key,
+                              const std::vector<uint8_t>& desc,
+                              ID3DBlob** ppBlob);
+
+    // Entries read from the file, to prewarm the pipeline state cache
+    std::vector<std::unique_ptr<PipelineDescCopy>> GetLoadedDescs();
+
+   private:
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+    };
+
+    struct RecordHeader {
+        Hash128 key;
+        uint32_t size;
+        uint32_t checksum;
+    };
+
+    struct Entry {
+        const uint8_t* data;
+        uint32_t size;
+    };
+
+    static constexpr uint32_t kMagic = 0x43505844;  // "DXPC"
+
+    static uint32_t Checksum(const uint8_t* data, size_t size);
+    void Load();
+    // End of the intact records in file, 0 if it needs a new header
+    UINT64 FindAppendOffset(HANDLE file);
+    void WriteNewEntries();
+
+    std::string m_path;
+    HANDLE m_file{INVALID_HANDLE_VALUE};
+    HANDLE m_mapping{nullptr};
+    const uint8_t* m_view{nullptr};
+    // End of the last intact record when the file was loaded
+    UINT64 m_validSize{0};
+
+    std::mutex m_mutex;
+    std::unordered_map<Hash128, Entry, Hash128Hasher> m_entries;
+    std::deque<std::pair<Hash128, std::vector<uint8_t>>> m_newEntries;
+};
+
+}  // namespace dxiided
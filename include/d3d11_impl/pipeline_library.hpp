@@ -0,0 +1,146 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl/client.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "common/debug.hpp"
+#include "common/hash.hpp"
+
+namespace dxiided {
+
+class WrappedD3D12ToD3D11Device;
+
+// Named pipeline states in a flat, relocatable blob. The blob is a header,
+// an index of names sorted for binary search, a table of records keyed by
+// the pipeline state cache key and the record data, which is the desc in
+// the pipeline cache's serialization. Names that refer to identical states
+// share one record. All offsets are relative to the start of the blob.
+//
+// The application keeps the blob it opens a library with alive for the
+// library's lifetime, so opening only checks the header and table bounds
+// and lookups read the blob in place. A record is only deserialized and
+// compiled when its pipeline is first loaded, and then only through the
+// pipeline state cache.
+class WrappedD3D12ToD3D11PipelineLibrary final : public ID3D12PipelineLibrary {
+   public:
+    // Bumped whenever the blob layout changes
+    static constexpr uint32_t kVersion = 1;
+
+    static HRESULT Create(WrappedD3D12ToD3D11Device* device,
+                          const void* pLibraryBlob, SIZE_T BlobLength,
+                          REFIID riid, void** ppPipelineLibrary);
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid,
+                                             void** ppvObject) override;
+    ULONG STDMETHODCALLTYPE AddRef() override;
+    ULONG STDMETHODCALLTYPE Release() override;
+
+    // ID3D12Object methods
+    HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT* pDataSize,
+                                             void* pData) override;
+    HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT DataSize,
+                                             const void* pData) override;
+    HRESULT STDMETHODCALLTYPE
+    SetPrivateDataInterface(REFGUID guid, const IUnknown* pData) override;
+    HRESULT STDMETHODCALLTYPE SetName(LPCWSTR Name) override;
+
+    // ID3D12DeviceChild methods
+    HRESULT STDMETHODCALLTYPE GetDevice(REFIID riid, void** ppvDevice) override;
+
+    // ID3D12PipelineLibrary methods
+    HRESULT STDMETHODCALLTYPE StorePipeline(
+        LPCWSTR pName, ID3D12PipelineState* pPipeline) override;
+    HRESULT STDMETHODCALLTYPE LoadGraphicsPipeline(
+        LPCWSTR pName, const D3D12_GRAPHICS_PIPELINE_STATE_DESC* pDesc,
+        REFIID riid, void** ppPipelineState) override;
+    HRESULT STDMETHODCALLTYPE LoadComputePipeline(
+        LPCWSTR pName, const D3D12_COMPUTE_PIPELINE_STATE_DESC* pDesc,
+        REFIID riid, void** ppPipelineState) override;
+    SIZE_T STDMETHODCALLTYPE GetSerializedSize() override;
+    HRESULT STDMETHODCALLTYPE Serialize(void* pData,
+                                        SIZE_T DataSizeInBytes) override;
+
+   private:
+    struct LibraryHeader {
+        uint32_t magic;
+        uint32_t version;
+        // PipelineDiskCache::kVersion of the records
+        uint32_t descVersion;
+        uint32_t entryCount;
+        uint32_t recordCount;
+        uint32_t reserved;
+    };
+
+    struct IndexEntry {
+        uint32_t nameOffset;
+        // In WCHARs, without a terminator
+        uint32_t nameLength;
+        uint32_t record;
+        uint32_t reserved;
+    };
+
+    struct RecordEntry {
+        Hash128 key;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    // A record in the blob or stored since
+    struct RecordRef {
+        Hash128 key;
+        const uint8_t* data;
+        uint32_t size;
+    };
+
+    static constexpr uint32_t kMagic = 0x4c505844;  // "DXPL"
+
+    WrappedD3D12ToD3D11PipelineLibrary(WrappedD3D12ToD3D11Device* device);
+    ~WrappedD3D12ToD3D11PipelineLibrary();
+
+    HRESULT Open(const void* pLibraryBlob, SIZE_T BlobLength);
+    IndexEntry GetIndexEntry(uint32_t index) const;
+    // Both fail if what they read points outside the blob
+    bool GetRecordEntry(uint32_t index, RecordEntry* record) const;
+    bool GetEntryName(const IndexEntry& entry, std::wstring* name) const;
+    bool FindInBlob(LPCWSTR pName, RecordRef* found) const;
+    bool FindLocked(LPCWSTR pName, RecordRef* found) const;
+    HRESULT LoadPipeline(const RecordRef& record, REFIID riid,
+                         void** ppPipelineState);
+    // Adds the blob's entries to m_serializedSize the first time it is
+    // needed, so opening stays a header check
+    void SizeBlobLocked();
+    std::vector<uint8_t> BuildBlobLocked() const;
+
+    WrappedD3D12ToD3D11Device* const m_device;
+    std::atomic<ULONG> m_refCount{1};
+
+    // The application's blob, read in place
+    const uint8_t* m_blob{nullptr};
+    UINT64 m_blobSize{0};
+    uint32_t m_blobEntries{0};
+    uint32_t m_blobRecords{0};
+
+    // Pipelines stored since the library was opened
+    mutable std::mutex m_mutex;
+    std::map<std::wstring, Hash128> m_stored;
+    std::unordered_map<Hash128, std::vector<uint8_t>, Hash128Hasher>
+        m_records;
+    UINT64 m_recordBytes{0};
+
+    // What Serialize writes, kept up to date so GetSerializedSize doesn't
+    // have to build the blob
+    bool m_blobSized{false};
+    UINT64 m_serializedSize{sizeof(LibraryHeader)};
+    std::unordered_set<Hash128, Hash128Hasher> m_serializedKeys;
+};
+
+}  // namespace dxiided
@@ -4,17 +4,43 @@
 #include <d3d12.h>
 #include <wrl/client.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
 
 #include "common/debug.hpp"
+#include "common/hash.hpp"
+#include "d3d11_impl/pipeline_compiler.hpp"
+#include "d3d11_impl/pipeline_disk_cache.hpp"
+#include "d3d11_impl/shader_module_cache.hpp"
 
 namespace dxiided {
 
 class WrappedD3D12ToD3D11Device;
 
+// The D3D11 calls applying a pipeline state is made of
+enum class PipelineSetter : uint32_t {
+    VertexShader,
+    PixelShader,
+    GeometryShader,
+    HullShader,
+    DomainShader,
+    ComputeShader,
+    InputLayout,
+    BlendState,
+    RasterizerState,
+    DepthStencilState,
+};
+
+constexpr UINT kPipelineSetterCount = 10;
+
+constexpr uint32_t PipelineSetterBit(PipelineSetter setter) {
+    return 1u << static_cast<uint32_t>(setter);
+}
+
 class WrappedD3D12ToD3D11PipelineState final : public ID3D12PipelineState {
    public:
     static HRESULT CreateGraphics(
@@ -25,6 +51,11 @@ class WrappedD3D12ToD3D11PipelineState final : public ID3D12PipelineState {
                                  const D3D12_COMPUTE_PIPELINE_STATE_DESC* pDesc,
                                  REFIID riid, void** ppPipelineState);
 
+    // Creates a state from the pipeline cache and compiles it in the
+    // background, unless an identical state already exists
+    static void Prewarm(WrappedD3D12ToD3D11Device* device,
+                        std::unique_ptr<PipelineDescCopy> desc);
+
     // IUnknown methods
     HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid,
                                              void** ppvObject) override;
@@ -47,11 +78,34 @@ class WrappedD3D12ToD3D11PipelineState final : public ID3D12PipelineState {
     HRESULT STDMETHODCALLTYPE GetCachedBlob(ID3DBlob** ppBlob) override;
 
     // Helper methods
-    void Apply(ID3D11DeviceContext* context);
-
-    // Pipeline state caching
+    // Binds the state, skipping objects that previous, the state applied
+    // last on context, already bound. The blend factor and stencil ref
+    // are the command list's, D3D11 sets them with the state objects.
+    void Apply(ID3D11DeviceContext* context, const FLOAT blendFactor[4],
+               UINT stencilRef,
+               const WrappedD3D12ToD3D11PipelineState* previous = nullptr);
+
+    // The PipelineSetterBit mask of the setters whose object differs from
+    // previous's, compiling a deferred state first. That includes objects
+    // previous had and the state lacks, which ApplySetters unbinds.
+    uint32_t GetChangedSetters(
+        const WrappedD3D12ToD3D11PipelineState* previous);
+
+    // Issues only the setters in a mask from GetChangedSetters
+    void ApplySetters(ID3D11DeviceContext* context, uint32_t setters,
+                      const FLOAT blendFactor[4], UINT stencilRef) const;
+
+    // Never reused within the process, unlike the state's address
+    UINT64 GetId() const { return m_id; }
+
+    // Runs a deferred compile unless another thread already has, in which
+    // case it waits for that one
+    HRESULT Compile();
+
+    // Pipeline state caching, keyed by the contents of the desc: shader
+    // bytecode, strings and state, never the pointers to them
     struct PipelineStateKey {
-        std::vector<uint8_t> hash;
+        Hash128 hash;
         bool operator==(const PipelineStateKey& other) const {
             return hash == other.hash;
         }
@@ -59,25 +113,51 @@ class WrappedD3D12ToD3D11PipelineState final : public ID3D12PipelineState {
 
     struct PipelineStateKeyHasher {
         size_t operator()(const PipelineStateKey& key) const {
-            return std::hash<std::string>()(
-                std::string(reinterpret_cast<const char*>(key.hash.data()),
-                            key.hash.size()));
+            return Hash128Hasher()(key.hash);
         }
     };
 
-    static Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState> GetCachedState(
-        const PipelineStateKey& key);
-    static void CacheState(const PipelineStateKey& key,
-                           Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState> state);
+    static PipelineStateKey ComputeHash(
+        const D3D12_GRAPHICS_PIPELINE_STATE_DESC* pDesc);
+    static PipelineStateKey ComputeHash(
+        const D3D12_COMPUTE_PIPELINE_STATE_DESC* pDesc);
+
+    const PipelineStateKey& GetKey() const { return m_key; }
+
+    // The serialized desc a successfully compiled state was created from
+    HRESULT GetSerializedDesc(std::vector<uint8_t>* desc);
 
    private:
     WrappedD3D12ToD3D11PipelineState(WrappedD3D12ToD3D11Device* device);
 
     HRESULT InitializeGraphics(const D3D12_GRAPHICS_PIPELINE_STATE_DESC* pDesc);
     HRESULT InitializeCompute(const D3D12_COMPUTE_PIPELINE_STATE_DESC* pDesc);
+    void DeferCompile(std::unique_ptr<PipelineDescCopy> desc);
+    template <typename Desc>
+    void StoreCachedBlob(const Desc& desc);
+
+    // Fills m_signature once the D3D11 objects exist
+    void BuildSignature();
 
     WrappedD3D12ToD3D11Device* const m_device;
+    const UINT64 m_id;
     LONG m_refCount{1};
+    PipelineStateKey m_key;
+    // The object each setter binds, indexed by PipelineSetter, so states
+    // can be diffed without knowing which stages they use
+    const void* m_signature[kPipelineSetterCount] = {};
+
+    // The desc the state was created from. Deferred compiles read it, and
+    // it is serialized on demand for GetCachedBlob and pipeline libraries.
+    std::unique_ptr<PipelineDescCopy> m_desc;
+
+    // Compiles deferred with DXIIDED_ASYNC_PSO
+    enum class CompileStatus { Pending, Compiling, Done };
+    std::mutex m_compileMutex;
+    std::condition_variable m_compileCv;
+    CompileStatus m_compileStatus{CompileStatus::Done};
+    HRESULT m_compileResult{S_OK};
+    std::atomic<bool> m_compiled{true};
 
     // Graphics pipeline state
     Microsoft::WRL::ComPtr<ID3D11VertexShader> m_vertexShader;
@@ -87,6 +167,7 @@ class WrappedD3D12ToD3D11PipelineState final : public ID3D12PipelineState {
     Microsoft::WRL::ComPtr<ID3D11DomainShader> m_domainShader;
     Microsoft::WRL::ComPtr<ID3D11InputLayout> m_inputLayout;
     Microsoft::WRL::ComPtr<ID3D11BlendState> m_blendState;
+    UINT m_sampleMask{0xffffffff};
     Microsoft::WRL::ComPtr<ID3D11RasterizerState> m_rasterizerState;
     Microsoft::WRL::ComPtr<ID3D11DepthStencilState> m_depthStencilState;
 
@@ -101,20 +182,47 @@ class WrappedD3D12ToD3D11PipelineState final : public ID3D12PipelineState {
     UINT m_numSOStrides;
     UINT m_rasterizedStream;
 
+    // The stream output shader replaces the plain geometry shader
+    ID3D11GeometryShader* GetGeometryShader() const {
+        return m_streamOutShader ? m_streamOutShader.Get()
+                                 : m_geometryShader.Get();
+    }
+
+    // Shared through the device's shader module cache
+    template <typename T>
+    HRESULT CreateShader(
+        ShaderStage stage, const D3D12_SHADER_BYTECODE& bytecode,
+        Microsoft::WRL::ComPtr<T>& shader,
+        std::shared_ptr<const ShaderModule>* created = nullptr);
+
     HRESULT CreateStreamOutputShader(const D3D12_STREAM_OUTPUT_DESC* pSODesc,
                                      const void* pShaderBytecode,
                                      SIZE_T BytecodeLength);
 
-    static PipelineStateKey ComputeHash(
-        const D3D12_GRAPHICS_PIPELINE_STATE_DESC* pDesc);
-    static PipelineStateKey ComputeHash(
-        const D3D12_COMPUTE_PIPELINE_STATE_DESC* pDesc);
+    static std::atomic<UINT64> s_nextId;
+};
+
+// Pipeline states by desc contents. Each device has its own: states point
+// at the device's shader and state object caches, so they can't be shared
+// with another device and are released along with theirs.
+class PipelineStateCache {
+   public:
+    using Key = WrappedD3D12ToD3D11PipelineState::PipelineStateKey;
 
-    static std::unordered_map<PipelineStateKey,
-                              Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState>,
-                              PipelineStateKeyHasher>
-        s_pipelineStateCache;
-    static std::mutex s_cacheMutex;
+    PipelineStateCache();
+    ~PipelineStateCache();
+
+    Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState> Find(
+        const Key& key);
+    void Insert(const Key& key,
+                Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState> state);
+
+   private:
+    std::mutex m_mutex;
+    std::unordered_map<Key,
+                       Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState>,
+                       WrappedD3D12ToD3D11PipelineState::PipelineStateKeyHasher>
+        m_states;
 };
 
 }  // namespace dxiided
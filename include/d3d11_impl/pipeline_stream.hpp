@@ -0,0 +1,26 @@
+#pragma once
+
+#include <d3d12.h>
+
+#include "common/debug.hpp"
+
+namespace dxiided {
+
+// A pipeline state stream as the desc the legacy create calls take. The
+// desc points into the application's stream, nothing is copied, so it is
+// only valid while the stream is.
+struct ParsedPipelineStream {
+    bool isCompute{false};
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC graphics;
+    D3D12_COMPUTE_PIPELINE_STATE_DESC compute;
+};
+
+// Walks the stream in one pass, driven by a table of the size, alignment
+// and handler of every subobject type ID3D12Device2 defines. Subobjects
+// that are left out take the D3D12 defaults. Unknown or repeated
+// subobjects, and a stream that mixes compute and graphics shaders, fail
+// with E_INVALIDARG.
+HRESULT ParsePipelineStateStream(const D3D12_PIPELINE_STATE_STREAM_DESC& desc,
+                                 ParsedPipelineStream* parsed);
+
+}  // namespace dxiided
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common/debug.hpp"
+#include "d3d11_impl/transient_pool.hpp"
+
+namespace dxiided {
+
+class SubmissionTracker;
+class WrappedD3D12ToD3D11Resource;
+
+// A GPU copy into a readback heap buffer. The GPU writes into a pooled
+// staging buffer or texture; the bytes land in the readback resource's CPU
+// shadow once the submission carrying the copy has completed.
+struct ReadbackCopy {
+    WrappedD3D12ToD3D11Resource* target;
+    Microsoft::WRL::ComPtr<ID3D11Resource> staging;
+    UINT64 dstOffset;
+    UINT64 size;
+    UINT64 serial;
+
+    // Texture copies are repacked at the footprint's pitches, zero rows
+    // means a plain buffer copy
+    UINT rowPitch;
+    UINT depthPitch;
+    UINT rowSize;
+    UINT rowCount;
+    UINT sliceCount;
+};
+
+class ReadbackManager {
+   public:
+    ReadbackManager(ID3D11Device* device, ID3D11DeviceContext* context,
+                    SubmissionTracker* tracker);
+    ~ReadbackManager();
+
+    // Staging resources are pooled by desc, buffers bucketed by size, and
+    // reused once the last submission that wrote them has completed
+    Microsoft::WRL::ComPtr<ID3D11Resource> AcquireStagingBuffer(UINT size);
+    Microsoft::WRL::ComPtr<ID3D11Resource> AcquireStagingTexture(
+        D3D11_RESOURCE_DIMENSION dimension, DXGI_FORMAT format, UINT width,
+        UINT height, UINT depth);
+    void ReleaseStaging(Microsoft::WRL::ComPtr<ID3D11Resource> staging,
+                        UINT64 lastUsedSerial);
+
+    // Queues copies recorded by a command list that was just submitted
+    void Submit(const std::vector<ReadbackCopy>& copies, UINT64 serial);
+
+    // Makes every outstanding copy into target visible in its CPU shadow,
+    // waiting only for the submissions that carry those copies
+    void Resolve(WrappedD3D12ToD3D11Resource* target);
+
+    // Drops copies into a resource that is being destroyed
+    void Cancel(WrappedD3D12ToD3D11Resource* target);
+
+   private:
+    struct PooledStaging {
+        Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+        UINT64 lastUsedSerial;
+        UINT64 size;
+    };
+
+    static constexpr UINT kMinBucketSize = 4096;
+    static constexpr size_t kMaxPooledPerBucket = 8;
+
+    static UINT GetBucketSize(UINT size);
+    static TransientKey GetStagingKey(ID3D11Resource* resource);
+    static UINT64 GetStagingSize(const TransientKey& key);
+    Microsoft::WRL::ComPtr<ID3D11Resource> AcquirePooled(
+        const TransientKey& key);
+    bool IsPendingLocked(ID3D11Resource* staging) const;
+    void ResolveCompletedLocked(UINT64 completedSerial, bool wait);
+    bool ResolveCopyLocked(const ReadbackCopy& copy, bool wait);
+    void CompletionThreadMain();
+
+    Microsoft::WRL::ComPtr<ID3D11Device> m_device;
+    Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context;
+    SubmissionTracker* const m_tracker;
+
+    std::mutex m_poolMutex;
+    std::unordered_map<TransientKey, std::vector<PooledStaging>,
+                       TransientKeyHash>
+        m_pool;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<ReadbackCopy> m_pending;
+    std::thread m_completionThread;
+    bool m_stop{false};
+};
+
+}  // namespace dxiided
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <d3d11.h>
+#include <dxgi1_4.h>
+#include <wrl/client.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "common/debug.hpp"
+
+namespace dxiided {
+
+class SubmissionTracker;
+class WrappedD3D12ToD3D11Resource;
+
+// D3D12 residency on top of D3D11 eviction priorities. D3D11 pages memory
+// itself, so Evict only marks a resource as first in line to be paged out
+// and MakeResident restores its priority. While the process is over its
+// video memory budget, resources that haven't been used for a while are
+// demoted the same way until they are used again. Resources with views are
+// left alone: descriptor tables are read on the GPU, so their uses are
+// never seen.
+class ResidencyManager {
+   public:
+    static constexpr UINT64 kBudgetPollInterval = 16;
+    static constexpr UINT64 kColdSerials = 64;
+
+    ResidencyManager(ID3D11Device* device, SubmissionTracker* tracker);
+    ~ResidencyManager();
+
+    // Materialized D3D11 resources, size is the estimated allocation
+    void Register(WrappedD3D12ToD3D11Resource* resource,
+                  ID3D11Resource* d3d11Resource, UINT64 size);
+    void Unregister(WrappedD3D12ToD3D11Resource* resource);
+
+    void MakeResident(WrappedD3D12ToD3D11Resource* resource);
+    void Evict(WrappedD3D12ToD3D11Resource* resource);
+    void SetPriority(WrappedD3D12ToD3D11Resource* resource, UINT priority);
+
+    // A view of the resource was written to a descriptor
+    void NoteView(WrappedD3D12ToD3D11Resource* resource);
+
+    // Resources referenced by a submission, which promotes demoted ones
+    void MarkUsed(const std::vector<WrappedD3D12ToD3D11Resource*>& resources,
+                  UINT64 serial);
+
+    // Checks the budget every few submissions and demotes cold resources
+    // while over it
+    void OnSubmitted(UINT64 serial);
+
+   private:
+    struct Entry {
+        ID3D11Resource* resource{nullptr};
+        UINT64 size{0};
+        UINT64 lastUsedSerial{0};
+        UINT priority{DXGI_RESOURCE_PRIORITY_NORMAL};
+        bool evicted{false};
+        bool demoted{false};
+        bool viewed{false};
+    };
+
+    void ApplyPriorityLocked(Entry& entry);
+    void DemoteColdLocked(UINT64 overage);
+
+    SubmissionTracker* const m_tracker;
+    Microsoft::WRL::ComPtr<IDXGIAdapter3> m_adapter;
+
+    std::mutex m_mutex;
+    std::unordered_map<WrappedD3D12ToD3D11Resource*, Entry> m_entries;
+    UINT64 m_lastPollSerial{0};
+};
+
+}  // namespace dxiided
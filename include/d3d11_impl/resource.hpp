@@ -4,14 +4,19 @@
 #include <d3d12.h>
 #include <wrl/client.h>
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 #include "common/debug.hpp"
+#include "d3d11_impl/transient_pool.hpp"
 
 namespace dxiided {
 
 class WrappedD3D12ToD3D11Device;
+class UploadRing;
 
 class WrappedD3D12ToD3D11Resource final : public ID3D12Resource {
    public:
@@ -23,6 +28,13 @@ class WrappedD3D12ToD3D11Resource final : public ID3D12Resource {
                           const D3D12_CLEAR_VALUE* pOptimizedClearValue,
                           REFIID riid, void** ppvResource);
 
+    // Reserved resources are D3D11 tiled resources with no memory of their
+    // own, tiles get mapped from heaps through UpdateTileMappings
+    static HRESULT CreateReserved(WrappedD3D12ToD3D11Device* device,
+                                  const D3D12_RESOURCE_DESC* pDesc,
+                                  D3D12_RESOURCE_STATES InitialState,
+                                  REFIID riid, void** ppvResource);
+
     // Create a WrappedD3D12ToD3D11Resource wrapper around an existing D3D11 resource
     static HRESULT Create(WrappedD3D12ToD3D11Device* device,
                          ID3D11Resource* resource,
@@ -77,20 +89,55 @@ class WrappedD3D12ToD3D11Resource final : public ID3D12Resource {
                          WrappedD3D12ToD3D11Resource* pResourceAfter);
 
     // Helper methods
-    ID3D11Resource* GetD3D11Resource() const { return m_resource.Get(); }
+    // The D3D11 resource is created on first use
+    ID3D11Resource* GetD3D11Resource() {
+        return m_materialized.load() ? m_resource.Get() : Materialize();
+    }
+    ID3D11Resource* Materialize();
+    bool IsValid() const {
+        return m_materialized.load() ||
+               m_d3d11Dimension != D3D11_RESOURCE_DIMENSION_UNKNOWN;
+    }
     static UINT GetMiscFlags(const D3D12_RESOURCE_DESC* pDesc);
-    void StoreInDeviceMap();
+
+    // The D3D11 resource carries a back-pointer to its wrapper in private
+    // data, so the reverse lookup needs no device-wide table
+    void AttachBackPointer();
+    static WrappedD3D12ToD3D11Resource* FromD3D11Resource(
+        ID3D11Resource* resource);
     
     // Format handling methods
     DXGI_FORMAT GetFormat() const { return m_format; }
     void SetFormat(DXGI_FORMAT format) { m_format = format; }
     UINT GetD3D11CPUAccessFlags(const D3D12_HEAP_PROPERTIES* pHeapProperties);
+
+    // CPU shadow of upload heap buffers, null for everything else
+    UploadRing* GetUploadRing() const { return m_uploadRing.get(); }
+
+    // CPU copy of readback heap buffers that completed GPU copies land in
+    uint8_t* GetReadbackShadow() {
+        return m_readbackShadow.empty() ? nullptr : m_readbackShadow.data();
+    }
+    UINT64 GetReadbackShadowSize() const { return m_readbackShadow.size(); }
+
+    // One mip of the materialized D3D11 texture, for staging copies
+    struct SubresourceLayout {
+        D3D11_RESOURCE_DIMENSION dimension;
+        DXGI_FORMAT format;
+        D3D11_USAGE usage;
+        UINT cpuAccessFlags;
+        UINT width;
+        UINT height;
+        UINT depth;
+    };
+    bool GetSubresourceLayout(UINT subresource, SubresourceLayout* layout);
  private:
     WrappedD3D12ToD3D11Resource(WrappedD3D12ToD3D11Device* device,
                                 const D3D12_HEAP_PROPERTIES* pHeapProperties,
                                 D3D12_HEAP_FLAGS HeapFlags,
                                 const D3D12_RESOURCE_DESC* pDesc,
-                                D3D12_RESOURCE_STATES InitialState);
+                                D3D12_RESOURCE_STATES InitialState,
+                                bool reserved = false);
 
     // Constructor for wrapping existing D3D11 resource
     WrappedD3D12ToD3D11Resource(WrappedD3D12ToD3D11Device* device,
@@ -104,6 +151,11 @@ class WrappedD3D12ToD3D11Resource final : public ID3D12Resource {
     static D3D11_USAGE GetD3D11Usage(
         const D3D12_HEAP_PROPERTIES* pHeapProperties);
 
+    // Recycled D3D11 storage for resources whose old contents can't leak
+    bool IsTransientEligible() const;
+    Microsoft::WRL::ComPtr<ID3D11Resource> AcquireTransient(
+        const TransientKey& key);
+
     WrappedD3D12ToD3D11Device* m_device;
     Microsoft::WRL::ComPtr<ID3D11Resource> m_resource;
     D3D12_RESOURCE_DESC m_desc;
@@ -115,6 +167,33 @@ class WrappedD3D12ToD3D11Resource final : public ID3D12Resource {
     bool m_isUAV{false};
     DXGI_FORMAT m_format{DXGI_FORMAT_UNKNOWN};  // Add format member
     D3D12_GPU_VIRTUAL_ADDRESS m_gpuAddress{0};  // GPU virtual address
+    std::unique_ptr<UploadRing> m_uploadRing;
+    bool m_useUploadRing{false};
+    std::vector<uint8_t> m_readbackShadow;
+    // Last contents written to each subresource of a dynamic texture,
+    // tightly packed. Maps discard, so partial writes rewrite all of it.
+    std::unordered_map<UINT, std::vector<uint8_t>> m_dynamicShadows;
+    bool m_transient{false};
+    TransientKey m_transientKey;
+    bool m_reserved{false};
+
+    // Creation parameters kept until the D3D11 resource is materialized
+    struct PendingPrivateData {
+        GUID guid;
+        std::vector<uint8_t> bytes;
+    };
+    union {
+        D3D11_BUFFER_DESC buffer;
+        D3D11_TEXTURE1D_DESC texture1D;
+        D3D11_TEXTURE2D_DESC texture2D;
+        D3D11_TEXTURE3D_DESC texture3D;
+    } m_d3d11Desc{};
+    D3D11_RESOURCE_DIMENSION m_d3d11Dimension{
+        D3D11_RESOURCE_DIMENSION_UNKNOWN};
+    UINT64 m_d3d11Size{0};
+    std::mutex m_materializeMutex;
+    std::atomic<bool> m_materialized{false};
+    std::vector<PendingPrivateData> m_pendingPrivateData;
 
 };
 
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <wrl/client.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "common/debug.hpp"
+
+namespace dxiided {
+
+class WrappedD3D12ToD3D11Resource;
+
+// Creates the D3D11 resources of large lazily created resources on a worker
+// thread, so their first use doesn't pay for the allocation. ID3D11Device is
+// free-threaded; the worker never touches the immediate context. Resources
+// the application releases while queued are dropped without being created.
+class ResourceMaterializer {
+   public:
+    ResourceMaterializer();
+    ~ResourceMaterializer();
+
+    void Enqueue(WrappedD3D12ToD3D11Resource* resource);
+
+   private:
+    void WorkerMain();
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11Resource>> m_queue;
+    std::thread m_worker;
+    bool m_stop{false};
+};
+
+}  // namespace dxiided
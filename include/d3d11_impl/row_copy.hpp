@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dxiided {
+
+// Row repacking between D3D12 footprint pitches and D3D11 mapped pitches.
+// Write-combined destinations, such as mapped dynamic resources, are filled
+// with non-temporal stores so partially written lines are never read back.
+// The SSE2 or AVX2 kernel is picked once from the running CPU.
+void CopyRows(void* dst, size_t dstRowPitch, const void* src,
+              size_t srcRowPitch, size_t rowSize, uint32_t rowCount,
+              bool writeCombined);
+
+void CopySlices(void* dst, size_t dstRowPitch, size_t dstSlicePitch,
+                const void* src, size_t srcRowPitch, size_t srcSlicePitch,
+                size_t rowSize, uint32_t rowCount, uint32_t sliceCount,
+                bool writeCombined);
+
+}  // namespace dxiided
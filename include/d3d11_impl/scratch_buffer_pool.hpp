@@ -0,0 +1,33 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include <map>
+#include <mutex>
+
+#include "common/debug.hpp"
+
+namespace dxiided {
+
+// GPU-only scratch buffers for copies D3D11 can't do in place, such as
+// copies within one buffer. Nothing on the CPU touches them and the driver
+// orders GPU copies that share a buffer, so a single buffer per power of
+// two size serves every command list.
+class ScratchBufferPool {
+   public:
+    explicit ScratchBufferPool(ID3D11Device* device);
+    ~ScratchBufferPool();
+
+    // Returns a buffer of at least size bytes, owned by the pool
+    ID3D11Buffer* Acquire(UINT size);
+
+   private:
+    static constexpr UINT kMinBucketSize = 64 * 1024;
+
+    Microsoft::WRL::ComPtr<ID3D11Device> m_device;
+    std::mutex m_mutex;
+    std::map<UINT, Microsoft::WRL::ComPtr<ID3D11Buffer>> m_buffers;
+};
+
+}  // namespace dxiided
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "common/debug.hpp"
+#include "common/hash.hpp"
+#include "d3d11_impl/dxbc.hpp"
+
+namespace dxiided {
+
+enum class ShaderStage : uint32_t {
+    Vertex,
+    Pixel,
+    Geometry,
+    Hull,
+    Domain,
+    Compute,
+};
+
+struct ShaderModule {
+    ShaderStage stage;
+    Microsoft::WRL::ComPtr<ID3D11DeviceChild> shader;
+    SIZE_T bytecodeLength{0};
+    // Chunks of the original bytecode, which every later user of the same
+    // bytecode can resolve without validating or searching it again
+    DxbcContainerInfo container;
+
+    template <typename T>
+    T* As() const {
+        return static_cast<T*>(shader.Get());
+    }
+};
+
+// D3D11 shader objects keyed by a hash of their bytecode, so pipeline
+// states built from the same shader share one object instead of each
+// creating their own. Modules live as long as the device.
+class ShaderModuleCache {
+   public:
+    explicit ShaderModuleCache(ID3D11Device* device);
+    ~ShaderModuleCache();
+
+    // Returns the module for bytecode, validating and creating it on a
+    // miss
+    HRESULT GetOrCreate(ShaderStage stage, const void* bytecode,
+                        SIZE_T length,
+                        std::shared_ptr<const ShaderModule>* module);
+
+   private:
+    struct Key {
+        Hash128 hash;
+        ShaderStage stage;
+
+        bool operator==(const Key& other) const {
+            return hash == other.hash && stage == other.stage;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return Hash128Hasher()(key.hash) ^ static_cast<size_t>(key.stage);
+        }
+    };
+
+    HRESULT CreateShader(ShaderStage stage, const void* bytecode,
+                         SIZE_T length, ID3D11DeviceChild** shader);
+
+    Microsoft::WRL::ComPtr<ID3D11Device> m_device;
+
+    std::mutex m_mutex;
+    std::unordered_map<Key, std::shared_ptr<const ShaderModule>, KeyHash>
+        m_modules;
+    UINT64 m_hits{0};
+    UINT64 m_misses{0};
+};
+
+}  // namespace dxiided
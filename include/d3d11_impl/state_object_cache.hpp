@@ -0,0 +1,61 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "common/debug.hpp"
+#include "common/hash.hpp"
+#include "d3d11_impl/dxbc.hpp"
+
+namespace dxiided {
+
+// Device-wide D3D11 blend, rasterizer and depth-stencil states and input
+// layouts, keyed by the contents of the translated D3D11 desc. Thousands
+// of pipeline states usually reduce to a few dozen of each, D3D11 allows
+// at most 4096 live state objects per type, and sharing them lets
+// SetPipelineState skip setters by pointer identity. Input layouts are
+// keyed by the vertex shader's input signature chunk, when it has one,
+// rather than its whole bytecode, so shaders with the same inputs share a
+// layout.
+class StateObjectCache {
+   public:
+    explicit StateObjectCache(ID3D11Device* device);
+    ~StateObjectCache();
+
+    HRESULT GetBlendState(const D3D11_BLEND_DESC& desc,
+                          ID3D11BlendState** state);
+    HRESULT GetRasterizerState(const D3D11_RASTERIZER_DESC& desc,
+                               ID3D11RasterizerState** state);
+    HRESULT GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc,
+                                 ID3D11DepthStencilState** state);
+    HRESULT GetInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements,
+                           UINT count, const void* vsBytecode,
+                           SIZE_T vsLength, const DxbcChunk& vsSignature,
+                           ID3D11InputLayout** layout);
+
+   private:
+    template <typename T>
+    struct Table {
+        std::shared_mutex mutex;
+        std::unordered_map<Hash128, Microsoft::WRL::ComPtr<T>, Hash128Hasher>
+            objects;
+    };
+
+    // Lookups only take the lock shared; a miss creates outside the lock
+    // and keeps whichever object was inserted first
+    template <typename T, typename CreateFn>
+    HRESULT GetOrCreate(Table<T>& table, const Hash128& key, CreateFn create,
+                        T** object);
+
+    Microsoft::WRL::ComPtr<ID3D11Device> m_device;
+
+    Table<ID3D11BlendState> m_blendStates;
+    Table<ID3D11RasterizerState> m_rasterizerStates;
+    Table<ID3D11DepthStencilState> m_depthStencilStates;
+    Table<ID3D11InputLayout> m_inputLayouts;
+};
+
+}  // namespace dxiided
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "common/debug.hpp"
+
+namespace dxiided {
+
+// Tracks GPU progress of ExecuteCommandLists batches on the immediate context.
+// Every batch gets a monotonically increasing serial and an event query; a
+// serial is complete once its query (or a later one) has signalled, or once a
+// queue Signal has drained the GPU.
+class SubmissionTracker {
+   public:
+    explicit SubmissionTracker(ID3D11Device* device);
+    ~SubmissionTracker();
+
+    // Serial that the next submission will be tagged with
+    UINT64 GetNextSerial() const { return m_nextSerial.load(); }
+    UINT64 GetLastSubmittedSerial() const { return m_nextSerial.load() - 1; }
+    UINT64 GetCompletedSerial() const { return m_completedSerial.load(); }
+
+    // Ends an event query after the work just recorded on the context and
+    // returns the serial it was tagged with
+    UINT64 Submit(ID3D11DeviceContext* context);
+
+    // Non-blocking check of outstanding queries, returns the completed serial
+    UINT64 Poll(ID3D11DeviceContext* context);
+
+    // Blocks until the given serial has completed on the GPU
+    void WaitForSerial(ID3D11DeviceContext* context, UINT64 serial);
+
+    // Everything up to serial is known to be complete (e.g. after a drain)
+    void MarkCompleted(UINT64 serial);
+
+   private:
+    struct PendingSubmission {
+        UINT64 serial;
+        Microsoft::WRL::ComPtr<ID3D11Query> query;
+    };
+
+    Microsoft::WRL::ComPtr<ID3D11Device> m_device;
+    std::mutex m_mutex;
+    std::deque<PendingSubmission> m_pending;
+    std::vector<Microsoft::WRL::ComPtr<ID3D11Query>> m_freeQueries;
+    std::atomic<UINT64> m_nextSerial{1};
+    std::atomic<UINT64> m_completedSerial{0};
+};
+
+}  // namespace dxiided
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <d3d11_2.h>
+#include <wrl/client.h>
+
+#include <mutex>
+
+#include "common/debug.hpp"
+#include "common/range_allocator.hpp"
+
+namespace dxiided {
+
+// Physical memory behind the tiles of ID3D12Heap objects. A D3D11 tiled
+// resource can only map tiles from a single tile pool, so every heap gets a
+// range of one shared pool instead of a pool of its own. The pool grows with
+// ResizeTilePool, which keeps the existing tiles and their mappings.
+class TilePoolManager {
+   public:
+    static constexpr UINT kTileSize = D3D11_2_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+
+    TilePoolManager(ID3D11Device* device, ID3D11DeviceContext* context);
+    ~TilePoolManager();
+
+    bool IsSupported() const {
+        return m_tier != D3D11_TILED_RESOURCES_NOT_SUPPORTED;
+    }
+    D3D11_TILED_RESOURCES_TIER GetTier() const { return m_tier; }
+    ID3D11DeviceContext2* GetContext2() { return m_context2.Get(); }
+
+    // Null until the first heap reserves tiles
+    ID3D11Buffer* GetTilePool();
+
+    // Tiles covering all of a tiled resource, packed mips included
+    UINT GetTileCount(ID3D11Resource* resource);
+
+    // Reserves tileCount consecutive tiles, growing the pool when no free
+    // range is large enough
+    HRESULT Allocate(UINT tileCount, UINT* firstTile);
+    void Free(UINT firstTile, UINT tileCount);
+
+   private:
+    static constexpr UINT kMinPoolTiles = 64 * 1024 * 1024 / kTileSize;
+
+    HRESULT GrowLocked(UINT minTiles);
+
+    Microsoft::WRL::ComPtr<ID3D11Device2> m_device2;
+    Microsoft::WRL::ComPtr<ID3D11DeviceContext2> m_context2;
+    D3D11_TILED_RESOURCES_TIER m_tier{D3D11_TILED_RESOURCES_NOT_SUPPORTED};
+
+    std::mutex m_mutex;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> m_pool;
+    UINT m_poolTiles{0};
+    RangeAllocator m_freeTiles;
+};
+
+}  // namespace dxiided
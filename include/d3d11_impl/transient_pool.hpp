@@ -0,0 +1,99 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#include "common/debug.hpp"
+
+namespace dxiided {
+
+class SubmissionTracker;
+
+// Every field of a D3D11 creation desc; two resources with equal keys are
+// interchangeable.
+struct TransientKey {
+    D3D11_RESOURCE_DIMENSION dimension{D3D11_RESOURCE_DIMENSION_UNKNOWN};
+    UINT width{0};
+    UINT height{0};
+    UINT depthOrArraySize{0};
+    UINT mipLevels{0};
+    DXGI_FORMAT format{DXGI_FORMAT_UNKNOWN};
+    UINT sampleCount{0};
+    UINT sampleQuality{0};
+    D3D11_USAGE usage{D3D11_USAGE_DEFAULT};
+    UINT bindFlags{0};
+    UINT cpuAccessFlags{0};
+    UINT miscFlags{0};
+    UINT structureByteStride{0};
+
+    static TransientKey FromDesc(const D3D11_BUFFER_DESC& desc);
+    static TransientKey FromDesc(const D3D11_TEXTURE1D_DESC& desc);
+    static TransientKey FromDesc(const D3D11_TEXTURE2D_DESC& desc);
+    static TransientKey FromDesc(const D3D11_TEXTURE3D_DESC& desc);
+
+    bool operator==(const TransientKey& other) const;
+};
+
+struct TransientKeyHash {
+    size_t operator()(const TransientKey& key) const;
+};
+
+// Holds on to D3D11 resources released by short-lived D3D12 resources and
+// hands them back to creations with the same desc. A released resource only
+// becomes reusable once the last submission at release time has completed,
+// and is dropped if nothing claims it within a few submissions.
+class TransientResourcePool {
+   public:
+    static constexpr UINT64 kMaxPooledBytes = 256ull << 20;
+    static constexpr UINT64 kMaxEntryBytes = 64ull << 20;
+    static constexpr UINT64 kMaxAgeSerials = 8;
+    static constexpr UINT64 kReportInterval = 1024;
+
+    struct Stats {
+        UINT64 hits;
+        UINT64 misses;
+        UINT64 evictions;
+        UINT64 pooledBytes;
+        size_t pooledCount;
+    };
+
+    explicit TransientResourcePool(SubmissionTracker* tracker);
+    ~TransientResourcePool();
+
+    // Returns a recycled resource matching key, or null on a miss
+    Microsoft::WRL::ComPtr<ID3D11Resource> Acquire(const TransientKey& key);
+    void Release(const TransientKey& key, ID3D11Resource* resource,
+                 UINT64 size);
+
+    // Called once per submission to drop resources nobody reused
+    void Trim(ID3D11DeviceContext* context);
+
+    Stats GetStats() const;
+
+   private:
+    struct Entry {
+        Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+        UINT64 releaseSerial;
+        UINT64 size;
+    };
+
+    void EvictOldestLocked();
+
+    SubmissionTracker* const m_tracker;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<TransientKey, std::deque<Entry>, TransientKeyHash>
+        m_entries;
+    UINT64 m_pooledBytes{0};
+    size_t m_pooledCount{0};
+    UINT64 m_hits{0};
+    UINT64 m_misses{0};
+    UINT64 m_evictions{0};
+    UINT64 m_lastReportSerial{0};
+};
+
+}  // namespace dxiided
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "common/debug.hpp"
+#include "common/version_ring.hpp"
+
+namespace dxiided {
+
+class SubmissionTracker;
+
+// Backing store for a buffer on an UPLOAD heap. The application maps a CPU
+// shadow that the GPU never reads; dirty ranges are pushed through a small
+// ring of staging versions into the GPU buffer right before each submission.
+// A version is only rewritten once the submission that last consumed it has
+// completed, so CPU writes never stall on, or corrupt, frames in flight.
+class UploadRing {
+   public:
+    static constexpr size_t kMaxVersions = 4;
+
+    static std::unique_ptr<UploadRing> Create(ID3D11Device* device,
+                                              ID3D11Buffer* target);
+    ~UploadRing();
+
+    void* Map();
+    void Unmap(SIZE_T writtenBegin, SIZE_T writtenEnd);
+    bool IsMapped() const { return m_mapCount.load() > 0; }
+    const uint8_t* GetShadow() const { return m_shadow; }
+    UINT GetSize() const { return m_size; }
+
+    // Forces the next flush to copy the whole shadow, for recycled targets
+    // whose GPU contents don't match the fresh shadow
+    void MarkAllDirty() { m_flushAll.store(true); }
+
+    // Copies pending CPU writes into the target buffer on the immediate
+    // context. The version used can't be reused until MarkSubmitted tags
+    // it with the serial of the submission that reads it. Returns S_FALSE
+    // if nothing was dirty.
+    HRESULT Flush(ID3D11DeviceContext* context, SubmissionTracker* tracker,
+                  size_t* version);
+    void MarkSubmitted(size_t version, UINT64 serial);
+
+   private:
+    struct DirtyRange {
+        UINT begin;
+        UINT end;
+    };
+
+    UploadRing(ID3D11Device* device, ID3D11Buffer* target, UINT size);
+
+    bool CollectDirtyRanges(std::vector<DirtyRange>* ranges);
+    // Returns VersionRing::kNoVersion if no version can be written
+    size_t AcquireVersion(ID3D11DeviceContext* context,
+                          SubmissionTracker* tracker);
+
+    Microsoft::WRL::ComPtr<ID3D11Device> m_device;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> m_target;
+    UINT m_size;
+    uint8_t* m_shadow{nullptr};
+    bool m_writeWatch{false};
+    std::vector<void*> m_watchAddresses;
+    // Staging buffers, indexed by the versions of m_ring
+    std::vector<Microsoft::WRL::ComPtr<ID3D11Buffer>> m_versions;
+    VersionRing m_ring{kMaxVersions};
+    std::atomic<LONG> m_mapCount{0};
+    std::atomic<bool> m_flushAll{false};
+    std::mutex m_dirtyMutex;
+    UINT m_dirtyBegin{0};
+    UINT m_dirtyEnd{0};
+};
+
+// Keeps the set of upload rings with CPU writes that still have to reach the
+// GPU, and flushes them when the command queue submits work.
+class UploadRingManager {
+   public:
+    explicit UploadRingManager(SubmissionTracker* tracker);
+    ~UploadRingManager();
+
+    struct FlushedVersion {
+        UploadRing* ring;
+        size_t version;
+    };
+
+    void Activate(UploadRing* ring);
+    void Remove(UploadRing* ring);
+    // Flushes the active rings, appending the versions used to flushed
+    void FlushPending(ID3D11DeviceContext* context,
+                      std::vector<FlushedVersion>* flushed);
+    // Tags flushed versions with the serial their submission signals.
+    // Versions of rings removed in between are skipped.
+    void MarkSubmitted(const std::vector<FlushedVersion>& flushed,
+                       UINT64 serial);
+
+   private:
+    SubmissionTracker* const m_tracker;
+    std::mutex m_mutex;
+    std::unordered_set<UploadRing*> m_active;
+    // Flushed versions per ring still waiting for their serial
+    std::unordered_map<UploadRing*, size_t> m_unsubmitted;
+};
+
+}  // namespace dxiided
@@ -0,0 +1,68 @@
+#include "common/config.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "common/debug.hpp"
+
+namespace dxiided {
+
+const Config& Config::Instance() {
+    static Config instance;
+    return instance;
+}
+
+Config::Config()
+    : m_lazyResources(GetEnvBool("DXIIDED_LAZY_RESOURCES", true)),
+      m_backgroundCreate(GetEnvBool("DXIIDED_BACKGROUND_CREATE", false)),
+      m_backgroundCreateMinSize(
+          GetEnvUInt("DXIIDED_BACKGROUND_CREATE_MIN_SIZE", 4ull << 20)),
+      m_memoryStatsInterval(GetEnvUInt("DXIIDED_MEMORY_STATS_INTERVAL", 1024)),
+      m_memoryStatsOnExit(GetEnvBool("DXIIDED_MEMORY_STATS_ON_EXIT", false)),
+      m_asyncPipelineCompile(GetEnvBool("DXIIDED_ASYNC_PSO", false)),
+      m_pipelineCompileThreads(GetEnvUInt("DXIIDED_PSO_COMPILE_THREADS", 0)),
+      m_pipelineCachePath(GetEnvString("DXIIDED_PIPELINE_CACHE_PATH")),
+      m_pipelineCachePrewarm(
+          GetEnvBool("DXIIDED_PIPELINE_CACHE_PREWARM", true)) {
+    TRACE("Config: lazy resources %d, background create %d (>= %llu bytes)",
+          m_lazyResources, m_backgroundCreate,
+          static_cast<unsigned long long>(m_backgroundCreateMinSize));
+    TRACE("Config: memory stats every %llu submissions, on exit %d",
+          static_cast<unsigned long long>(m_memoryStatsInterval),
+          m_memoryStatsOnExit);
+    TRACE("Config: async pipeline compile %d, %llu threads",
+          m_asyncPipelineCompile,
+          static_cast<unsigned long long>(m_pipelineCompileThreads));
+    TRACE("Config: pipeline cache \"%s\", prewarm %d",
+          m_pipelineCachePath.c_str(), m_pipelineCachePrewarm);
+}
+
+bool Config::GetEnvBool(const char* name, bool defaultValue) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) {
+        return defaultValue;
+    }
+    return strcmp(value, "0") != 0 && _stricmp(value, "false") != 0;
+}
+
+uint64_t Config::GetEnvUInt(const char* name, uint64_t defaultValue) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) {
+        return defaultValue;
+    }
+
+    char* end = nullptr;
+    unsigned long long parsed = std::strtoull(value, &end, 0);
+    if (*end) {
+        WARN("Ignoring invalid value \"%s\" for %s", value, name);
+        return defaultValue;
+    }
+    return parsed;
+}
+
+std::string Config::GetEnvString(const char* name) {
+    const char* value = std::getenv(name);
+    return value ? value : "";
+}
+
+}  // namespace dxiided
@@ -0,0 +1,126 @@
+#include "common/hash.hpp"
+
+#include <cstring>
+
+namespace dxiided {
+
+namespace {
+
+constexpr uint64_t kC1 = 0x87c37b91114253d5ull;
+constexpr uint64_t kC2 = 0x4cf5ad432745937full;
+
+inline uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t Load64(const uint8_t* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t Mix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+}  // namespace
+
+void Hasher128::ProcessBlock(const uint8_t* block) {
+    uint64_t k1 = Load64(block);
+    uint64_t k2 = Load64(block + 8);
+
+    k1 *= kC1;
+    k1 = Rotl(k1, 31);
+    k1 *= kC2;
+    m_h1 ^= k1;
+    m_h1 = Rotl(m_h1, 27);
+    m_h1 += m_h2;
+    m_h1 = m_h1 * 5 + 0x52dce729;
+
+    k2 *= kC2;
+    k2 = Rotl(k2, 33);
+    k2 *= kC1;
+    m_h2 ^= k2;
+    m_h2 = Rotl(m_h2, 31);
+    m_h2 += m_h1;
+    m_h2 = m_h2 * 5 + 0x38495ab5;
+}
+
+void Hasher128::Update(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    m_length += size;
+
+    // Top up a partial block left by the previous call first
+    if (m_tailSize) {
+        size_t fill = sizeof(m_tail) - m_tailSize;
+        if (size < fill) {
+            memcpy(m_tail + m_tailSize, bytes, size);
+            m_tailSize += size;
+            return;
+        }
+        memcpy(m_tail + m_tailSize, bytes, fill);
+        ProcessBlock(m_tail);
+        bytes += fill;
+        size -= fill;
+        m_tailSize = 0;
+    }
+
+    for (; size >= sizeof(m_tail); bytes += 16, size -= 16) {
+        ProcessBlock(bytes);
+    }
+
+    if (size) {
+        memcpy(m_tail, bytes, size);
+        m_tailSize = size;
+    }
+}
+
+void Hasher128::UpdateString(const char* str) {
+    if (!str) {
+        str = "";
+    }
+    Update(str, strlen(str) + 1);
+}
+
+Hash128 Hasher128::Finalize() const {
+    uint64_t h1 = m_h1;
+    uint64_t h2 = m_h2;
+
+    if (m_tailSize) {
+        uint8_t block[16] = {};
+        memcpy(block, m_tail, m_tailSize);
+        uint64_t k1 = Load64(block);
+        uint64_t k2 = Load64(block + 8);
+        if (m_tailSize > 8) {
+            k2 *= kC2;
+            k2 = Rotl(k2, 33);
+            k2 *= kC1;
+            h2 ^= k2;
+        }
+        k1 *= kC1;
+        k1 = Rotl(k1, 31);
+        k1 *= kC2;
+        h1 ^= k1;
+    }
+
+    h1 ^= m_length;
+    h2 ^= m_length;
+    h1 += h2;
+    h2 += h1;
+    h1 = Mix64(h1);
+    h2 = Mix64(h2);
+    h1 += h2;
+    h2 += h1;
+    return {h1, h2};
+}
+
+Hash128 ComputeHash128(const void* data, size_t size) {
+    Hasher128 hasher;
+    hasher.Update(data, size);
+    return hasher.Finalize();
+}
+
+}  // namespace dxiided
@@ -0,0 +1,91 @@
+#include "common/memory_stats.hpp"
+
+#include <cstdio>
+#include <string>
+
+#include "common/config.hpp"
+#include "common/debug.hpp"
+
+namespace dxiided {
+
+namespace {
+
+constexpr const char* kCategoryNames[kMemoryCategoryCount] = {
+    "default", "upload", "readback", "custom",
+    "upload-shadow", "upload-staging", "readback-shadow",
+    "readback-staging", "transient", "scratch", "tile-pool",
+    "descriptors", "views", "pso-cache", "shaders",
+};
+
+}  // namespace
+
+MemoryStats& MemoryStats::Instance() {
+    static MemoryStats instance;
+    return instance;
+}
+
+MemoryStats::MemoryStats() {
+    // Also makes sure the logger outlives the exit dump
+    TRACE("MemoryStats created");
+}
+
+MemoryStats::~MemoryStats() {
+    if (Config::Instance().MemoryStatsOnExit()) {
+        Log();
+    }
+}
+
+void MemoryStats::Add(MemoryCategory category, UINT64 bytes) {
+    UINT index = static_cast<UINT>(category);
+    UINT64 current = m_current[index].fetch_add(bytes) + bytes;
+    UINT64 peak = m_peak[index].load();
+    while (current > peak &&
+           !m_peak[index].compare_exchange_weak(peak, current)) {
+    }
+}
+
+void MemoryStats::Remove(MemoryCategory category, UINT64 bytes) {
+    m_current[static_cast<UINT>(category)].fetch_sub(bytes);
+}
+
+MemoryCounter MemoryStats::Get(MemoryCategory category) const {
+    UINT index = static_cast<UINT>(category);
+    return {m_current[index].load(), m_peak[index].load()};
+}
+
+const char* MemoryStats::GetName(MemoryCategory category) {
+    UINT index = static_cast<UINT>(category);
+    return index < kMemoryCategoryCount ? kCategoryNames[index] : "unknown";
+}
+
+void MemoryStats::Log() const {
+    // current/peak in KiB, categories that were never used are left out
+    std::string line;
+    for (UINT i = 0; i < kMemoryCategoryCount; ++i) {
+        UINT64 peak = m_peak[i].load();
+        if (!peak) {
+            continue;
+        }
+        char entry[64];
+        snprintf(entry, sizeof(entry), " %s=%llu/%lluK", kCategoryNames[i],
+                 static_cast<unsigned long long>(m_current[i].load() >> 10),
+                 static_cast<unsigned long long>(peak >> 10));
+        line += entry;
+    }
+    TRACE("Memory:%s", line.empty() ? " none" : line.c_str());
+}
+
+void MemoryStats::OnSubmitted(UINT64 serial) {
+    UINT64 interval = Config::Instance().MemoryStatsInterval();
+    if (!interval) {
+        return;
+    }
+
+    UINT64 last = m_lastLogSerial.load();
+    if (serial - last >= interval &&
+        m_lastLogSerial.compare_exchange_strong(last, serial)) {
+        Log();
+    }
+}
+
+}  // namespace dxiided
@@ -0,0 +1,48 @@
+#include "common/range_allocator.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace dxiided {
+
+bool RangeAllocator::Allocate(uint32_t count, uint32_t* first) {
+    // First fit keeps low units busy and leaves the tail free for growth
+    auto it = std::find_if(
+        m_freeRanges.begin(), m_freeRanges.end(),
+        [count](const auto& range) { return range.second >= count; });
+    if (it == m_freeRanges.end()) {
+        return false;
+    }
+
+    *first = it->first;
+    uint32_t remaining = it->second - count;
+    m_freeRanges.erase(it);
+    if (remaining) {
+        m_freeRanges.emplace(*first + count, remaining);
+    }
+    return true;
+}
+
+void RangeAllocator::AddFree(uint32_t first, uint32_t count) {
+    if (!count) {
+        return;
+    }
+
+    auto it = m_freeRanges.emplace(first, count).first;
+
+    // Merge with the following and preceding free ranges
+    auto next = std::next(it);
+    if (next != m_freeRanges.end() && it->first + it->second == next->first) {
+        it->second += next->second;
+        m_freeRanges.erase(next);
+    }
+    if (it != m_freeRanges.begin()) {
+        auto prev = std::prev(it);
+        if (prev->first + prev->second == it->first) {
+            prev->second += it->second;
+            m_freeRanges.erase(it);
+        }
+    }
+}
+
+}  // namespace dxiided
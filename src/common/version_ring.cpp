@@ -0,0 +1,43 @@
+#include "common/version_ring.hpp"
+
+namespace dxiided {
+
+size_t VersionRing::AcquireIdle(uint64_t completedSerial) {
+    // Prefer the next version in ring order whose last reader has finished
+    for (size_t i = 0; i < m_serials.size(); ++i) {
+        size_t index = (m_next + i) % m_serials.size();
+        if (m_serials[index] <= completedSerial) {
+            m_next = (index + 1) % m_serials.size();
+            return index;
+        }
+    }
+    return kNoVersion;
+}
+
+size_t VersionRing::Grow() {
+    m_serials.push_back(0);
+    m_next = 0;
+    return m_serials.size() - 1;
+}
+
+size_t VersionRing::AcquireOldest() {
+    if (m_serials.empty()) {
+        return kNoVersion;
+    }
+
+    // Versions that are not part of a submission yet have nothing to wait
+    // for
+    size_t oldest = 0;
+    for (size_t i = 1; i < m_serials.size(); ++i) {
+        if (m_serials[i] < m_serials[oldest]) {
+            oldest = i;
+        }
+    }
+    if (m_serials[oldest] == kUnsubmittedSerial) {
+        return kNoVersion;
+    }
+    m_next = (oldest + 1) % m_serials.size();
+    return oldest;
+}
+
+}  // namespace dxiided
@@ -0,0 +1,363 @@
+#include "d3d11_impl/allocation_info.hpp"
+
+#include <algorithm>
+
+#include "d3d11_impl/format_info.hpp"
+
+namespace dxiided {
+
+namespace {
+
+constexpr UINT64 kInvalidSize = ~0ull;
+
+UINT64 AlignUp(UINT64 value, UINT64 alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+UINT GetMipCount(const D3D12_RESOURCE_DESC& desc) {
+    if (desc.MipLevels) {
+        return desc.MipLevels;
+    }
+
+    // Zero asks for the full chain
+    UINT64 largest = std::max<UINT64>(desc.Width, desc.Height);
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D) {
+        largest = std::max<UINT64>(largest, desc.DepthOrArraySize);
+    }
+    UINT count = 1;
+    while (largest > 1) {
+        largest >>= 1;
+        count++;
+    }
+    return count;
+}
+
+UINT64 GetSubresourceSize(DXGI_FORMAT format, UINT64 width, UINT height,
+                          UINT depth) {
+    UINT64 rowPitch = AlignUp(GetFormatRowSize(format, width),
+                              D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+    UINT64 rows = GetFormatRowCount(format, height);
+    return AlignUp(rowPitch * rows * depth,
+                   D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+}
+
+}  // namespace
+
+AllocationInfoCache::AllocationInfoCache() {
+    TRACE("AllocationInfoCache created");
+}
+
+AllocationInfoCache::~AllocationInfoCache() {
+    TRACE("AllocationInfoCache destroyed, %zu descs cached", m_cache.size());
+}
+
+D3D12_RESOURCE_ALLOCATION_INFO AllocationInfoCache::GetInfo(
+    UINT numDescs, const D3D12_RESOURCE_DESC* descs) {
+    D3D12_RESOURCE_ALLOCATION_INFO combined = {0, 0};
+    if (!numDescs || !descs) {
+        return combined;
+    }
+
+    for (UINT i = 0; i < numDescs; ++i) {
+        D3D12_RESOURCE_ALLOCATION_INFO info = GetInfo(descs[i]);
+        if (info.SizeInBytes == kInvalidSize) {
+            return info;
+        }
+
+        combined.SizeInBytes =
+            AlignUp(combined.SizeInBytes, info.Alignment) + info.SizeInBytes;
+        combined.Alignment = std::max(combined.Alignment, info.Alignment);
+    }
+    return combined;
+}
+
+D3D12_RESOURCE_ALLOCATION_INFO AllocationInfoCache::GetInfo(
+    const D3D12_RESOURCE_DESC& desc) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_cache.find(desc);
+        if (it != m_cache.end()) {
+            return it->second;
+        }
+    }
+
+    D3D12_RESOURCE_ALLOCATION_INFO info = Calculate(desc);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_cache.size() >= kMaxEntries) {
+        m_cache.clear();
+    }
+    m_cache.emplace(desc, info);
+    return info;
+}
+
+D3D12_RESOURCE_ALLOCATION_INFO AllocationInfoCache::Calculate(
+    const D3D12_RESOURCE_DESC& desc) {
+    D3D12_RESOURCE_ALLOCATION_INFO info = {};
+    info.SizeInBytes = kInvalidSize;
+    info.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER) {
+        if (desc.Alignment &&
+            desc.Alignment != D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT) {
+            ERR("Invalid buffer alignment %llu", desc.Alignment);
+            return info;
+        }
+        info.SizeInBytes =
+            AlignUp(desc.Width, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+        return info;
+    }
+
+    if (desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE1D &&
+        desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D &&
+        desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE3D) {
+        ERR("Invalid resource dimension %d", desc.Dimension);
+        return info;
+    }
+
+    bool is3D = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+    UINT arraySize = is3D ? 1 : std::max<UINT>(desc.DepthOrArraySize, 1);
+    UINT depth = is3D ? std::max<UINT>(desc.DepthOrArraySize, 1) : 1;
+    UINT height = std::max<UINT>(desc.Height, 1);
+    UINT samples = std::max<UINT>(desc.SampleDesc.Count, 1);
+    UINT mipCount = GetMipCount(desc);
+
+    // Planes of planar and depth-stencil formats are sized separately,
+    // with their own format and subsampling
+    UINT64 sliceSize = 0;
+    UINT64 topMipSize = 0;
+    UINT planeCount = GetFormatInfo(desc.Format).planeCount;
+    for (UINT plane = 0; plane < planeCount; ++plane) {
+        FormatPlane planeFormat = GetFormatPlane(desc.Format, plane);
+        UINT64 planeWidth =
+            (desc.Width + (1ull << planeFormat.widthShift) - 1) >>
+            planeFormat.widthShift;
+        UINT planeHeight =
+            (height + (1u << planeFormat.heightShift) - 1) >>
+            planeFormat.heightShift;
+        for (UINT mip = 0; mip < mipCount; ++mip) {
+            UINT64 size = GetSubresourceSize(
+                planeFormat.format, std::max<UINT64>(planeWidth >> mip, 1),
+                std::max(planeHeight >> mip, 1u), std::max(depth >> mip, 1u));
+            if (mip == 0) {
+                topMipSize += size * samples;
+            }
+            sliceSize += size;
+        }
+    }
+    UINT64 totalSize = sliceSize * arraySize * samples;
+
+    // Small placement is only granted when asked for and the most detailed
+    // mip fits into 64 KB (4 MB for MSAA)
+    bool msaa = samples > 1;
+    UINT64 defaultAlignment =
+        msaa ? D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT
+             : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    UINT64 smallAlignment = msaa
+                                ? D3D12_SMALL_MSAA_RESOURCE_PLACEMENT_ALIGNMENT
+                                : D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+    bool smallAllowed =
+        topMipSize <= defaultAlignment &&
+        (msaa || !(desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET |
+                                 D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)));
+
+    UINT64 alignment = defaultAlignment;
+    if (desc.Alignment == smallAlignment && smallAllowed) {
+        alignment = smallAlignment;
+    } else if (desc.Alignment && desc.Alignment != defaultAlignment &&
+               desc.Alignment != smallAlignment) {
+        ERR("Invalid texture alignment %llu", desc.Alignment);
+        return info;
+    }
+
+    info.Alignment = alignment;
+    info.SizeInBytes = AlignUp(totalSize, alignment);
+    return info;
+}
+
+size_t ResourceDescHash::operator()(const D3D12_RESOURCE_DESC& desc) const {
+    const UINT64 fields[] = {static_cast<UINT64>(desc.Dimension),
+                             desc.Alignment,
+                             desc.Width,
+                             desc.Height,
+                             desc.DepthOrArraySize,
+                             desc.MipLevels,
+                             static_cast<UINT64>(desc.Format),
+                             desc.SampleDesc.Count,
+                             desc.SampleDesc.Quality,
+                             static_cast<UINT64>(desc.Layout),
+                             static_cast<UINT64>(desc.Flags)};
+
+    // FNV-1a over the desc fields
+    UINT64 hash = 14695981039346656037ull;
+    for (UINT64 field : fields) {
+        hash = (hash ^ field) * 1099511628211ull;
+    }
+    return static_cast<size_t>(hash);
+}
+
+bool ResourceDescEqual::operator()(const D3D12_RESOURCE_DESC& a,
+                                   const D3D12_RESOURCE_DESC& b) const {
+    return a.Dimension == b.Dimension && a.Alignment == b.Alignment &&
+           a.Width == b.Width && a.Height == b.Height &&
+           a.DepthOrArraySize == b.DepthOrArraySize &&
+           a.MipLevels == b.MipLevels && a.Format == b.Format &&
+           a.SampleDesc.Count == b.SampleDesc.Count &&
+           a.SampleDesc.Quality == b.SampleDesc.Quality &&
+           a.Layout == b.Layout && a.Flags == b.Flags;
+}
+
+FootprintCache::FootprintCache() { TRACE("FootprintCache created"); }
+
+FootprintCache::~FootprintCache() {
+    TRACE("FootprintCache destroyed, %zu ranges cached", m_cache.size());
+}
+
+std::shared_ptr<const FootprintSet> FootprintCache::Get(
+    const D3D12_RESOURCE_DESC& desc, UINT firstSubresource,
+    UINT numSubresources) {
+    Key key = {desc, firstSubresource, numSubresources};
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_cache.find(key);
+        if (it != m_cache.end()) {
+            return it->second;
+        }
+    }
+
+    auto set = std::make_shared<FootprintSet>();
+    if (!Calculate(desc, firstSubresource, numSubresources, set.get())) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_cache.size() >= kMaxEntries) {
+        m_cache.clear();
+    }
+    m_cache.emplace(key, set);
+    return set;
+}
+
+bool FootprintCache::Calculate(const D3D12_RESOURCE_DESC& desc,
+                               UINT firstSubresource, UINT numSubresources,
+                               FootprintSet* set) {
+    set->layouts.resize(numSubresources);
+    set->numRows.resize(numSubresources);
+    set->rowSizes.resize(numSubresources);
+    set->totalBytes = 0;
+
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER) {
+        if (firstSubresource != 0 || numSubresources > 1) {
+            return false;
+        }
+        if (numSubresources) {
+            D3D12_PLACED_SUBRESOURCE_FOOTPRINT& layout = set->layouts[0];
+            layout.Offset = 0;
+            layout.Footprint.Format = DXGI_FORMAT_UNKNOWN;
+            layout.Footprint.Width = static_cast<UINT>(desc.Width);
+            layout.Footprint.Height = 1;
+            layout.Footprint.Depth = 1;
+            layout.Footprint.RowPitch = static_cast<UINT>(
+                AlignUp(desc.Width, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT));
+            set->numRows[0] = 1;
+            set->rowSizes[0] = desc.Width;
+            set->totalBytes = desc.Width;
+        }
+        return true;
+    }
+
+    const FormatInfo& info = GetFormatInfo(desc.Format);
+    if (!info.bytesPerBlock) {
+        ERR("Unsupported format %d", desc.Format);
+        return false;
+    }
+
+    bool is3D = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+    UINT mipCount = GetMipCount(desc);
+    UINT arraySize = is3D ? 1 : std::max<UINT>(desc.DepthOrArraySize, 1);
+    UINT depth = is3D ? std::max<UINT>(desc.DepthOrArraySize, 1) : 1;
+    UINT height = std::max<UINT>(desc.Height, 1);
+    UINT64 subresourceCount =
+        static_cast<UINT64>(mipCount) * arraySize * info.planeCount;
+    if (firstSubresource + static_cast<UINT64>(numSubresources) >
+        subresourceCount) {
+        ERR("Subresources %u+%u out of range for %llu subresources",
+            firstSubresource, numSubresources, subresourceCount);
+        return false;
+    }
+
+    // Every array slice shares its plane's mip chain layout. Planes of
+    // planar formats have their own format and subsampled size. Block
+    // sizes are powers of two, so rounding to whole blocks is a mask.
+    std::vector<D3D12_SUBRESOURCE_FOOTPRINT> mipFootprints(
+        static_cast<size_t>(mipCount) * info.planeCount);
+    std::vector<UINT> mipRows(mipFootprints.size());
+    std::vector<UINT64> mipRowSizes(mipFootprints.size());
+    for (UINT plane = 0; plane < info.planeCount; ++plane) {
+        FormatPlane planeFormat = GetFormatPlane(desc.Format, plane);
+        const FormatInfo& planeInfo = GetFormatInfo(planeFormat.format);
+        UINT blockWidthMask = planeInfo.blockWidth - 1;
+        UINT blockHeightMask = planeInfo.blockHeight - 1;
+        UINT64 planeWidth =
+            (desc.Width + (1ull << planeFormat.widthShift) - 1) >>
+            planeFormat.widthShift;
+        UINT planeHeight =
+            (height + (1u << planeFormat.heightShift) - 1) >>
+            planeFormat.heightShift;
+        for (UINT mip = 0; mip < mipCount; ++mip) {
+            size_t index = static_cast<size_t>(plane) * mipCount + mip;
+            D3D12_SUBRESOURCE_FOOTPRINT& footprint = mipFootprints[index];
+            UINT mipWidth =
+                std::max(static_cast<UINT>(planeWidth >> mip), 1u);
+            UINT mipHeight = std::max(planeHeight >> mip, 1u);
+            footprint.Format = planeFormat.format;
+            footprint.Width = (mipWidth + blockWidthMask) & ~blockWidthMask;
+            footprint.Height =
+                (mipHeight + blockHeightMask) & ~blockHeightMask;
+            footprint.Depth = std::max(depth >> mip, 1u);
+
+            mipRowSizes[index] =
+                GetFormatRowSize(planeFormat.format, footprint.Width);
+            mipRows[index] =
+                GetFormatRowCount(planeFormat.format, footprint.Height);
+            footprint.RowPitch = static_cast<UINT>(AlignUp(
+                mipRowSizes[index], D3D12_TEXTURE_DATA_PITCH_ALIGNMENT));
+        }
+    }
+
+    UINT64 offset = 0;
+    for (UINT i = 0; i < numSubresources; ++i) {
+        UINT subresource = firstSubresource + i;
+        UINT mip = subresource % mipCount;
+        UINT plane = subresource / mipCount / arraySize;
+        size_t index = static_cast<size_t>(plane) * mipCount + mip;
+        const D3D12_SUBRESOURCE_FOOTPRINT& footprint = mipFootprints[index];
+        offset = AlignUp(offset, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+        set->layouts[i].Offset = offset;
+        set->layouts[i].Footprint = footprint;
+        set->numRows[i] = mipRows[index];
+        set->rowSizes[i] = mipRowSizes[index];
+
+        // The last row of the last slice doesn't need its padding
+        UINT64 rows = static_cast<UINT64>(mipRows[index]) * footprint.Depth;
+        UINT64 size = footprint.RowPitch * (rows - 1) + mipRowSizes[index];
+        set->totalBytes = offset + size;
+        offset += size;
+    }
+    return true;
+}
+
+size_t FootprintCache::KeyHash::operator()(const Key& key) const {
+    UINT64 hash = ResourceDescHash()(key.desc);
+    hash = (hash ^ key.firstSubresource) * 1099511628211ull;
+    hash = (hash ^ key.numSubresources) * 1099511628211ull;
+    return static_cast<size_t>(hash);
+}
+
+bool FootprintCache::KeyEqual::operator()(const Key& a, const Key& b) const {
+    return a.firstSubresource == b.firstSubresource &&
+           a.numSubresources == b.numSubresources &&
+           ResourceDescEqual()(a.desc, b.desc);
+}
+
+}  // namespace dxiided
@@ -2,12 +2,138 @@
 #include "d3d11_impl/pipeline_state.hpp"
 #include "d3d11_impl/resource.hpp"
 
+#include <algorithm>
+
 #include "common/debug.hpp"
 #include "common/debug_symbols.hpp"
 #include "d3d11_impl/device.hpp"
+#include "d3d11_impl/format_info.hpp"
+#include "d3d11_impl/upload_ring.hpp"
 
 namespace dxiided {
 
+namespace {
+
+// Tiles read back through one scratch buffer, 64 MB worth
+constexpr UINT kTileReadbackChunk = 1024;
+
+struct TileRun {
+    D3D11_TILED_RESOURCE_COORDINATE coordinate;
+    D3D11_TILE_REGION_SIZE size;
+};
+
+// Moves a coordinate count tiles further along the walk linear tile
+// regions take: x, y and z within a subresource, then on to the next one.
+// A packed mip tail is one run of tiles addressed by its first mip.
+bool AdvanceTileCoordinate(const std::vector<D3D12_SUBRESOURCE_TILING>& tilings,
+                           const D3D12_PACKED_MIP_INFO& packed, UINT mipCount,
+                           D3D11_TILED_RESOURCE_COORDINATE* coordinate,
+                           UINT64 count) {
+    while (coordinate->Subresource < tilings.size()) {
+        const D3D12_SUBRESOURCE_TILING& tiling =
+            tilings[coordinate->Subresource];
+        bool packedTail =
+            tiling.StartTileIndexInOverallResource == D3D12_PACKED_TILE;
+        UINT64 width = packedTail ? packed.NumTilesForPackedMips
+                                  : tiling.WidthInTiles;
+        UINT64 height = packedTail ? 1 : tiling.HeightInTiles;
+        UINT64 depth = packedTail ? 1 : tiling.DepthInTiles;
+        UINT64 target = coordinate->X + coordinate->Y * width +
+                        coordinate->Z * width * height + count;
+        if (target < width * height * depth) {
+            coordinate->X = static_cast<UINT>(target % width);
+            coordinate->Y = static_cast<UINT>(target / width % height);
+            coordinate->Z = static_cast<UINT>(target / (width * height));
+            return true;
+        }
+
+        count = target - width * height * depth;
+        coordinate->X = coordinate->Y = coordinate->Z = 0;
+        coordinate->Subresource =
+            packedTail ? (coordinate->Subresource / mipCount + 1) * mipCount
+                       : coordinate->Subresource + 1;
+    }
+    return false;
+}
+
+// Splits a tile region into runs of at most kTileReadbackChunk tiles, in
+// the order CopyTiles lays the region out in a buffer
+bool SplitTileRegion(WrappedD3D12ToD3D11Device* device,
+                     ID3D12Resource* resource,
+                     const D3D11_TILED_RESOURCE_COORDINATE& start,
+                     const D3D11_TILE_REGION_SIZE& size,
+                     std::vector<TileRun>* runs) {
+    if (size.NumTiles <= kTileReadbackChunk) {
+        runs->push_back({start, size});
+        return true;
+    }
+
+    if (size.bUseBox) {
+        // Whole slices when they fit, else rows, else pieces of a row
+        UINT sliceTiles = size.Width * size.Height;
+        UINT columns = std::min<UINT>(size.Width, kTileReadbackChunk);
+        UINT rows = std::max<UINT>(
+            std::min<UINT>(size.Height, kTileReadbackChunk / columns), 1);
+        UINT slices =
+            sliceTiles <= kTileReadbackChunk
+                ? std::min<UINT>(size.Depth, kTileReadbackChunk / sliceTiles)
+                : 1;
+        for (UINT z = 0; z < size.Depth; z += slices) {
+            for (UINT y = 0; y < size.Height; y += rows) {
+                for (UINT x = 0; x < size.Width; x += columns) {
+                    TileRun run = {{start.X + x, start.Y + y, start.Z + z,
+                                    start.Subresource},
+                                   {}};
+                    run.size.bUseBox = TRUE;
+                    run.size.Width = std::min(columns, size.Width - x);
+                    run.size.Height = static_cast<UINT16>(
+                        std::min<UINT>(rows, size.Height - y));
+                    run.size.Depth = static_cast<UINT16>(
+                        std::min<UINT>(slices, size.Depth - z));
+                    run.size.NumTiles = run.size.Width * run.size.Height *
+                                        run.size.Depth;
+                    runs->push_back(run);
+                }
+            }
+        }
+        return true;
+    }
+
+    D3D12_RESOURCE_DESC desc = {};
+    resource->GetDesc(&desc);
+    D3D12_PACKED_MIP_INFO packed = {};
+    UINT tilingCount = 0;
+    device->GetResourceTiling(resource, nullptr, &packed, nullptr,
+                              &tilingCount, 0, nullptr);
+    UINT mipCount = std::max(packed.NumStandardMips + packed.NumPackedMips, 1);
+    UINT arraySize =
+        desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D
+            ? std::max<UINT>(desc.DepthOrArraySize, 1)
+            : 1;
+    std::vector<D3D12_SUBRESOURCE_TILING> tilings(mipCount * arraySize);
+    tilingCount = static_cast<UINT>(tilings.size());
+    device->GetResourceTiling(resource, nullptr, nullptr, nullptr,
+                              &tilingCount, 0, tilings.data());
+    tilings.resize(tilingCount);
+
+    D3D11_TILED_RESOURCE_COORDINATE coordinate = start;
+    for (UINT done = 0; done < size.NumTiles;) {
+        TileRun run = {coordinate, {}};
+        run.size.NumTiles = std::min(size.NumTiles - done, kTileReadbackChunk);
+        runs->push_back(run);
+        done += run.size.NumTiles;
+        if (done < size.NumTiles &&
+            !AdvanceTileCoordinate(tilings, packed, mipCount, &coordinate,
+                                   run.size.NumTiles)) {
+            ERR("Tile region runs past the end of resource %p", resource);
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
 HRESULT WrappedD3D12ToD3D11CommandList::Create(WrappedD3D12ToD3D11Device* device,
                                  D3D12_COMMAND_LIST_TYPE type,
                                  ID3D12CommandAllocator* allocator,
@@ -40,6 +166,10 @@ WrappedD3D12ToD3D11CommandList::WrappedD3D12ToD3D11CommandList(
     TRACE("Created WrappedD3D12ToD3D11CommandList type %d.", type);
 }
 
+WrappedD3D12ToD3D11CommandList::~WrappedD3D12ToD3D11CommandList() {
+    ReleaseReadbackStaging();
+}
+
 // IUnknown methods
 HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11CommandList::QueryInterface(REFIID riid,
                                                            void** ppvObject) {
@@ -118,13 +248,24 @@ HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11CommandList::Close() {
         return E_FAIL;
     }
 
+    FlushPendingCopies();
+
+    std::sort(m_residencyUses.begin(), m_residencyUses.end());
+    m_residencyUses.erase(
+        std::unique(m_residencyUses.begin(), m_residencyUses.end()),
+        m_residencyUses.end());
+
     // Get the D3D11 command list from the context
-    HRESULT hr = m_context->FinishCommandList(FALSE, &m_d3d11CommandList);
+    Segment last;
+    HRESULT hr = m_context->FinishCommandList(FALSE, &last.commands);
     if (FAILED(hr)) {
         ERR("Failed to finish D3D11 command list.");
         return hr;
     }
+    m_segments.push_back(std::move(last));
 
+    // Finishing resets the deferred context's state
+    m_boundState.Reset();
     m_isOpen = false;
     return S_OK;
 }
@@ -138,8 +279,18 @@ HRESULT WrappedD3D12ToD3D11CommandList::Reset(ID3D12CommandAllocator* pAllocator
         m_deferred.Reset();
     }
 
+    // Staging from the previous recording goes back to the pool
+    ReleaseReadbackStaging();
+    m_segments.clear();
+    m_pendingUploads.clear();
+    m_pendingBufferCopy = {};
+    m_residencyUses.clear();
+
     // Clear the context state and prepare for new commands
     m_context->ClearState();
+    m_boundState.Reset();
+    std::fill_n(m_blendFactor, 4, 1.0f);
+    m_stencilRef = 0;
     m_isOpen = true;
     return S_OK;
 }
@@ -157,6 +308,20 @@ void WrappedD3D12ToD3D11CommandList::CopyResource(ID3D12Resource* pDstResource,
         return;
     }
 
+    FlushPendingCopies();
+    NoteResidencyUse(pSrcResource);
+    NoteResidencyUse(pDstResource);
+
+    auto* dstWrapped = static_cast<WrappedD3D12ToD3D11Resource*>(pDstResource);
+    if (dstWrapped->GetReadbackShadow()) {
+        auto* srcWrapped =
+            static_cast<WrappedD3D12ToD3D11Resource*>(pSrcResource);
+        UINT size = static_cast<UINT>(dstWrapped->GetReadbackShadowSize());
+        RecordReadbackCopy(dstWrapped, 0, srcWrapped->GetD3D11Resource(),
+                           nullptr, size);
+        return;
+    }
+
     HRESULT hr = pSrcResource->QueryInterface(__uuidof(ID3D11Resource), (void**)&d3d11SrcResource);
     if (FAILED(hr)) {
         ERR("Failed to get D3D11 source resource");
@@ -184,6 +349,32 @@ void WrappedD3D12ToD3D11CommandList::CopyBufferRegion(
     TRACE("CopyBufferRegion: %p[%llu] -> %p[%llu], size=%llu", pSrcBuffer, SrcOffset,
           pDstBuffer, DstOffset, NumBytes);
 
+    FlushTextureUploads();
+    NoteResidencyUse(pSrcBuffer);
+    NoteResidencyUse(pDstBuffer);
+
+    // Copies into readback heaps go through pooled staging buffers
+    auto* dstWrapped = static_cast<WrappedD3D12ToD3D11Resource*>(pDstBuffer);
+    if (dstWrapped && dstWrapped->GetReadbackShadow()) {
+        FlushBufferCopy();
+
+        Microsoft::WRL::ComPtr<ID3D11Resource> src;
+        if (FAILED(GetD3D11Resource(pSrcBuffer, &src)) || !src) {
+            ERR("Failed to get D3D11 source resource");
+            return;
+        }
+        if (DstOffset + NumBytes > dstWrapped->GetReadbackShadowSize()) {
+            ERR("Readback copy region out of bounds");
+            return;
+        }
+
+        D3D11_BOX srcBox = {static_cast<UINT>(SrcOffset), 0, 0,
+                            static_cast<UINT>(SrcOffset + NumBytes), 1, 1};
+        RecordReadbackCopy(dstWrapped, DstOffset, src.Get(), &srcBox,
+                           static_cast<UINT>(NumBytes));
+        return;
+    }
+
     // Get D3D11 buffers
     Microsoft::WRL::ComPtr<ID3D11Buffer> d3d11DstBuffer;
     Microsoft::WRL::ComPtr<ID3D11Buffer> d3d11SrcBuffer;
@@ -223,48 +414,34 @@ void WrappedD3D12ToD3D11CommandList::CopyBufferRegion(
         return;
     }
 
-    // Create staging buffer if needed for partial copies
-    if (SrcOffset > 0 || DstOffset > 0 || NumBytes != srcDesc.ByteWidth) {
-        TRACE("Creating staging buffer for partial copy");
-        D3D11_BUFFER_DESC stagingDesc = {};
-        stagingDesc.ByteWidth = static_cast<UINT>(NumBytes);
-        stagingDesc.Usage = D3D11_USAGE_STAGING;
-        stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ | D3D11_CPU_ACCESS_WRITE;
-        
-        Microsoft::WRL::ComPtr<ID3D11Buffer> stagingBuffer;
-        if (FAILED(m_device->GetD3D11Device()->CreateBuffer(&stagingDesc, nullptr, &stagingBuffer))) {
-            ERR("Failed to create staging buffer");
-            return;
-        }
+    if (!NumBytes) {
+        return;
+    }
 
-        // Copy source to staging
-        D3D11_BOX srcBox = {};
-        srcBox.left = static_cast<UINT>(SrcOffset);
-        srcBox.right = static_cast<UINT>(SrcOffset + NumBytes);
-        srcBox.top = 0;
-        srcBox.bottom = 1;
-        srcBox.front = 0;
-        srcBox.back = 1;
-
-        m_context->CopySubresourceRegion(stagingBuffer.Get(), 0, 0, 0, 0,
-                                       d3d11SrcBuffer.Get(), 0, &srcBox);
-
-        // Copy staging to destination
-        D3D11_BOX dstBox = {};
-        dstBox.left = 0;
-        dstBox.right = static_cast<UINT>(NumBytes);
-        dstBox.top = 0;
-        dstBox.bottom = 1;
-        dstBox.front = 0;
-        dstBox.back = 1;
-
-        m_context->CopySubresourceRegion(d3d11DstBuffer.Get(), 0, 
-                                       static_cast<UINT>(DstOffset), 0, 0,
-                                       stagingBuffer.Get(), 0, &dstBox);
-    } else {
-        // Direct copy for full buffer copies
-        m_context->CopyResource(d3d11DstBuffer.Get(), d3d11SrcBuffer.Get());
+    UINT dstOffset = static_cast<UINT>(DstOffset);
+    UINT srcOffset = static_cast<UINT>(SrcOffset);
+    UINT size = static_cast<UINT>(NumBytes);
+
+    // D3D11 can't copy a resource onto itself
+    if (d3d11SrcBuffer.Get() == d3d11DstBuffer.Get()) {
+        FlushBufferCopy();
+        CopyWithinBuffer(d3d11DstBuffer.Get(), dstOffset, srcOffset, size);
+        return;
     }
+
+    // Sub-allocated uploads tend to arrive as runs of contiguous copies
+    PendingBufferCopy& pending = m_pendingBufferCopy;
+    if (pending.size && pending.dst.Get() == d3d11DstBuffer.Get() &&
+        pending.src.Get() == d3d11SrcBuffer.Get() &&
+        pending.dstOffset + pending.size == dstOffset &&
+        pending.srcOffset + pending.size == srcOffset) {
+        pending.size += size;
+        return;
+    }
+
+    FlushBufferCopy();
+    m_pendingBufferCopy = {d3d11DstBuffer, d3d11SrcBuffer, dstOffset,
+                           srcOffset, size};
 }
 
 void WrappedD3D12ToD3D11CommandList::CopyTiles(
@@ -275,7 +452,71 @@ void WrappedD3D12ToD3D11CommandList::CopyTiles(
     TRACE("(%p, %p, %p, %p, %llu, %d)", pTiledResource,
           pTileRegionStartCoordinate, pTileRegionSize, pBuffer,
           BufferStartOffsetInBytes, Flags);
-    // TODO: Implement tile copying
+
+    ID3D11Resource* d3d11TiledResource =
+        m_device->GetD3D11Resource(pTiledResource);
+    auto* bufferWrapped = static_cast<WrappedD3D12ToD3D11Resource*>(pBuffer);
+    Microsoft::WRL::ComPtr<ID3D11DeviceContext2> context2;
+    if (!d3d11TiledResource || !bufferWrapped ||
+        FAILED(m_context.As(&context2))) {
+        WARN("Can't copy tiles of resource %p.", pTiledResource);
+        return;
+    }
+
+    FlushPendingCopies();
+    NoteResidencyUse(pTiledResource);
+    NoteResidencyUse(pBuffer);
+
+    // Coordinates, region sizes and flags share the D3D11 layouts and values
+    const auto* coordinate =
+        reinterpret_cast<const D3D11_TILED_RESOURCE_COORDINATE*>(
+            pTileRegionStartCoordinate);
+    const auto* regionSize =
+        reinterpret_cast<const D3D11_TILE_REGION_SIZE*>(pTileRegionSize);
+
+    // Readback buffers are staging resources, tiles reach them through
+    // scratch memory and the usual readback copy
+    if (bufferWrapped->GetReadbackShadow() &&
+        (Flags &
+         D3D12_TILE_COPY_FLAG_SWIZZLED_TILED_RESOURCE_TO_LINEAR_BUFFER)) {
+        // Large regions go in chunks a scratch buffer can hold
+        std::vector<TileRun> runs;
+        if (!SplitTileRegion(m_device, pTiledResource, *coordinate,
+                             *regionSize, &runs)) {
+            return;
+        }
+
+        UINT64 bufferOffset = BufferStartOffsetInBytes;
+        for (const TileRun& run : runs) {
+            UINT size = run.size.NumTiles * TilePoolManager::kTileSize;
+            ID3D11Buffer* scratch =
+                m_device->GetScratchBufferPool()->Acquire(size);
+            if (!scratch) {
+                ERR("No scratch buffer for %u byte tile copy", size);
+                return;
+            }
+
+            context2->CopyTiles(d3d11TiledResource, &run.coordinate,
+                                &run.size, scratch, 0, Flags);
+            D3D11_BOX box = {0, 0, 0, size, 1, 1};
+            RecordReadbackCopy(bufferWrapped, bufferOffset, scratch, &box,
+                               size);
+            bufferOffset += size;
+        }
+        return;
+    }
+
+    Microsoft::WRL::ComPtr<ID3D11Buffer> d3d11Buffer;
+    ID3D11Resource* d3d11BufferResource = bufferWrapped->GetD3D11Resource();
+    if (!d3d11BufferResource ||
+        FAILED(d3d11BufferResource->QueryInterface(
+            IID_PPV_ARGS(&d3d11Buffer)))) {
+        ERR("Tile copy buffer %p has no D3D11 buffer.", pBuffer);
+        return;
+    }
+
+    context2->CopyTiles(d3d11TiledResource, coordinate, regionSize,
+                        d3d11Buffer.Get(), BufferStartOffsetInBytes, Flags);
 }
 
 void WrappedD3D12ToD3D11CommandList::ResolveSubresource(ID3D12Resource* pDstResource,
@@ -310,16 +551,23 @@ void WrappedD3D12ToD3D11CommandList::RSSetScissorRects(UINT NumRects,
 
 void WrappedD3D12ToD3D11CommandList::OMSetBlendFactor(const FLOAT BlendFactor[4]) {
     TRACE("WrappedD3D12ToD3D11CommandList::OMSetBlendFactor(%p)", BlendFactor);
+    // D3D12 takes null as all ones, like D3D11
+    if (BlendFactor) {
+        std::copy_n(BlendFactor, 4, m_blendFactor);
+    } else {
+        std::fill_n(m_blendFactor, 4, 1.0f);
+    }
     float currentBlendFactor[4];
     UINT SampleMask;
     ID3D11BlendState* blendState;
     m_context->OMGetBlendState(&blendState, currentBlendFactor, &SampleMask);
-    m_context->OMSetBlendState(blendState, BlendFactor, SampleMask);
+    m_context->OMSetBlendState(blendState, m_blendFactor, SampleMask);
     if (blendState) blendState->Release();
 }
 
 void WrappedD3D12ToD3D11CommandList::OMSetStencilRef(UINT StencilRef) {
     TRACE("WrappedD3D12ToD3D11CommandList::OMSetStencilRef(%u)", StencilRef);
+    m_stencilRef = StencilRef;
     ID3D11DepthStencilState* dsState;
     UINT currentRef;
     m_context->OMGetDepthStencilState(&dsState, &currentRef);
@@ -336,7 +584,31 @@ void WrappedD3D12ToD3D11CommandList::SetPipelineState(ID3D12PipelineState* pPipe
     }
 
     auto* pipelineState = static_cast<WrappedD3D12ToD3D11PipelineState*>(pPipelineState);
-    pipelineState->Apply(m_context.Get());
+    if (pipelineState == m_boundState.Get()) {
+        return;
+    }
+    pipelineState->ApplySetters(
+        m_context.Get(),
+        GetPipelineTransition(m_boundState.Get(), pipelineState),
+        m_blendFactor, m_stencilRef);
+    m_boundState = pipelineState;
+}
+
+uint32_t WrappedD3D12ToD3D11CommandList::GetPipelineTransition(
+    const WrappedD3D12ToD3D11PipelineState* previous,
+    WrappedD3D12ToD3D11PipelineState* next) {
+    // A cleared context has no previous state, ID 0
+    UINT64 from = previous ? previous->GetId() : 0;
+    UINT64 to = next->GetId();
+    size_t index =
+        ((from * 0x9e3779b97f4a7c15ull) ^ to) % kPipelineTransitionCount;
+    PipelineTransition& entry = m_pipelineTransitions[index];
+    if (entry.from != from || entry.to != to) {
+        entry.from = from;
+        entry.to = to;
+        entry.setters = next->GetChangedSetters(previous);
+    }
+    return entry.setters;
 }
 
 void WrappedD3D12ToD3D11CommandList::ExecuteBundle(ID3D12GraphicsCommandList* pCommandList) {
@@ -455,6 +727,7 @@ void WrappedD3D12ToD3D11CommandList::IASetIndexBuffer(
         ERR("Failed to get resource from buffer location");
         return;
     }
+    NoteResidencyUse(resource);
 
     auto d3d11Buffer = resource->GetD3D11Resource();
     if (!d3d11Buffer) {
@@ -481,6 +754,8 @@ void WrappedD3D12ToD3D11CommandList::IASetVertexBuffers(
 
     for (UINT i = 0; i < NumViews; i++) {
         const auto& view = pViews[i];
+        NoteResidencyUse(
+            reinterpret_cast<ID3D12Resource*>(view.BufferLocation));
         ID3D11Resource* resource = nullptr;
         HRESULT hr = reinterpret_cast<ID3D12Resource*>(view.BufferLocation)->QueryInterface(
             __uuidof(ID3D11Resource), (void**)&resource);
@@ -640,6 +915,8 @@ void WrappedD3D12ToD3D11CommandList::CopyTextureRegion(
         return;
     }
 
+    NoteResidencyUse(srcResource);
+    NoteResidencyUse(dstResource);
     d3d11SrcResource = srcResource->GetD3D11Resource();
     d3d11DstResource = dstResource->GetD3D11Resource();
 
@@ -653,86 +930,30 @@ void WrappedD3D12ToD3D11CommandList::CopyTextureRegion(
     srcResource->GetDesc(&srcDesc);
     dstResource->GetDesc(&dstDesc);
 
-    // Special handling for buffer to texture copy
-    if (srcDesc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER && 
-        dstDesc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D) {
-        
-        // Validate resources before proceeding
-        if (!d3d11SrcResource || !d3d11DstResource) {
-            ERR("Invalid D3D11 resources for copy operation");
-            return;
+    // D3D11 can't copy a buffer into a texture on the GPU, but upload heap
+    // contents live in a CPU shadow that UpdateSubresource can read directly
+    if (srcDesc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER) {
+        FlushBufferCopy();
+        if (pSrc->Type != D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT ||
+            !RecordTextureUpload(d3d11DstResource, pDst->SubresourceIndex,
+                                 DstX, DstY, DstZ, srcResource,
+                                 pSrc->PlacedFootprint, pSrcBox)) {
+            FIXME("Buffer to texture copy from a non-upload heap");
         }
+        return;
+    }
 
-        try {
-            // Get footprint from destination texture
-            D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
-            UINT numRows = 0;
-            UINT64 rowSizeInBytes = 0;
-            UINT64 totalBytes = 0;
-
-            // Get copyable footprints
-            m_device->GetCopyableFootprints(
-                &dstDesc, 
-                pDst->SubresourceIndex, 
-                1,
-                pSrc->PlacedFootprint.Offset, 
-                &footprint,
-                &numRows, 
-                &rowSizeInBytes, 
-                &totalBytes);
-
-            // Validate the footprint after getting it
-            if (footprint.Footprint.Format == DXGI_FORMAT_UNKNOWN ||
-                footprint.Footprint.Width == 0 ||
-                footprint.Footprint.Height == 0 ||
-                rowSizeInBytes == 0) {
-                ERR("Invalid footprint returned from GetCopyableFootprints");
-                return;
-            }
-
-            // Validate total memory required
-            if (totalBytes > (1ULL << 31)) {  // Sanity check for 2GB limit
-                ERR("Copy operation requires too much memory: %llu bytes", totalBytes);
-                return;
-            }
-
-            // For debugging
-            TRACE("Copy operation memory requirements:");
-            TRACE("Total bytes: %llu", totalBytes);
-            TRACE("Row size in bytes: %llu", rowSizeInBytes);
-            TRACE("Number of rows: %u", numRows);
-
-            // Validate dimensions
-            if (footprint.Footprint.Width == 0 || footprint.Footprint.Height == 0 ||
-                footprint.Footprint.Width > dstDesc.Width ||
-                footprint.Footprint.Height > dstDesc.Height) {
-                ERR("Invalid footprint dimensions: %ux%u (max: %ux%u)",
-                    footprint.Footprint.Width, footprint.Footprint.Height,
-                    dstDesc.Width, dstDesc.Height);
-                return;
-            }
-
-            // Use computed footprint dimensions
-            D3D11_BOX srcBox = {};
-            srcBox.left = 0;
-            srcBox.right = footprint.Footprint.Width;
-            srcBox.top = 0;
-            srcBox.bottom = footprint.Footprint.Height;
-            srcBox.front = 0;
-            srcBox.back = 1;
-
-            // Perform the copy with exception handling
-            m_context->CopySubresourceRegion(
-                d3d11DstResource,
-                pDst->SubresourceIndex,
-                DstX, DstY, DstZ,
-                d3d11SrcResource,
-                0,
-                &srcBox);
-
-        } catch (const std::exception& e) {
-            ERR("Exception during copy operation: %s", e.what());
-            return;
+    FlushPendingCopies();
+
+    // D3D11 can't copy a texture into a buffer either, readback heaps get
+    // the texels through staging instead
+    if (dstDesc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER) {
+        if (pDst->Type != D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT ||
+            !dstResource->GetReadbackShadow() ||
+            !RecordTextureReadback(dstResource, pDst->PlacedFootprint, DstX,
+                                   DstY, DstZ, srcResource,
+                                   pSrc->SubresourceIndex, pSrcBox)) {
+            FIXME("Texture to buffer copy outside a readback heap");
         }
         return;
     }
@@ -794,36 +1015,49 @@ void WrappedD3D12ToD3D11CommandList::Dispatch(UINT ThreadGroupCountX,
 }
 
 
-HRESULT WrappedD3D12ToD3D11CommandList::GetD3D11CommandList(ID3D11CommandList** ppCommandList) {
-    TRACE("WrappedD3D12ToD3D11CommandList::GetD3D11CommandList(%p)", ppCommandList);
-    if (!ppCommandList) {
-        return E_POINTER;
-    }
-
-    if (!m_d3d11CommandList) {
-        // If we haven't finished the command list yet, finish it now
-        if (m_isOpen) {
-            HRESULT hr = Close();
-            if (FAILED(hr)) {
-                return hr;
-            }
-        }
-
-        // Get the D3D11 command list from the context
-        HRESULT hr = m_context->FinishCommandList(FALSE, &m_d3d11CommandList);
+HRESULT WrappedD3D12ToD3D11CommandList::Execute(
+    ID3D11DeviceContext* immediate) {
+    TRACE("WrappedD3D12ToD3D11CommandList::Execute(%p)", immediate);
+    if (m_isOpen) {
+        HRESULT hr = Close();
         if (FAILED(hr)) {
-            ERR("Failed to finish D3D11 command list.");
             return hr;
         }
     }
 
-    m_d3d11CommandList.CopyTo(ppCommandList);
+    for (const Segment& segment : m_segments) {
+        immediate->ExecuteCommandList(segment.commands.Get(), FALSE);
+        for (const PendingUpload& upload : segment.uploads) {
+            immediate->UpdateSubresource(upload.dst.Get(), upload.subresource,
+                                         &upload.box, upload.data,
+                                         upload.rowPitch, upload.depthPitch);
+        }
+    }
     return S_OK;
 }
 
 void WrappedD3D12ToD3D11CommandList::ResourceBarrier(
     UINT NumBarriers, const D3D12_RESOURCE_BARRIER* pBarriers) {
     TRACE("ResourceBarrier: %u, %p", NumBarriers, pBarriers);
+
+    // Any barrier may hand an upload destination to its readers
+    FlushPendingCopies();
+
+    for (UINT i = 0; i < NumBarriers; ++i) {
+        const D3D12_RESOURCE_BARRIER& barrier = pBarriers[i];
+        switch (barrier.Type) {
+            case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+                NoteResidencyUse(barrier.Transition.pResource);
+                break;
+            case D3D12_RESOURCE_BARRIER_TYPE_ALIASING:
+                NoteResidencyUse(barrier.Aliasing.pResourceAfter);
+                break;
+            case D3D12_RESOURCE_BARRIER_TYPE_UAV:
+                NoteResidencyUse(barrier.UAV.pResource);
+                break;
+        }
+    }
+
     // D3D11 handles resource states automatically, so we can ignore barriers
     TRACE("Ignoring %u resource barriers.", NumBarriers);
 }
@@ -832,6 +1066,244 @@ void WrappedD3D12ToD3D11CommandList::ClearState(ID3D12PipelineState* pPipelineSt
     TRACE("WrappedD3D12ToD3D11CommandList::ClearState(%p)", pPipelineState);
 
     m_context->ClearState();
+    m_boundState.Reset();
+    std::fill_n(m_blendFactor, 4, 1.0f);
+    m_stencilRef = 0;
+}
+
+bool WrappedD3D12ToD3D11CommandList::RecordTextureUpload(
+    ID3D11Resource* dst, UINT dstSubresource, UINT dstX, UINT dstY, UINT dstZ,
+    WrappedD3D12ToD3D11Resource* src,
+    const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& placed, const D3D12_BOX* srcBox) {
+    UploadRing* ring = src->GetUploadRing();
+    if (!ring) {
+        return false;
+    }
+
+    const D3D12_SUBRESOURCE_FOOTPRINT& footprint = placed.Footprint;
+    const FormatInfo& info = GetFormatInfo(footprint.Format);
+    if (!info.bytesPerBlock) {
+        ERR("Unsupported upload format %d", footprint.Format);
+        return true;
+    }
+
+    D3D12_BOX box = {0, 0, 0, footprint.Width, footprint.Height,
+                     footprint.Depth};
+    if (srcBox) {
+        box = *srcBox;
+    }
+    if (box.right <= box.left || box.bottom <= box.top ||
+        box.back <= box.front) {
+        return true;
+    }
+
+    // Offset of the box's first block and end of its last row
+    UINT rowPitch = footprint.RowPitch;
+    UINT depthPitch =
+        rowPitch * GetFormatRowCount(footprint.Format, footprint.Height);
+    UINT rows = GetFormatRowCount(footprint.Format, box.bottom - box.top);
+    UINT64 begin = placed.Offset +
+                   static_cast<UINT64>(box.front) * depthPitch +
+                   static_cast<UINT64>(box.top / info.blockHeight) * rowPitch +
+                   static_cast<UINT64>(box.left / info.blockWidth) *
+                       info.bytesPerBlock;
+    UINT64 end = begin +
+                 static_cast<UINT64>(box.back - box.front - 1) * depthPitch +
+                 static_cast<UINT64>(rows - 1) * rowPitch +
+                 GetFormatRowSize(footprint.Format, box.right - box.left);
+    if (end > ring->GetSize()) {
+        ERR("Upload of %llu bytes at %llu exceeds %u byte buffer",
+            end - begin, begin, ring->GetSize());
+        return true;
+    }
+
+    D3D11_BOX dstBox = {dstX,
+                        dstY,
+                        dstZ,
+                        dstX + (box.right - box.left),
+                        dstY + (box.bottom - box.top),
+                        dstZ + (box.back - box.front)};
+    const uint8_t* data = ring->GetShadow() + begin;
+
+    // Streamers upload a subresource in horizontal strips; fold a strip
+    // that continues the previous one in both memory and texture space
+    if (!m_pendingUploads.empty()) {
+        PendingUpload& last = m_pendingUploads.back();
+        UINT lastHeight = last.box.bottom - last.box.top;
+        if (last.dst.Get() == dst && last.subresource == dstSubresource &&
+            last.format == footprint.Format && last.rowPitch == rowPitch &&
+            last.box.left == dstBox.left && last.box.right == dstBox.right &&
+            last.box.front == dstBox.front && last.box.back == dstBox.back &&
+            dstBox.back - dstBox.front == 1 &&
+            last.box.bottom == dstBox.top &&
+            lastHeight % info.blockHeight == 0 &&
+            last.data + (lastHeight / info.blockHeight) * rowPitch == data) {
+            last.box.bottom = dstBox.bottom;
+            last.depthPitch = rowPitch * GetFormatRowCount(
+                                             footprint.Format,
+                                             last.box.bottom - last.box.top);
+            return true;
+        }
+    }
+
+    m_pendingUploads.push_back({dst, src, dstSubresource, dstBox, data,
+                                rowPitch, depthPitch, footprint.Format});
+    return true;
+}
+
+void WrappedD3D12ToD3D11CommandList::FlushTextureUploads() {
+    if (m_pendingUploads.empty()) {
+        return;
+    }
+
+    // UpdateSubresource on the deferred context would copy the shadow now,
+    // missing writes made before the list executes. End the segment here
+    // instead, keeping the context state for the commands that follow,
+    // and let Execute upload on the immediate context.
+    Segment segment;
+    HRESULT hr = m_context->FinishCommandList(TRUE, &segment.commands);
+    if (FAILED(hr)) {
+        ERR("Failed to split command list for texture uploads, hr %#x", hr);
+        m_pendingUploads.clear();
+        return;
+    }
+
+    TRACE("Deferred %zu texture uploads to execution",
+          m_pendingUploads.size());
+    segment.uploads.swap(m_pendingUploads);
+    m_segments.push_back(std::move(segment));
+}
+
+void WrappedD3D12ToD3D11CommandList::FlushBufferCopy() {
+    PendingBufferCopy& pending = m_pendingBufferCopy;
+    if (!pending.size) {
+        return;
+    }
+
+    D3D11_BOX srcBox = {pending.srcOffset, 0, 0,
+                        pending.srcOffset + pending.size, 1, 1};
+    m_context->CopySubresourceRegion(pending.dst.Get(), 0, pending.dstOffset,
+                                     0, 0, pending.src.Get(), 0, &srcBox);
+    pending = {};
+}
+
+void WrappedD3D12ToD3D11CommandList::CopyWithinBuffer(ID3D11Buffer* buffer,
+                                                      UINT dstOffset,
+                                                      UINT srcOffset,
+                                                      UINT size) {
+    ID3D11Buffer* scratch = m_device->GetScratchBufferPool()->Acquire(size);
+    if (!scratch) {
+        ERR("No scratch buffer for %u byte copy", size);
+        return;
+    }
+
+    D3D11_BOX srcBox = {srcOffset, 0, 0, srcOffset + size, 1, 1};
+    m_context->CopySubresourceRegion(scratch, 0, 0, 0, 0, buffer, 0, &srcBox);
+    D3D11_BOX scratchBox = {0, 0, 0, size, 1, 1};
+    m_context->CopySubresourceRegion(buffer, 0, dstOffset, 0, 0, scratch, 0,
+                                     &scratchBox);
+}
+
+bool WrappedD3D12ToD3D11CommandList::RecordReadbackCopy(
+    WrappedD3D12ToD3D11Resource* dst, UINT64 dstOffset, ID3D11Resource* src,
+    const D3D11_BOX* srcBox, UINT size) {
+    if (!src) {
+        ERR("Invalid readback copy source");
+        return false;
+    }
+
+    Microsoft::WRL::ComPtr<ID3D11Resource> staging =
+        m_device->GetReadbackManager()->AcquireStagingBuffer(size);
+    if (!staging) {
+        ERR("Failed to get staging buffer for %u byte readback", size);
+        return false;
+    }
+
+    m_context->CopySubresourceRegion(staging.Get(), 0, 0, 0, 0, src, 0,
+                                     srcBox);
+    m_readbackCopies.push_back({dst, staging, dstOffset, size, 0});
+    TRACE("Recorded readback copy of %u bytes into %p at %llu", size, dst,
+          dstOffset);
+    return true;
+}
+
+bool WrappedD3D12ToD3D11CommandList::RecordTextureReadback(
+    WrappedD3D12ToD3D11Resource* dst,
+    const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& placed, UINT dstX, UINT dstY,
+    UINT dstZ, WrappedD3D12ToD3D11Resource* src, UINT srcSubresource,
+    const D3D12_BOX* srcBox) {
+    // The layout comes from the D3D11 texture, so it has to exist first
+    ID3D11Resource* srcResource = src->GetD3D11Resource();
+    if (!srcResource) {
+        ERR("Failed to create D3D11 resource for readback source %p", src);
+        return false;
+    }
+
+    WrappedD3D12ToD3D11Resource::SubresourceLayout layout = {};
+    if (!src->GetSubresourceLayout(srcSubresource, &layout)) {
+        ERR("Readback source %p is not a texture", src);
+        return false;
+    }
+
+    D3D12_BOX box = {0, 0, 0, layout.width, layout.height, layout.depth};
+    if (srcBox) {
+        box = *srcBox;
+    }
+    if (box.right <= box.left || box.bottom <= box.top ||
+        box.back <= box.front) {
+        return true;
+    }
+
+    // Where the box lands in the footprint, and how far it reaches
+    const D3D12_SUBRESOURCE_FOOTPRINT& footprint = placed.Footprint;
+    const FormatInfo& info = GetFormatInfo(layout.format);
+    UINT rowPitch = footprint.RowPitch;
+    UINT depthPitch =
+        rowPitch * GetFormatRowCount(layout.format, footprint.Height);
+    UINT rowSize = static_cast<UINT>(
+        GetFormatRowSize(layout.format, box.right - box.left));
+    UINT rowCount = GetFormatRowCount(layout.format, box.bottom - box.top);
+    UINT sliceCount = box.back - box.front;
+    UINT64 dstOffset =
+        placed.Offset + static_cast<UINT64>(dstZ) * depthPitch +
+        static_cast<UINT64>(dstY / info.blockHeight) * rowPitch +
+        static_cast<UINT64>(dstX / info.blockWidth) * info.bytesPerBlock;
+    UINT64 size = static_cast<UINT64>(sliceCount - 1) * depthPitch +
+                  static_cast<UINT64>(rowCount - 1) * rowPitch + rowSize;
+    if (!info.bytesPerBlock ||
+        dstOffset + size > dst->GetReadbackShadowSize()) {
+        ERR("Texture readback of %llu bytes at %llu out of bounds", size,
+            dstOffset);
+        return true;
+    }
+
+    Microsoft::WRL::ComPtr<ID3D11Resource> staging =
+        m_device->GetReadbackManager()->AcquireStagingTexture(
+            layout.dimension, layout.format, box.right - box.left,
+            box.bottom - box.top, sliceCount);
+    if (!staging) {
+        ERR("Failed to get staging texture for readback");
+        return true;
+    }
+
+    D3D11_BOX d3d11Box = {box.left,  box.top,    box.front,
+                          box.right, box.bottom, box.back};
+    m_context->CopySubresourceRegion(staging.Get(), 0, 0, 0, 0, srcResource,
+                                     srcSubresource, &d3d11Box);
+    m_readbackCopies.push_back({dst, staging, dstOffset, size, 0, rowPitch,
+                                depthPitch, rowSize, rowCount, sliceCount});
+    TRACE("Recorded texture readback of %ux%ux%u into %p at %llu",
+          box.right - box.left, box.bottom - box.top, sliceCount, dst,
+          dstOffset);
+    return true;
+}
+
+void WrappedD3D12ToD3D11CommandList::ReleaseReadbackStaging() {
+    for (ReadbackCopy& copy : m_readbackCopies) {
+        m_device->GetReadbackManager()->ReleaseStaging(
+            std::move(copy.staging), m_lastSubmittedSerial);
+    }
+    m_readbackCopies.clear();
 }
 
 HRESULT WrappedD3D12ToD3D11CommandList::GetD3D11Resource(
@@ -843,10 +1315,19 @@ HRESULT WrappedD3D12ToD3D11CommandList::GetD3D11Resource(
     }
 
     auto* wrappedResource = static_cast<WrappedD3D12ToD3D11Resource*>(d3d12Resource);
+    NoteResidencyUse(wrappedResource);
     *ppD3D11Resource = wrappedResource->GetD3D11Resource();
     return S_OK;
 }
 
+void WrappedD3D12ToD3D11CommandList::NoteResidencyUse(
+    ID3D12Resource* resource) {
+    if (resource) {
+        m_residencyUses.push_back(
+            static_cast<WrappedD3D12ToD3D11Resource*>(resource));
+    }
+}
+
 HRESULT WrappedD3D12ToD3D11CommandList::GetD3D11Buffer(
     ID3D12Resource* d3d12Resource,
     Microsoft::WRL::ComPtr<ID3D11Buffer>* ppD3D11Buffer) {
@@ -1,6 +1,8 @@
 #include "d3d11_impl/command_queue.hpp"
+#include "common/memory_stats.hpp"
 #include "d3d11_impl/command_list.hpp"
 #include "d3d11_impl/device.hpp"
+#include "d3d11_impl/heap.hpp"
 #include "d3d11_impl/swap_chain.hpp"
 
 namespace dxiided {
@@ -150,7 +152,44 @@ void STDMETHODCALLTYPE WrappedD3D12ToD3D11CommandQueue::UpdateTileMappings(
         pResource, NumResourceRegions, pResourceRegionStartCoordinates,
         pResourceRegionSizes, pHeap, NumRanges, pRangeFlags,
         pHeapRangeStartOffsets, pRangeTileCounts, Flags);
-    FIXME("Tiled resource mapping not implemented.");
+
+    TilePoolManager* tilePool = m_device->GetTilePoolManager();
+    ID3D11Resource* d3d11Resource = m_device->GetD3D11Resource(pResource);
+    if (!tilePool->IsSupported() || !d3d11Resource) {
+        WARN("Can't map tiles of resource %p.", pResource);
+        return;
+    }
+
+    // Heap offsets are relative to the heap's range of the device tile pool
+    std::vector<UINT> poolOffsets;
+    if (pHeap && pHeapRangeStartOffsets) {
+        UINT firstTile = 0;
+        HRESULT hr = static_cast<WrappedD3D12ToD3D11Heap*>(pHeap)->GetFirstTile(
+            &firstTile);
+        if (FAILED(hr)) {
+            ERR("Failed to reserve tiles for heap %p, hr %#x", pHeap, hr);
+            return;
+        }
+        poolOffsets.assign(pHeapRangeStartOffsets,
+                           pHeapRangeStartOffsets + NumRanges);
+        for (UINT& offset : poolOffsets) {
+            offset += firstTile;
+        }
+    }
+
+    // Coordinates, region sizes and flags share the D3D11 layouts and values
+    HRESULT hr = tilePool->GetContext2()->UpdateTileMappings(
+        d3d11Resource, NumResourceRegions,
+        reinterpret_cast<const D3D11_TILED_RESOURCE_COORDINATE*>(
+            pResourceRegionStartCoordinates),
+        reinterpret_cast<const D3D11_TILE_REGION_SIZE*>(pResourceRegionSizes),
+        tilePool->GetTilePool(), NumRanges,
+        reinterpret_cast<const UINT*>(pRangeFlags),
+        poolOffsets.empty() ? nullptr : poolOffsets.data(), pRangeTileCounts,
+        Flags);
+    if (FAILED(hr)) {
+        ERR("UpdateTileMappings failed for %p, hr %#x", pResource, hr);
+    }
 }
 
 void STDMETHODCALLTYPE WrappedD3D12ToD3D11CommandQueue::CopyTileMappings(
@@ -162,15 +201,39 @@ void STDMETHODCALLTYPE WrappedD3D12ToD3D11CommandQueue::CopyTileMappings(
     TRACE("WrappedD3D12ToD3D11CommandQueue::CopyTileMappings %p, %p, %p, %p, %p, %d",
           pDstResource, pDstRegionStartCoordinate, pSrcResource,
           pSrcRegionStartCoordinate, pRegionSize, Flags);
-    // D3D11 doesn't support tiled resources in the same way
-    FIXME("Tiled resource copy not implemented.");
+
+    TilePoolManager* tilePool = m_device->GetTilePoolManager();
+    ID3D11Resource* d3d11DstResource = m_device->GetD3D11Resource(pDstResource);
+    ID3D11Resource* d3d11SrcResource = m_device->GetD3D11Resource(pSrcResource);
+    if (!tilePool->IsSupported() || !d3d11DstResource || !d3d11SrcResource) {
+        WARN("Can't copy tile mappings from %p to %p.", pSrcResource,
+             pDstResource);
+        return;
+    }
+
+    HRESULT hr = tilePool->GetContext2()->CopyTileMappings(
+        d3d11DstResource,
+        reinterpret_cast<const D3D11_TILED_RESOURCE_COORDINATE*>(
+            pDstRegionStartCoordinate),
+        d3d11SrcResource,
+        reinterpret_cast<const D3D11_TILED_RESOURCE_COORDINATE*>(
+            pSrcRegionStartCoordinate),
+        reinterpret_cast<const D3D11_TILE_REGION_SIZE*>(pRegionSize), Flags);
+    if (FAILED(hr)) {
+        ERR("CopyTileMappings failed for %p, hr %#x", pDstResource, hr);
+    }
 }
 
 void STDMETHODCALLTYPE WrappedD3D12ToD3D11CommandQueue::ExecuteCommandLists(
     UINT NumCommandLists, ID3D12CommandList* const* ppCommandLists) {
     TRACE("WrappedD3D12ToD3D11CommandQueue::ExecuteCommandLists %u, %p", NumCommandLists,
           ppCommandLists);
-          
+
+    // Push pending upload heap writes ahead of the work that reads them
+    std::vector<UploadRingManager::FlushedVersion> uploads;
+    m_device->GetUploadRingManager()->FlushPending(m_immediateContext.Get(),
+                                                   &uploads);
+
     // Execute each command list
     for (UINT i = 0; i < NumCommandLists; i++) {
         auto* pList = static_cast<WrappedD3D12ToD3D11CommandList*>(ppCommandLists[i]);
@@ -182,22 +245,42 @@ void STDMETHODCALLTYPE WrappedD3D12ToD3D11CommandQueue::ExecuteCommandLists(
         // Hold a reference to the command list while we're using it
         pList->AddRef();
         
-        ID3D11CommandList* d3d11List = nullptr;
-        HRESULT hr = pList->GetD3D11CommandList(&d3d11List);
-        if (FAILED(hr) || !d3d11List) {
-            WARN("Failed to get D3D11 command list at index %u, hr %08x", i, hr);
-            pList->Release();
-            continue;
+        // Execute the D3D11 command lists and the uploads between them
+        HRESULT hr = pList->Execute(m_immediateContext.Get());
+        if (FAILED(hr)) {
+            WARN("Failed to execute command list at index %u, hr %08x", i, hr);
         }
         
-        // Execute the D3D11 command list
-        m_immediateContext->ExecuteCommandList(d3d11List, FALSE);
-        
         // Clean up
-        d3d11List->Release();
         pList->Release();
     }
     
+    // Tag this batch so upload versions know when they can be reused
+    UINT64 serial =
+        m_device->GetSubmissionTracker()->Submit(m_immediateContext.Get());
+    m_device->GetUploadRingManager()->MarkSubmitted(uploads, serial);
+
+    // Readbacks recorded by these lists complete with this batch
+    for (UINT i = 0; i < NumCommandLists; i++) {
+        auto* pList =
+            static_cast<WrappedD3D12ToD3D11CommandList*>(ppCommandLists[i]);
+        if (!pList) {
+            continue;
+        }
+        m_device->GetReadbackManager()->Submit(pList->GetPendingReadbacks(),
+                                               serial);
+        m_device->GetResidencyManager()->MarkUsed(pList->GetResidencyUses(),
+                                                  serial);
+        pList->OnSubmitted(serial);
+    }
+
+    // Demote cold resources while over the video memory budget
+    m_device->GetResidencyManager()->OnSubmitted(serial);
+    MemoryStats::Instance().OnSubmitted(serial);
+
+    // Resources released a few submissions ago and never reused go away
+    m_device->GetTransientPool()->Trim(m_immediateContext.Get());
+
     // Ensure commands are flushed and synchronized
     m_immediateContext->Flush();
     m_immediateContext->ClearState();
@@ -234,6 +317,8 @@ HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11CommandQueue::Signal(ID3D12Fence* p
     }
     
     // Ensure all previous commands are completed
+    SubmissionTracker* tracker = m_device->GetSubmissionTracker();
+    UINT64 lastSubmitted = tracker->GetLastSubmittedSerial();
     m_immediateContext->Flush();
     
     // Create a query to ensure GPU completion
@@ -253,7 +338,10 @@ HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11CommandQueue::Signal(ID3D12Fence* p
         }
         
         pQuery->Release();
-        
+
+        // Everything submitted before this signal has retired
+        tracker->MarkCompleted(lastSubmitted);
+
         // Signal the fence after GPU completion
         return pFence->Signal(Value);
     }
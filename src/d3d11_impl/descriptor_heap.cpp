@@ -1,5 +1,6 @@
 #include "d3d11_impl/descriptor_heap.hpp"
 
+#include "common/memory_stats.hpp"
 #include "d3d11_impl/device.hpp"
 
 namespace dxiided {
@@ -29,6 +30,8 @@ WrappedD3D12ToD3D11DescriptorHeap::WrappedD3D12ToD3D11DescriptorHeap(
     size_t descriptorSize =
         m_device->GetDescriptorHandleIncrementSize(m_desc.Type);
     m_descriptorStorage.resize(descriptorSize * m_desc.NumDescriptors);
+    MemoryStats::Instance().Add(MemoryCategory::DescriptorHeaps,
+                                m_descriptorStorage.size());
 
     // Initialize handles
     m_cpuHandle.ptr = reinterpret_cast<SIZE_T>(m_descriptorStorage.data());
@@ -37,6 +40,11 @@ WrappedD3D12ToD3D11DescriptorHeap::WrappedD3D12ToD3D11DescriptorHeap(
                           : 0;
 }
 
+WrappedD3D12ToD3D11DescriptorHeap::~WrappedD3D12ToD3D11DescriptorHeap() {
+    MemoryStats::Instance().Remove(MemoryCategory::DescriptorHeaps,
+                                   m_descriptorStorage.size());
+}
+
 // IUnknown methods
 HRESULT STDMETHODCALLTYPE
 WrappedD3D12ToD3D11DescriptorHeap::QueryInterface(REFIID riid, void** ppvObject) {
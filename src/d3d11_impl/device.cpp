@@ -4,8 +4,13 @@
 #include <d3d11_2.h>
 #include <dxgi1_2.h>
 
+#include <algorithm>
+
+#include "common/config.hpp"
 #include "d3d11_impl/command_allocator.hpp"
+#include "d3d11_impl/pipeline_library.hpp"
 #include "d3d11_impl/pipeline_state.hpp"
+#include "d3d11_impl/pipeline_stream.hpp"
 #include "d3d11_impl/command_list.hpp"
 #include "d3d11_impl/descriptor_heap.hpp"
 #include "d3d11_impl/device_features.hpp"
@@ -20,12 +25,60 @@ const GUID IID_IUnknown = {0x00000000,
 
 namespace dxiided {
 
+namespace {
+
+// Only resources have D3D11 storage with an eviction priority, other
+// pageable objects are left to the driver
+WrappedD3D12ToD3D11Resource* GetPageableResource(ID3D12Pageable* object) {
+    Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+    if (!object || FAILED(object->QueryInterface(IID_PPV_ARGS(&resource)))) {
+        TRACE("Ignoring residency of non-resource object %p", object);
+        return nullptr;
+    }
+    return static_cast<WrappedD3D12ToD3D11Resource*>(resource.Get());
+}
+
+}  // namespace
+
 WrappedD3D12ToD3D11Device::WrappedD3D12ToD3D11Device(Microsoft::WRL::ComPtr<ID3D11Device> device,
                          Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
                          D3D_FEATURE_LEVEL feature_level)
     : m_d3d11Device(device),
       m_d3d11Context(context),
-      m_featureLevel(feature_level) {}
+      m_featureLevel(feature_level),
+      m_gpuVAManager(std::make_unique<GPUVirtualAddressManager>()),
+      m_submissionTracker(std::make_unique<SubmissionTracker>(device.Get())),
+      m_uploadRingManager(
+          std::make_unique<UploadRingManager>(m_submissionTracker.get())),
+      m_readbackManager(std::make_unique<ReadbackManager>(
+          device.Get(), context.Get(), m_submissionTracker.get())),
+      m_transientPool(
+          std::make_unique<TransientResourcePool>(m_submissionTracker.get())),
+      m_scratchBufferPool(std::make_unique<ScratchBufferPool>(device.Get())),
+      m_tilePoolManager(
+          std::make_unique<TilePoolManager>(device.Get(), context.Get())),
+      m_residencyManager(std::make_unique<ResidencyManager>(
+          device.Get(), m_submissionTracker.get())),
+      m_resourceMaterializer(std::make_unique<ResourceMaterializer>()),
+      m_allocationInfoCache(std::make_unique<AllocationInfoCache>()),
+      m_footprintCache(std::make_unique<FootprintCache>()),
+      m_shaderModuleCache(std::make_unique<ShaderModuleCache>(device.Get())),
+      m_stateObjectCache(std::make_unique<StateObjectCache>(device.Get())),
+      m_pipelineDiskCache(std::make_unique<PipelineDiskCache>()),
+      m_pipelineCompiler(std::make_unique<PipelineCompiler>()),
+      m_pipelineStateCache(std::make_unique<PipelineStateCache>()) {
+    // Newer interfaces are optional, callers check for null
+    device.As(&m_d3d11Device1);
+    device.As(&m_d3d11Device2);
+
+    if (Config::Instance().PipelineCachePrewarm()) {
+        auto descs = m_pipelineDiskCache->GetLoadedDescs();
+        TRACE("Prewarming %zu cached pipeline states", descs.size());
+        for (auto& desc : descs) {
+            WrappedD3D12ToD3D11PipelineState::Prewarm(this, std::move(desc));
+        }
+    }
+}
 
 HRESULT WrappedD3D12ToD3D11Device::Create(IUnknown* adapter,
                             D3D_FEATURE_LEVEL minimum_feature_level,
@@ -137,6 +190,20 @@ HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::QueryInterface(REFIID riid,
         return S_OK;
     }
 
+    if (IsEqualGUID(riid, IID_IDxiidedMemoryStats)) {
+        TRACE("Returning IDxiidedMemoryStats interface");
+        *ppvObject = static_cast<IDxiidedMemoryStats*>(this);
+        AddRef();
+        return S_OK;
+    }
+
+    if (IsEqualGUID(riid, IID_IDxiidedPipelineCompiler)) {
+        TRACE("Returning IDxiidedPipelineCompiler interface");
+        *ppvObject = static_cast<IDxiidedPipelineCompiler*>(this);
+        AddRef();
+        return S_OK;
+    }
+
     // IUnknown - use ID3D12Device2 as primary interface
     if (IsEqualGUID(riid, __uuidof(IUnknown))) {
         TRACE("Returning IUnknown interface");
@@ -176,82 +243,6 @@ ULONG STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::Release() {
     return ref;
 }
 
-UINT GetFormatByteSize(DXGI_FORMAT format) {
-    TRACE("GetFormatByteSize for format %d", format);
-    switch (format) {
-        case DXGI_FORMAT_R32G32B32A32_TYPELESS:
-        case DXGI_FORMAT_R32G32B32A32_FLOAT:
-        case DXGI_FORMAT_R32G32B32A32_UINT:
-        case DXGI_FORMAT_R32G32B32A32_SINT:
-            TRACE("  R32G32B32A32 format -> 16 bytes");
-            return 16;
-
-        case DXGI_FORMAT_R32G32B32_TYPELESS:
-        case DXGI_FORMAT_R32G32B32_FLOAT:
-        case DXGI_FORMAT_R32G32B32_UINT:
-        case DXGI_FORMAT_R32G32B32_SINT:
-            TRACE("  R32G32B32 format -> 12 bytes");
-            return 12;
-
-        case DXGI_FORMAT_R16G16B16A16_TYPELESS:
-        case DXGI_FORMAT_R16G16B16A16_FLOAT:
-        case DXGI_FORMAT_R16G16B16A16_UNORM:
-        case DXGI_FORMAT_R16G16B16A16_UINT:
-        case DXGI_FORMAT_R16G16B16A16_SNORM:
-        case DXGI_FORMAT_R16G16B16A16_SINT:
-        case DXGI_FORMAT_R32G32_TYPELESS:
-        case DXGI_FORMAT_R32G32_FLOAT:
-        case DXGI_FORMAT_R32G32_UINT:
-        case DXGI_FORMAT_R32G32_SINT:
-            return 8;
-
-        case DXGI_FORMAT_R8G8B8A8_TYPELESS:
-        case DXGI_FORMAT_R8G8B8A8_UNORM:
-        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
-        case DXGI_FORMAT_R8G8B8A8_UINT:
-        case DXGI_FORMAT_R8G8B8A8_SNORM:
-        case DXGI_FORMAT_R8G8B8A8_SINT:
-        case DXGI_FORMAT_R16G16_TYPELESS:
-        case DXGI_FORMAT_R16G16_FLOAT:
-        case DXGI_FORMAT_R16G16_UNORM:
-        case DXGI_FORMAT_R16G16_UINT:
-        case DXGI_FORMAT_R16G16_SNORM:
-        case DXGI_FORMAT_R16G16_SINT:
-        case DXGI_FORMAT_R32_TYPELESS:
-        case DXGI_FORMAT_D32_FLOAT:
-        case DXGI_FORMAT_R32_FLOAT:
-        case DXGI_FORMAT_R32_UINT:
-        case DXGI_FORMAT_R32_SINT:
-            return 4;
-
-        case DXGI_FORMAT_R8G8_TYPELESS:
-        case DXGI_FORMAT_R8G8_UNORM:
-        case DXGI_FORMAT_R8G8_UINT:
-        case DXGI_FORMAT_R8G8_SNORM:
-        case DXGI_FORMAT_R8G8_SINT:
-        case DXGI_FORMAT_R16_TYPELESS:
-        case DXGI_FORMAT_R16_FLOAT:
-        case DXGI_FORMAT_D16_UNORM:
-        case DXGI_FORMAT_R16_UNORM:
-        case DXGI_FORMAT_R16_UINT:
-        case DXGI_FORMAT_R16_SNORM:
-        case DXGI_FORMAT_R16_SINT:
-            return 2;
-
-        case DXGI_FORMAT_R8_TYPELESS:
-        case DXGI_FORMAT_R8_UNORM:
-        case DXGI_FORMAT_R8_UINT:
-        case DXGI_FORMAT_R8_SNORM:
-        case DXGI_FORMAT_R8_SINT:
-        case DXGI_FORMAT_A8_UNORM:
-            return 1;
-
-        default:
-            ERR("Unknown format %d (0x%x)", format, format);
-            return 4;  // Default to 4 bytes instead of 0 to avoid division by zero
-    }
-}
-
 // ID3D12Object methods
 HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::GetPrivateData(REFGUID guid,
                                                       UINT* pDataSize,
@@ -463,7 +454,9 @@ HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::CheckFeatureSupport(
                 data->OutputMergerLogicOp = FALSE;
                 data->MinPrecisionSupport =
                     D3D12_SHADER_MIN_PRECISION_SUPPORT_NONE;
-                data->TiledResourcesTier = D3D12_TILED_RESOURCES_TIER_1;
+                data->TiledResourcesTier =
+                    static_cast<D3D12_TILED_RESOURCES_TIER>(
+                        m_tilePoolManager->GetTier());
                 data->ResourceBindingTier = D3D12_RESOURCE_BINDING_TIER_1;
                 data->PSSpecifiedStencilRefSupported = FALSE;
                 data->TypedUAVLoadAdditionalFormats = FALSE;
@@ -641,7 +634,8 @@ void STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::CreateShaderResourceView(
                     buffer->Release();
 
                     // Use format size to validate element count
-                    UINT formatSize = GetFormatByteSize(d3d11Desc.Format);
+                    UINT formatSize =
+                        GetFormatInfo(d3d11Desc.Format).bytesPerBlock;
                     if (formatSize > 0) {
                         UINT maxElements = bufferDesc.ByteWidth / formatSize;
                         if (d3d11Desc.Buffer.NumElements > maxElements) {
@@ -716,6 +710,9 @@ void STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::CreateShaderResourceView(
         return;
     }
 
+    GetResidencyManager()->NoteView(
+        static_cast<WrappedD3D12ToD3D11Resource*>(pResource));
+
     // Store view in descriptor heap
     auto* descriptor = reinterpret_cast<ID3D11ShaderResourceView**>(DestDescriptor.ptr);
     *descriptor = srv.Detach();
@@ -757,6 +754,9 @@ void STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::CreateUnorderedAccessView(
         return;
     }
 
+    GetResidencyManager()->NoteView(
+        static_cast<WrappedD3D12ToD3D11Resource*>(pResource));
+
     // Store view in descriptor heap
     auto* descriptor =
         reinterpret_cast<ID3D11UnorderedAccessView**>(DestDescriptor.ptr);
@@ -795,6 +795,9 @@ void STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::CreateRenderTargetView(
         return;
     }
 
+    GetResidencyManager()->NoteView(
+        static_cast<WrappedD3D12ToD3D11Resource*>(pResource));
+
     TRACE("Store view in descriptor heap");
     auto* descriptor =
         reinterpret_cast<ID3D11RenderTargetView**>(DestDescriptor.ptr);
@@ -829,6 +832,9 @@ void STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::CreateDepthStencilView(
         return;
     }
 
+    GetResidencyManager()->NoteView(
+        static_cast<WrappedD3D12ToD3D11Resource*>(pResource));
+
     // Store view in descriptor heap
     auto* descriptor =
         reinterpret_cast<ID3D11DepthStencilView**>(DestDescriptor.ptr);
@@ -915,6 +921,13 @@ WrappedD3D12ToD3D11Device::GetResourceAllocationInfo(
     UINT numResourceDescs, const D3D12_RESOURCE_DESC* pResourceDescs) {
     TRACE("WrappedD3D12ToD3D11Device::GetResourceAllocationInfo(%p, %u, %u, %p)", info,
           visibleMask, numResourceDescs, pResourceDescs);
+
+    if (!info) {
+        return info;
+    }
+
+    *info = m_allocationInfoCache->GetInfo(numResourceDescs, pResourceDescs);
+    TRACE("  size %llu, alignment %llu", info->SizeInBytes, info->Alignment);
     return info;
 }
 
@@ -922,6 +935,33 @@ D3D12_HEAP_PROPERTIES* STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::GetCustomHea
     D3D12_HEAP_PROPERTIES* props, UINT nodeMask, D3D12_HEAP_TYPE heapType) {
     TRACE("WrappedD3D12ToD3D11Device::GetCustomHeapProperties(%p, %u, %d)", props, nodeMask,
           heapType);
+
+    if (!props) {
+        return props;
+    }
+
+    // Matches how GetD3D11Usage backs each heap type
+    *props = {};
+    props->Type = D3D12_HEAP_TYPE_CUSTOM;
+    props->MemoryPoolPreference = D3D12_MEMORY_POOL_L0;
+    props->CreationNodeMask = 1;
+    props->VisibleNodeMask = 1;
+    switch (heapType) {
+        case D3D12_HEAP_TYPE_DEFAULT:
+            props->CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_NOT_AVAILABLE;
+            break;
+        case D3D12_HEAP_TYPE_UPLOAD:
+            props->CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_WRITE_COMBINE;
+            break;
+        case D3D12_HEAP_TYPE_READBACK:
+            props->CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_WRITE_BACK;
+            break;
+        default:
+            ERR("Invalid heap type %d", heapType);
+            props->CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+            props->MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+            break;
+    }
     return props;
 }
 
@@ -1039,29 +1079,35 @@ HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::CreatePlacedResource(
     D3D12_HEAP_DESC heapDesc;
     pHeap->GetDesc(&heapDesc);
 
-    // For upload heaps, we need to ensure the resource is created with the right CPU access flags
-    if (heapDesc.Properties.Type == D3D12_HEAP_TYPE_UPLOAD) {
-        D3D11_BUFFER_DESC bufferDesc = {};
-        bufferDesc.ByteWidth = static_cast<UINT>(pDesc->Width);
-        bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-        bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER | D3D11_BIND_INDEX_BUFFER | D3D11_BIND_CONSTANT_BUFFER;
-        bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-        bufferDesc.MiscFlags = 0;
-        bufferDesc.StructureByteStride = 0;
-
-        Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
-        HRESULT hr = m_d3d11Device->CreateBuffer(&bufferDesc, nullptr, &buffer);
-        if (FAILED(hr)) {
-            ERR("Failed to create D3D11 buffer for placed resource, hr %#x", hr);
-            return hr;
-        }
-
-        return WrappedD3D12ToD3D11Resource::Create(this, buffer.Get(), pDesc,
-                                   InitialState, riid, ppvResource);
+    // Default heap resources D3D11 can tile live in the heap's tiles, so
+    // resources placed at the same offset alias. Everything else, upload
+    // buffers with their renaming ring included, gets memory of its own.
+    bool tiled =
+        m_tilePoolManager->IsSupported() &&
+        heapDesc.Properties.Type == D3D12_HEAP_TYPE_DEFAULT &&
+        pDesc->SampleDesc.Count <= 1 &&
+        (pDesc->Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ||
+         pDesc->Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D ||
+         (pDesc->Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D &&
+          m_tilePoolManager->GetTier() >= D3D11_TILED_RESOURCES_TIER_3));
+    if (!tiled) {
+        return WrappedD3D12ToD3D11Resource::Create(
+            this, &heapDesc.Properties, heapDesc.Flags, pDesc, InitialState,
+            pOptimizedClearValue, riid, ppvResource);
     }
 
-    return WrappedD3D12ToD3D11Resource::Create(this, heap->GetD3D11Buffer(), pDesc,
-                               InitialState, riid, ppvResource);
+    Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+    HRESULT hr = WrappedD3D12ToD3D11Resource::CreateReserved(
+        this, pDesc, InitialState, IID_PPV_ARGS(&resource));
+    if (FAILED(hr)) {
+        return hr;
+    }
+    hr = heap->MapPlacedResource(GetD3D11Resource(resource.Get()),
+                                 HeapOffset);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    return resource->QueryInterface(riid, ppvResource);
 }
 
 HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::CreateReservedResource(
@@ -1071,7 +1117,14 @@ HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::CreateReservedResource(
     TRACE("WrappedD3D12ToD3D11Device::CreateReservedResource(%p, %u, %p, %s, %p)", pDesc,
           InitialState, pOptimizedClearValue, debugstr_guid(&riid).c_str(),
           ppvResource);
-    return E_NOTIMPL;
+
+    if (!m_tilePoolManager->IsSupported()) {
+        WARN("Reserved resources need D3D11 tiled resources support.");
+        return E_NOTIMPL;
+    }
+
+    return WrappedD3D12ToD3D11Resource::CreateReserved(
+        this, pDesc, InitialState, riid, ppvResource);
 }
 
 HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::CreateSharedHandle(
@@ -1100,13 +1153,35 @@ WrappedD3D12ToD3D11Device::OpenSharedHandleByName(LPCWSTR Name, DWORD Access, HA
 HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::MakeResident(UINT NumObjects,
                                              ID3D12Pageable* const* ppObjects) {
     TRACE("WrappedD3D12ToD3D11Device::MakeResident(%u, %p)", NumObjects, ppObjects);
-    return E_NOTIMPL;
+
+    if (NumObjects && !ppObjects) {
+        return E_INVALIDARG;
+    }
+
+    for (UINT i = 0; i < NumObjects; ++i) {
+        if (WrappedD3D12ToD3D11Resource* resource =
+                GetPageableResource(ppObjects[i])) {
+            m_residencyManager->MakeResident(resource);
+        }
+    }
+    return S_OK;
 }
 
 HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::Evict(UINT NumObjects,
                                              ID3D12Pageable* const* ppObjects) {
     TRACE("WrappedD3D12ToD3D11Device::Evict(%u, %p)", NumObjects, ppObjects);
-    return E_NOTIMPL;
+
+    if (NumObjects && !ppObjects) {
+        return E_INVALIDARG;
+    }
+
+    for (UINT i = 0; i < NumObjects; ++i) {
+        if (WrappedD3D12ToD3D11Resource* resource =
+                GetPageableResource(ppObjects[i])) {
+            m_residencyManager->Evict(resource);
+        }
+    }
+    return S_OK;
 }
 
 HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::CreateFence(UINT64 InitialValue,
@@ -1136,22 +1211,16 @@ HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::GetDeviceRemovedReason() {
     return S_OK;
 }
 
-void WrappedD3D12ToD3D11Device::StoreD3D11ResourceMapping(ID3D12Resource* d3d12Resource, ID3D11Resource* d3d11Resource) {
-    std::lock_guard<std::mutex> lock(m_resourceMappingMutex);
-    m_d3d12ToD3d11Resources[d3d12Resource] = d3d11Resource;
-    m_d3d11ToD3d12Resources[d3d11Resource] = d3d12Resource;
-}
-
 ID3D11Resource* WrappedD3D12ToD3D11Device::GetD3D11Resource(ID3D12Resource* d3d12Resource) {
-    std::lock_guard<std::mutex> lock(m_resourceMappingMutex);
-    auto it = m_d3d12ToD3d11Resources.find(d3d12Resource);
-    return (it != m_d3d12ToD3d11Resources.end()) ? it->second : nullptr;
+    if (!d3d12Resource) {
+        return nullptr;
+    }
+    return static_cast<WrappedD3D12ToD3D11Resource*>(d3d12Resource)
+        ->GetD3D11Resource();
 }
 
 ID3D12Resource* WrappedD3D12ToD3D11Device::GetD3D12Resource(ID3D11Resource* d3d11Resource) {
-    std::lock_guard<std::mutex> lock(m_resourceMappingMutex);
-    auto it = m_d3d11ToD3d12Resources.find(d3d11Resource);
-    return (it != m_d3d11ToD3d12Resources.end()) ? it->second : nullptr;
+    return WrappedD3D12ToD3D11Resource::FromD3D11Resource(d3d11Resource);
 }
 
 void STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::GetCopyableFootprints(
@@ -1170,66 +1239,30 @@ void STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::GetCopyableFootprints(
         return;
     }
 
-    // Calculate basic texture information
-    UINT width = (UINT)pResourceDesc->Width;
-    UINT height = pResourceDesc->Height;
-    UINT depth = (pResourceDesc->Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D) ? 
-                 pResourceDesc->DepthOrArraySize : 1;
-    UINT arraySize = (pResourceDesc->Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE3D) ?
-                    pResourceDesc->DepthOrArraySize : 1;
-    UINT mipLevels = pResourceDesc->MipLevels;
-    DXGI_FORMAT format = pResourceDesc->Format;
-
-    // Get format information
-    UINT formatByteSize = GetFormatByteSize(format);
-    if (formatByteSize == 0) {
-        ERR("Unsupported format: %d", format);
+    std::shared_ptr<const FootprintSet> set = m_footprintCache->Get(
+        *pResourceDesc, FirstSubresource, NumSubresources);
+    if (!set) {
+        if (pTotalBytes) {
+            *pTotalBytes = UINT64_MAX;
+        }
         return;
     }
 
-    UINT64 totalSize = 0;
-    for (UINT i = 0; i < NumSubresources; i++) {
-        UINT subresource = FirstSubresource + i;
-        UINT mipLevel = subresource % mipLevels;
-        
-        // Calculate dimensions for this mip level
-        UINT mipWidth = std::max(1U, width >> mipLevel);
-        UINT mipHeight = std::max(1U, height >> mipLevel);
-        UINT mipDepth = std::max(1U, depth >> mipLevel);
-
-        // Calculate row pitch (aligned to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT)
-        UINT rowPitch = ((mipWidth * formatByteSize + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) 
-                        / D3D12_TEXTURE_DATA_PITCH_ALIGNMENT) 
-                        * D3D12_TEXTURE_DATA_PITCH_ALIGNMENT;
-
-        // Fill in the footprint if requested
-        if (pLayouts) {
-            pLayouts[i].Offset = BaseOffset + totalSize;
-            pLayouts[i].Footprint.Format = format;
-            pLayouts[i].Footprint.Width = mipWidth;
-            pLayouts[i].Footprint.Height = mipHeight;
-            pLayouts[i].Footprint.Depth = mipDepth;
-            pLayouts[i].Footprint.RowPitch = rowPitch;
+    if (pLayouts) {
+        for (UINT i = 0; i < NumSubresources; i++) {
+            pLayouts[i] = set->layouts[i];
+            pLayouts[i].Offset += BaseOffset;
         }
-
-        // Calculate size information
-        UINT64 rowSize = mipWidth * formatByteSize;
-        UINT numRows = mipHeight * mipDepth;
-        UINT64 subresourceSize = (UINT64)rowPitch * numRows;
-
-        // Store size information if requested
-        if (pNumRows) {
-            pNumRows[i] = numRows;
-        }
-        if (pRowSizeInBytes) {
-            pRowSizeInBytes[i] = rowSize;
-        }
-        
-        totalSize += subresourceSize;
     }
-
+    if (pNumRows) {
+        std::copy(set->numRows.begin(), set->numRows.end(), pNumRows);
+    }
+    if (pRowSizeInBytes) {
+        std::copy(set->rowSizes.begin(), set->rowSizes.end(),
+                  pRowSizeInBytes);
+    }
     if (pTotalBytes) {
-        *pTotalBytes = totalSize;
+        *pTotalBytes = set->totalBytes;
     }
 }
 
@@ -1263,6 +1296,27 @@ void STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::GetResourceTiling(
           pTiledResource, pNumTilesForEntireResource, pPackedMipDesc,
           pStandardTileShapeForNonPackedMips, pNumSubresourceTilings,
           FirstSubresourceTilingToGet, pSubresourceTilingsForNonPackedMips);
+
+    // The D3D12 tiling structs are laid out exactly like the D3D11 ones
+    static_assert(sizeof(D3D12_PACKED_MIP_INFO) ==
+                  sizeof(D3D11_PACKED_MIP_DESC));
+    static_assert(sizeof(D3D12_TILE_SHAPE) == sizeof(D3D11_TILE_SHAPE));
+    static_assert(sizeof(D3D12_SUBRESOURCE_TILING) ==
+                  sizeof(D3D11_SUBRESOURCE_TILING));
+
+    ID3D11Resource* d3d11Resource = GetD3D11Resource(pTiledResource);
+    if (!d3d11Resource || !m_d3d11Device2) {
+        WARN("No tiled D3D11 resource for %p.", pTiledResource);
+        return;
+    }
+
+    m_d3d11Device2->GetResourceTiling(
+        d3d11Resource, pNumTilesForEntireResource,
+        reinterpret_cast<D3D11_PACKED_MIP_DESC*>(pPackedMipDesc),
+        reinterpret_cast<D3D11_TILE_SHAPE*>(pStandardTileShapeForNonPackedMips),
+        pNumSubresourceTilings, FirstSubresourceTilingToGet,
+        reinterpret_cast<D3D11_SUBRESOURCE_TILING*>(
+            pSubresourceTilingsForNonPackedMips));
 }
 
 LUID* STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::GetAdapterLuid(LUID* pLuid) {
@@ -1292,113 +1346,18 @@ WrappedD3D12ToD3D11Device::CreatePipelineState(const D3D12_PIPELINE_STATE_STREAM
         return E_INVALIDARG;
     }
 
-    // Parse the pipeline state stream
-    const uint8_t* stream = static_cast<const uint8_t*>(pDesc->pPipelineStateSubobjectStream);
-    size_t streamSize = pDesc->SizeInBytes;
-    
-    // Create appropriate pipeline state based on the stream type
-    D3D12_PIPELINE_STATE_SUBOBJECT_TYPE streamType = *reinterpret_cast<const D3D12_PIPELINE_STATE_SUBOBJECT_TYPE*>(stream);
-    
-    if (streamType == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS) {
-        // Handle compute pipeline state
-        D3D12_COMPUTE_PIPELINE_STATE_DESC computeDesc = {};
-        
-        // Parse compute shader from stream
-        stream += sizeof(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE);
-        computeDesc.CS = *reinterpret_cast<const D3D12_SHADER_BYTECODE*>(stream);
-        
-        // Create compute pipeline state
-        return CreateComputePipelineState(&computeDesc, riid, ppPipelineState);
-    } else {
-        // Handle graphics pipeline state
-        D3D12_GRAPHICS_PIPELINE_STATE_DESC graphicsDesc = {};
-        
-        // Parse graphics pipeline state from stream
-        while (stream < static_cast<const uint8_t*>(pDesc->pPipelineStateSubobjectStream) + streamSize) {
-            D3D12_PIPELINE_STATE_SUBOBJECT_TYPE type = *reinterpret_cast<const D3D12_PIPELINE_STATE_SUBOBJECT_TYPE*>(stream);
-            stream += sizeof(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE);
-            
-            switch (type) {
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS:
-                    graphicsDesc.VS = *reinterpret_cast<const D3D12_SHADER_BYTECODE*>(stream);
-                    stream += sizeof(D3D12_SHADER_BYTECODE);
-                    break;
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS:
-                    graphicsDesc.PS = *reinterpret_cast<const D3D12_SHADER_BYTECODE*>(stream);
-                    stream += sizeof(D3D12_SHADER_BYTECODE);
-                    break;
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS:
-                    graphicsDesc.DS = *reinterpret_cast<const D3D12_SHADER_BYTECODE*>(stream);
-                    stream += sizeof(D3D12_SHADER_BYTECODE);
-                    break;
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS:
-                    graphicsDesc.HS = *reinterpret_cast<const D3D12_SHADER_BYTECODE*>(stream);
-                    stream += sizeof(D3D12_SHADER_BYTECODE);
-                    break;
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS:
-                    graphicsDesc.GS = *reinterpret_cast<const D3D12_SHADER_BYTECODE*>(stream);
-                    stream += sizeof(D3D12_SHADER_BYTECODE);
-                    break;
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT:
-                    graphicsDesc.StreamOutput = *reinterpret_cast<const D3D12_STREAM_OUTPUT_DESC*>(stream);
-                    stream += sizeof(D3D12_STREAM_OUTPUT_DESC);
-                    break;
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_BLEND:
-                    graphicsDesc.BlendState = *reinterpret_cast<const D3D12_BLEND_DESC*>(stream);
-                    stream += sizeof(D3D12_BLEND_DESC);
-                    break;
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_MASK:
-                    graphicsDesc.SampleMask = *reinterpret_cast<const UINT*>(stream);
-                    stream += sizeof(UINT);
-                    break;
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RASTERIZER:
-                    graphicsDesc.RasterizerState = *reinterpret_cast<const D3D12_RASTERIZER_DESC*>(stream);
-                    stream += sizeof(D3D12_RASTERIZER_DESC);
-                    break;
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL:
-                    graphicsDesc.DepthStencilState = *reinterpret_cast<const D3D12_DEPTH_STENCIL_DESC*>(stream);
-                    stream += sizeof(D3D12_DEPTH_STENCIL_DESC);
-                    break;
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT:
-                    graphicsDesc.InputLayout = *reinterpret_cast<const D3D12_INPUT_LAYOUT_DESC*>(stream);
-                    stream += sizeof(D3D12_INPUT_LAYOUT_DESC);
-                    break;
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_IB_STRIP_CUT_VALUE:
-                    graphicsDesc.IBStripCutValue = *reinterpret_cast<const D3D12_INDEX_BUFFER_STRIP_CUT_VALUE*>(stream);
-                    stream += sizeof(D3D12_INDEX_BUFFER_STRIP_CUT_VALUE);
-                    break;
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PRIMITIVE_TOPOLOGY:
-                    graphicsDesc.PrimitiveTopologyType = *reinterpret_cast<const D3D12_PRIMITIVE_TOPOLOGY_TYPE*>(stream);
-                    stream += sizeof(D3D12_PRIMITIVE_TOPOLOGY_TYPE);
-                    break;
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RENDER_TARGET_FORMATS:
-                    {
-                        const D3D12_RT_FORMAT_ARRAY* rtFormats = reinterpret_cast<const D3D12_RT_FORMAT_ARRAY*>(stream);
-                        graphicsDesc.NumRenderTargets = rtFormats->NumRenderTargets;
-                        for (UINT i = 0; i < rtFormats->NumRenderTargets; i++) {
-                            graphicsDesc.RTVFormats[i] = rtFormats->RTFormats[i];
-                        }
-                        stream += sizeof(D3D12_RT_FORMAT_ARRAY);
-                    }
-                    break;
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL_FORMAT:
-                    graphicsDesc.DSVFormat = *reinterpret_cast<const DXGI_FORMAT*>(stream);
-                    stream += sizeof(DXGI_FORMAT);
-                    break;
-                case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_DESC:
-                    graphicsDesc.SampleDesc = *reinterpret_cast<const DXGI_SAMPLE_DESC*>(stream);
-                    stream += sizeof(DXGI_SAMPLE_DESC);
-                    break;
-                default:
-                    // Skip unknown subobjects
-                    stream += sizeof(uint64_t); // Assume 64-bit alignment
-                    break;
-            }
-        }
-        
-        // Create graphics pipeline state
-        return CreateGraphicsPipelineState(&graphicsDesc, riid, ppPipelineState);
+    // Goes straight to the same cached create path as the legacy calls
+    ParsedPipelineStream parsed;
+    HRESULT hr = ParsePipelineStateStream(*pDesc, &parsed);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    if (parsed.isCompute) {
+        return WrappedD3D12ToD3D11PipelineState::CreateCompute(
+            this, &parsed.compute, riid, ppPipelineState);
     }
+    return WrappedD3D12ToD3D11PipelineState::CreateGraphics(
+        this, &parsed.graphics, riid, ppPipelineState);
 }
 
 // ID3D12Device2 methods
@@ -1409,7 +1368,16 @@ HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::CreatePipelineLibrary(
     TRACE("  Blob: %p, length: %zu, riid: %s, ppPipelineLibrary: %p",
           pLibraryBlob, BlobLengthInBytes, debugstr_guid(&riid).c_str(),
           ppPipelineLibrary);
-    return E_NOTIMPL;
+
+    // A null output only asks whether the blob could be opened
+    if (!ppPipelineLibrary) {
+        Microsoft::WRL::ComPtr<ID3D12PipelineLibrary> library;
+        HRESULT hr = WrappedD3D12ToD3D11PipelineLibrary::Create(
+            this, pLibraryBlob, BlobLengthInBytes, IID_PPV_ARGS(&library));
+        return FAILED(hr) ? hr : S_FALSE;
+    }
+    return WrappedD3D12ToD3D11PipelineLibrary::Create(
+        this, pLibraryBlob, BlobLengthInBytes, riid, ppPipelineLibrary);
 }
 
 HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::SetResidencyPriority(
@@ -1418,7 +1386,19 @@ HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::SetResidencyPriority(
     TRACE("WrappedD3D12ToD3D11Device::SetResidencyPriority called on object %p", this);
     TRACE("  NumObjects: %u, ppObjects: %p, pPriorities: %p", NumObjects,
           ppObjects, pPriorities);
-    return E_NOTIMPL;
+
+    if (NumObjects && (!ppObjects || !pPriorities)) {
+        return E_INVALIDARG;
+    }
+
+    // D3D12 residency priorities use the DXGI eviction priority scale
+    for (UINT i = 0; i < NumObjects; ++i) {
+        if (WrappedD3D12ToD3D11Resource* resource =
+                GetPageableResource(ppObjects[i])) {
+            m_residencyManager->SetPriority(resource, pPriorities[i]);
+        }
+    }
+    return S_OK;
 }
 
 // ID3D12DebugDevice methods
@@ -1441,6 +1421,50 @@ WrappedD3D12ToD3D11Device::ReportLiveDeviceObjects(D3D12_RLDO_FLAGS Flags) {
     return S_OK;  // Pretend we reported
 }
 
+// IDxiidedMemoryStats methods
+HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::GetMemoryCounters(
+    UINT* pCount, MemoryCounter* pCounters) {
+    TRACE("WrappedD3D12ToD3D11Device::GetMemoryCounters(%p, %p)", pCount,
+          pCounters);
+    if (!pCount) {
+        return E_INVALIDARG;
+    }
+
+    if (pCounters) {
+        UINT count = std::min(*pCount, kMemoryCategoryCount);
+        for (UINT i = 0; i < count; ++i) {
+            pCounters[i] =
+                MemoryStats::Instance().Get(static_cast<MemoryCategory>(i));
+        }
+    }
+    *pCount = kMemoryCategoryCount;
+    return S_OK;
+}
+
+const char* STDMETHODCALLTYPE
+WrappedD3D12ToD3D11Device::GetMemoryCategoryName(UINT category) {
+    return MemoryStats::GetName(static_cast<MemoryCategory>(category));
+}
+
+// IDxiidedPipelineCompiler methods
+HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::PrioritizePipelineStates(
+    UINT NumStates, ID3D12PipelineState* const* ppStates) {
+    TRACE("WrappedD3D12ToD3D11Device::PrioritizePipelineStates(%u, %p)",
+          NumStates, ppStates);
+    if (NumStates && !ppStates) {
+        return E_INVALIDARG;
+    }
+
+    // Reversed so the first state ends up at the front of the queue
+    for (UINT i = NumStates; i-- > 0;) {
+        if (ppStates[i]) {
+            m_pipelineCompiler->Prioritize(
+                static_cast<WrappedD3D12ToD3D11PipelineState*>(ppStates[i]));
+        }
+    }
+    return S_OK;
+}
+
 // ID3D11Device methods
 HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11Device::CreateBuffer(
     const D3D11_BUFFER_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData,
@@ -0,0 +1,266 @@
+#include "d3d11_impl/dxbc.hpp"
+
+#include <cstring>
+
+#include "common/debug.hpp"
+
+namespace dxiided {
+
+namespace {
+
+struct DxbcHeader {
+    uint32_t magic;
+    uint8_t checksum[16];
+    uint32_t version;
+    uint32_t totalSize;
+    uint32_t chunkCount;
+};
+
+struct DxbcChunkHeader {
+    uint32_t fourcc;
+    uint32_t size;
+};
+
+// The checksum covers everything after the magic and the checksum itself
+constexpr SIZE_T kDxbcChecksumSkip = 20;
+
+// Size of one signature element; 0 for chunks that are not signatures
+uint32_t GetSignatureElementSize(uint32_t fourcc) {
+    switch (fourcc) {
+        case kDxbcChunkISGN:
+        case kDxbcChunkOSGN:
+        case kDxbcChunkPCSG:
+            return 24;
+        case kDxbcChunkOSG5:
+            return 28;
+        case kDxbcChunkISG1:
+        case kDxbcChunkOSG1:
+        case kDxbcChunkPSG1:
+            return 32;
+    }
+    return 0;
+}
+
+// An element count and offset, then the elements, each naming its
+// semantic by an offset into the chunk. The later formats put a stream
+// index before the name.
+bool ValidateSignature(const uint8_t* data, uint32_t size,
+                       uint32_t elementSize, bool hasStream) {
+    uint32_t header[2];
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(header, data, sizeof(header));
+    uint32_t count = header[0];
+    uint32_t offset = header[1];
+    if (offset > size || count > (size - offset) / elementSize) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t name;
+        memcpy(&name, data + offset + i * elementSize + (hasStream ? 4 : 0),
+               sizeof(name));
+        if (name >= size || !memchr(data + name, 0, size - name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SetLocation(DxbcChunkLocation* location, uint32_t offset,
+                 uint32_t size) {
+    location->offset = offset;
+    location->size = size;
+}
+
+constexpr uint32_t kMd5Shifts[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+constexpr uint32_t kMd5Constants[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+    0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+    0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+    0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+    0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+    0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+void Md5Transform(uint32_t state[4], const uint8_t block[64]) {
+    uint32_t words[16];
+    memcpy(words, block, sizeof(words));
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    for (uint32_t i = 0; i < 64; ++i) {
+        uint32_t f, g;
+        if (i < 16) {
+            f = (b & c) | (~b & d);
+            g = i;
+        } else if (i < 32) {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) & 15;
+        } else if (i < 48) {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) & 15;
+        } else {
+            f = c ^ (b | ~d);
+            g = (7 * i) & 15;
+        }
+        uint32_t rotated = a + f + kMd5Constants[i] + words[g];
+        a = d;
+        d = c;
+        c = b;
+        b += (rotated << kMd5Shifts[i]) | (rotated >> (32 - kMd5Shifts[i]));
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+}  // namespace
+
+bool FindDxbcChunk(const void* bytecode, SIZE_T length, uint32_t fourcc,
+                   DxbcChunk* chunk) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(bytecode);
+    if (!bytes || length < sizeof(DxbcHeader)) {
+        return false;
+    }
+
+    DxbcHeader header;
+    memcpy(&header, bytes, sizeof(header));
+    if (header.magic != kDxbcMagic ||
+        header.chunkCount > (length - sizeof(header)) / sizeof(uint32_t)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header.chunkCount; ++i) {
+        uint32_t offset;
+        memcpy(&offset, bytes + sizeof(header) + i * sizeof(uint32_t),
+               sizeof(offset));
+        if (offset > length || length - offset < sizeof(DxbcChunkHeader)) {
+            return false;
+        }
+
+        DxbcChunkHeader chunkHeader;
+        memcpy(&chunkHeader, bytes + offset, sizeof(chunkHeader));
+        if (chunkHeader.fourcc != fourcc) {
+            continue;
+        }
+        if (chunkHeader.size > length - offset - sizeof(chunkHeader)) {
+            return false;
+        }
+        chunk->data = bytes + offset + sizeof(chunkHeader);
+        chunk->size = chunkHeader.size;
+        return true;
+    }
+    return false;
+}
+
+HRESULT ValidateDxbc(const void* bytecode, SIZE_T length,
+                     DxbcContainerInfo* info) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(bytecode);
+    DxbcHeader header;
+    if (!bytes || length < sizeof(header)) {
+        WARN("Shader bytecode of %zu bytes has no DXBC header", length);
+        return E_INVALIDARG;
+    }
+    memcpy(&header, bytes, sizeof(header));
+    if (header.magic != kDxbcMagic) {
+        WARN("Shader bytecode is not DXBC, magic %#x", header.magic);
+        return E_INVALIDARG;
+    }
+    if (header.totalSize < sizeof(header) || header.totalSize > length ||
+        header.chunkCount >
+            (header.totalSize - sizeof(header)) / sizeof(uint32_t)) {
+        WARN("DXBC container of %u bytes with %u chunks does not fit %zu "
+             "bytes", header.totalSize, header.chunkCount, length);
+        return E_INVALIDARG;
+    }
+    SIZE_T size = header.totalSize;
+
+    uint32_t checksum[4];
+    ComputeDxbcChecksum(bytes, size, checksum);
+    if (memcmp(checksum, header.checksum, sizeof(checksum))) {
+        WARN("DXBC container checksum mismatch");
+        return E_INVALIDARG;
+    }
+
+    *info = {};
+    for (uint32_t i = 0; i < header.chunkCount; ++i) {
+        uint32_t offset;
+        memcpy(&offset, bytes + sizeof(header) + i * sizeof(uint32_t),
+               sizeof(offset));
+        DxbcChunkHeader chunk;
+        if (offset > size || size - offset < sizeof(chunk)) {
+            WARN("DXBC chunk %u at %u is out of bounds", i, offset);
+            return E_INVALIDARG;
+        }
+        memcpy(&chunk, bytes + offset, sizeof(chunk));
+        uint32_t dataOffset = offset + sizeof(chunk);
+        if (chunk.size > size - dataOffset) {
+            WARN("DXBC chunk %u of %u bytes is out of bounds", i, chunk.size);
+            return E_INVALIDARG;
+        }
+
+        uint32_t elementSize = GetSignatureElementSize(chunk.fourcc);
+        if (elementSize &&
+            !ValidateSignature(bytes + dataOffset, chunk.size, elementSize,
+                               elementSize != 24)) {
+            WARN("DXBC signature chunk %u is malformed", i);
+            return E_INVALIDARG;
+        }
+
+        if (chunk.fourcc == kDxbcChunkISGN || chunk.fourcc == kDxbcChunkISG1) {
+            SetLocation(&info->inputSignature, dataOffset, chunk.size);
+        }
+    }
+    return S_OK;
+}
+
+void ComputeDxbcChecksum(const void* bytecode, SIZE_T length,
+                         uint32_t checksum[4]) {
+    uint32_t state[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+    const uint8_t* bytes = static_cast<const uint8_t*>(bytecode);
+    SIZE_T remaining = 0;
+    if (length > kDxbcChecksumSkip) {
+        bytes += kDxbcChecksumSkip;
+        remaining = length - kDxbcChecksumSkip;
+    }
+    uint32_t bits = static_cast<uint32_t>(remaining * 8);
+
+    for (; remaining >= 64; bytes += 64, remaining -= 64) {
+        Md5Transform(state, bytes);
+    }
+
+    // Unlike MD5, the bit count goes first in the final block and the last
+    // word holds bits / 4 | 1
+    uint8_t block[64] = {};
+    if (remaining >= 56) {
+        memcpy(block, bytes, remaining);
+        block[remaining] = 0x80;
+        Md5Transform(state, block);
+        memset(block, 0, sizeof(block));
+    } else {
+        memcpy(block + 4, bytes, remaining);
+        block[4 + remaining] = 0x80;
+    }
+    uint32_t last = bits >> 2 | 1;
+    memcpy(block, &bits, sizeof(bits));
+    memcpy(block + 60, &last, sizeof(last));
+    Md5Transform(state, block);
+
+    memcpy(checksum, state, sizeof(state));
+}
+
+}  // namespace dxiided
@@ -1,5 +1,9 @@
 #include "d3d11_impl/heap.hpp"
+
+#include <climits>
+
 #include "d3d11_impl/device.hpp"
+#include "d3d11_impl/tile_pool.hpp"
 
 namespace dxiided {
 
@@ -27,37 +31,67 @@ WrappedD3D12ToD3D11Heap::WrappedD3D12ToD3D11Heap(WrappedD3D12ToD3D11Device* devi
     TRACE(" Properties.MemoryPoolPreference: %d", desc.Properties.MemoryPoolPreference);
     TRACE(" Alignment: %llu", desc.Alignment);
     TRACE(" Flags: %#x", desc.Flags);
+}
+
+WrappedD3D12ToD3D11Heap::~WrappedD3D12ToD3D11Heap() {
+    TRACE("WrappedD3D12ToD3D11Heap::~WrappedD3D12ToD3D11Heap()");
+    if (m_tileCount) {
+        m_device->GetTilePoolManager()->Free(m_firstTile, m_tileCount);
+    }
+}
+
+HRESULT WrappedD3D12ToD3D11Heap::GetFirstTile(UINT* firstTile) {
+    std::lock_guard<std::mutex> lock(m_tileMutex);
+    if (!m_tileCount) {
+        UINT64 tileCount = (m_desc.SizeInBytes + TilePoolManager::kTileSize - 1) /
+                           TilePoolManager::kTileSize;
+        if (!tileCount || tileCount > UINT_MAX) {
+            ERR("Heap size %llu can't be backed by tiles.", m_desc.SizeInBytes);
+            return E_INVALIDARG;
+        }
+
+        HRESULT hr = m_device->GetTilePoolManager()->Allocate(
+            static_cast<UINT>(tileCount), &m_firstTile);
+        if (FAILED(hr)) {
+            return hr;
+        }
+        m_tileCount = static_cast<UINT>(tileCount);
+    }
+
+    *firstTile = m_firstTile;
+    return S_OK;
+}
 
-    // Create a D3D11 buffer to back this heap
-    D3D11_BUFFER_DESC bufferDesc = {};
-    // Cap the actual allocation size to 64KB while still reporting the full size
-    bufferDesc.ByteWidth = 65536; // 64KB cap
-    
-    // Set usage and CPU access flags based on heap properties
-    if (desc.Properties.Type == D3D12_HEAP_TYPE_UPLOAD) {
-        bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-        bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-        bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER | D3D11_BIND_INDEX_BUFFER | D3D11_BIND_CONSTANT_BUFFER;
-    } else if (desc.Properties.Type == D3D12_HEAP_TYPE_READBACK) {
-        bufferDesc.Usage = D3D11_USAGE_STAGING;
-        bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-        bufferDesc.BindFlags = 0;
-    } else {
-        bufferDesc.Usage = D3D11_USAGE_DEFAULT;
-        bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
-        bufferDesc.CPUAccessFlags = 0;
+HRESULT WrappedD3D12ToD3D11Heap::MapPlacedResource(ID3D11Resource* resource,
+                                                   UINT64 offset) {
+    UINT firstTile = 0;
+    HRESULT hr = GetFirstTile(&firstTile);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    TilePoolManager* tilePool = m_device->GetTilePoolManager();
+    UINT tileCount = tilePool->GetTileCount(resource);
+    UINT64 heapTile = offset / TilePoolManager::kTileSize;
+    if (!tileCount || offset % TilePoolManager::kTileSize ||
+        heapTile + tileCount > m_tileCount) {
+        ERR("%u tiles at offset %llu don't fit heap of %u tiles.", tileCount,
+            offset, m_tileCount);
+        return E_INVALIDARG;
     }
-    
-    bufferDesc.MiscFlags = 0;
-    bufferDesc.StructureByteStride = 0;
 
-    // Always create a minimal buffer, but don't fail if it fails
-    HRESULT hr = device->GetD3D11Device()->CreateBuffer(&bufferDesc, nullptr, &m_buffer);
+    D3D11_TILED_RESOURCE_COORDINATE coordinate = {};
+    D3D11_TILE_REGION_SIZE regionSize = {};
+    regionSize.NumTiles = tileCount;
+    UINT rangeFlags = 0;
+    UINT poolOffset = firstTile + static_cast<UINT>(heapTile);
+    hr = tilePool->GetContext2()->UpdateTileMappings(
+        resource, 1, &coordinate, &regionSize, tilePool->GetTilePool(), 1,
+        &rangeFlags, &poolOffset, &tileCount, 0);
     if (FAILED(hr)) {
-        TRACE("Note: Failed to create buffer for heap, hr %#x - continuing anyway", hr);
+        ERR("Failed to map placed resource to heap %p, hr %#x", this, hr);
     }
-    
-    // Always return success even if buffer creation failed
+    return hr;
 }
 
 // IUnknown methods
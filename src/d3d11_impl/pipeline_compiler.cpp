@@ -0,0 +1,159 @@
+#include "d3d11_impl/pipeline_compiler.hpp"
+
+#include <algorithm>
+
+#include "common/config.hpp"
+#include "d3d11_impl/pipeline_state.hpp"
+
+namespace dxiided {
+
+PipelineDescCopy::PipelineDescCopy(
+    const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+    : m_isCompute(false), m_graphics(desc) {
+    m_graphics.VS = CopyShader(desc.VS);
+    m_graphics.PS = CopyShader(desc.PS);
+    m_graphics.DS = CopyShader(desc.DS);
+    m_graphics.HS = CopyShader(desc.HS);
+    m_graphics.GS = CopyShader(desc.GS);
+
+    const D3D12_STREAM_OUTPUT_DESC& so = desc.StreamOutput;
+    if (so.pSODeclaration && so.NumEntries) {
+        m_soEntries.assign(so.pSODeclaration,
+                           so.pSODeclaration + so.NumEntries);
+        for (D3D12_SO_DECLARATION_ENTRY& entry : m_soEntries) {
+            entry.SemanticName = CopyString(entry.SemanticName);
+        }
+    }
+    if (so.pBufferStrides && so.NumStrides) {
+        m_soStrides.assign(so.pBufferStrides,
+                           so.pBufferStrides + so.NumStrides);
+    }
+    m_graphics.StreamOutput.pSODeclaration = m_soEntries.data();
+    m_graphics.StreamOutput.NumEntries = static_cast<UINT>(m_soEntries.size());
+    m_graphics.StreamOutput.pBufferStrides = m_soStrides.data();
+    m_graphics.StreamOutput.NumStrides = static_cast<UINT>(m_soStrides.size());
+
+    const D3D12_INPUT_LAYOUT_DESC& layout = desc.InputLayout;
+    if (layout.pInputElementDescs && layout.NumElements) {
+        m_inputElements.assign(layout.pInputElementDescs,
+                               layout.pInputElementDescs + layout.NumElements);
+        for (D3D12_INPUT_ELEMENT_DESC& element : m_inputElements) {
+            element.SemanticName = CopyString(element.SemanticName);
+        }
+    }
+    m_graphics.InputLayout.pInputElementDescs = m_inputElements.data();
+    m_graphics.InputLayout.NumElements =
+        static_cast<UINT>(m_inputElements.size());
+
+    // Neither is used to build the D3D11 objects
+    m_graphics.pRootSignature = nullptr;
+    m_graphics.CachedPSO = {};
+}
+
+PipelineDescCopy::PipelineDescCopy(
+    const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc)
+    : m_isCompute(true), m_compute(desc) {
+    m_compute.CS = CopyShader(desc.CS);
+    m_compute.pRootSignature = nullptr;
+    m_compute.CachedPSO = {};
+}
+
+D3D12_SHADER_BYTECODE PipelineDescCopy::CopyShader(
+    const D3D12_SHADER_BYTECODE& shader) {
+    if (!shader.pShaderBytecode || !shader.BytecodeLength) {
+        return {};
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(shader.pShaderBytecode);
+    m_bytecode.emplace_back(bytes, bytes + shader.BytecodeLength);
+    return {m_bytecode.back().data(), m_bytecode.back().size()};
+}
+
+const char* PipelineDescCopy::CopyString(const char* str) {
+    if (!str) {
+        return nullptr;
+    }
+    m_strings.emplace_back(str);
+    return m_strings.back().c_str();
+}
+
+PipelineCompiler::PipelineCompiler() { TRACE("PipelineCompiler created"); }
+
+PipelineCompiler::~PipelineCompiler() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        // Anything left compiles on first use
+        m_queue.clear();
+    }
+    m_cv.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+    TRACE("PipelineCompiler destroyed");
+}
+
+void PipelineCompiler::Enqueue(WrappedD3D12ToD3D11PipelineState* state) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stop) {
+            return;
+        }
+
+        // Workers only start once something actually needs them
+        if (m_workers.empty()) {
+            UINT count =
+                static_cast<UINT>(Config::Instance().PipelineCompileThreads());
+            if (!count) {
+                count = std::max(std::thread::hardware_concurrency() / 2, 1u);
+            }
+            TRACE("Starting %u pipeline compiler threads", count);
+            for (UINT i = 0; i < count; ++i) {
+                m_workers.emplace_back(&PipelineCompiler::WorkerMain, this);
+            }
+        }
+        m_queue.push_back(state);
+    }
+    m_cv.notify_one();
+}
+
+void PipelineCompiler::Prioritize(WrappedD3D12ToD3D11PipelineState* state) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = std::find_if(m_queue.begin(), m_queue.end(),
+                           [state](const auto& queued) {
+                               return queued.Get() == state;
+                           });
+    if (it == m_queue.end() || it == m_queue.begin()) {
+        return;
+    }
+    Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState> moved =
+        std::move(*it);
+    m_queue.erase(it);
+    m_queue.push_front(std::move(moved));
+}
+
+void PipelineCompiler::WorkerMain() {
+    TRACE("Pipeline compiler thread started");
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop) {
+        if (m_queue.empty()) {
+            m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            continue;
+        }
+
+        Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState> state =
+            std::move(m_queue.front());
+        m_queue.pop_front();
+        lock.unlock();
+
+        // A no-op if the application needed it first
+        state->Compile();
+        state.Reset();
+
+        lock.lock();
+    }
+
+    TRACE("Pipeline compiler thread stopped");
+}
+
+}  // namespace dxiided
@@ -0,0 +1,542 @@
+#include "d3d11_impl/pipeline_disk_cache.hpp"
+
+#include <d3dcompiler.h>
+
+#include <cstring>
+
+#include "common/config.hpp"
+#include "common/memory_stats.hpp"
+#include "d3d11_impl/pipeline_compiler.hpp"
+
+namespace dxiided {
+
+namespace {
+
+enum class PipelineKind : uint32_t { Graphics, Compute };
+
+class BlobWriter {
+   public:
+    void Write(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        m_data.insert(m_data.end(), bytes, bytes + size);
+    }
+
+    template <typename T>
+    void WriteValue(const T& value) {
+        Write(&value, sizeof(value));
+    }
+
+    void WriteString(const char* str) {
+        if (!str) {
+            str = "";
+        }
+        Write(str, strlen(str) + 1);
+    }
+
+    void WriteShader(const D3D12_SHADER_BYTECODE& shader) {
+        UINT64 length = shader.pShaderBytecode ? shader.BytecodeLength : 0;
+        WriteValue(length);
+        if (length) {
+            Write(shader.pShaderBytecode, length);
+        }
+    }
+
+    std::vector<uint8_t> Take() { return std::move(m_data); }
+
+   private:
+    std::vector<uint8_t> m_data;
+};
+
+// Reads in place, strings and shaders point into the data
+class BlobReader {
+   public:
+    BlobReader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+    bool Read(void* out, size_t size) {
+        if (size > m_size - m_offset) {
+            return false;
+        }
+        memcpy(out, m_data + m_offset, size);
+        m_offset += size;
+        return true;
+    }
+
+    template <typename T>
+    bool ReadValue(T* out) {
+        return Read(out, sizeof(*out));
+    }
+
+    bool ReadString(const char** out) {
+        const void* end = memchr(m_data + m_offset, 0, m_size - m_offset);
+        if (!end) {
+            return false;
+        }
+        *out = reinterpret_cast<const char*>(m_data + m_offset);
+        m_offset = static_cast<const uint8_t*>(end) - m_data + 1;
+        return true;
+    }
+
+    bool ReadShader(D3D12_SHADER_BYTECODE* shader) {
+        UINT64 length = 0;
+        if (!ReadValue(&length) || length > m_size - m_offset) {
+            return false;
+        }
+        shader->pShaderBytecode = length ? m_data + m_offset : nullptr;
+        shader->BytecodeLength = static_cast<SIZE_T>(length);
+        m_offset += static_cast<size_t>(length);
+        return true;
+    }
+
+    bool AtEnd() const { return m_offset == m_size; }
+
+   private:
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_offset{0};
+};
+
+bool ReadGraphicsDesc(BlobReader& reader,
+                      D3D12_GRAPHICS_PIPELINE_STATE_DESC* desc,
+                      std::vector<D3D12_SO_DECLARATION_ENTRY>* soEntries,
+                      std::vector<UINT>* soStrides,
+                      std::vector<D3D12_INPUT_ELEMENT_DESC>* inputElements) {
+    if (!reader.ReadShader(&desc->VS) || !reader.ReadShader(&desc->PS) ||
+        !reader.ReadShader(&desc->DS) || !reader.ReadShader(&desc->HS) ||
+        !reader.ReadShader(&desc->GS)) {
+        return false;
+    }
+
+    UINT count = 0;
+    if (!reader.ReadValue(&count)) {
+        return false;
+    }
+    for (UINT i = 0; i < count; i++) {
+        D3D12_SO_DECLARATION_ENTRY entry = {};
+        if (!reader.ReadValue(&entry.Stream) ||
+            !reader.ReadString(&entry.SemanticName) ||
+            !reader.ReadValue(&entry.SemanticIndex) ||
+            !reader.ReadValue(&entry.StartComponent) ||
+            !reader.ReadValue(&entry.ComponentCount) ||
+            !reader.ReadValue(&entry.OutputSlot)) {
+            return false;
+        }
+        soEntries->push_back(entry);
+    }
+    if (!reader.ReadValue(&count)) {
+        return false;
+    }
+    for (UINT i = 0; i < count; i++) {
+        UINT stride = 0;
+        if (!reader.ReadValue(&stride)) {
+            return false;
+        }
+        soStrides->push_back(stride);
+    }
+    desc->StreamOutput.pSODeclaration = soEntries->data();
+    desc->StreamOutput.NumEntries = static_cast<UINT>(soEntries->size());
+    desc->StreamOutput.pBufferStrides = soStrides->data();
+    desc->StreamOutput.NumStrides = static_cast<UINT>(soStrides->size());
+
+    if (!reader.ReadValue(&desc->StreamOutput.RasterizedStream) ||
+        !reader.ReadValue(&desc->BlendState) ||
+        !reader.ReadValue(&desc->SampleMask) ||
+        !reader.ReadValue(&desc->RasterizerState) ||
+        !reader.ReadValue(&desc->DepthStencilState) ||
+        !reader.ReadValue(&count)) {
+        return false;
+    }
+    for (UINT i = 0; i < count; i++) {
+        D3D12_INPUT_ELEMENT_DESC element = {};
+        if (!reader.ReadString(&element.SemanticName) ||
+            !reader.ReadValue(&element.SemanticIndex) ||
+            !reader.ReadValue(&element.Format) ||
+            !reader.ReadValue(&element.InputSlot) ||
+            !reader.ReadValue(&element.AlignedByteOffset) ||
+            !reader.ReadValue(&element.InputSlotClass) ||
+            !reader.ReadValue(&element.InstanceDataStepRate)) {
+            return false;
+        }
+        inputElements->push_back(element);
+    }
+    desc->InputLayout.pInputElementDescs = inputElements->data();
+    desc->InputLayout.NumElements = static_cast<UINT>(inputElements->size());
+
+    return reader.ReadValue(&desc->IBStripCutValue) &&
+           reader.ReadValue(&desc->PrimitiveTopologyType) &&
+           reader.ReadValue(&desc->NumRenderTargets) &&
+           reader.ReadValue(&desc->RTVFormats) &&
+           reader.ReadValue(&desc->DSVFormat) &&
+           reader.ReadValue(&desc->SampleDesc) &&
+           reader.ReadValue(&desc->NodeMask) &&
+           reader.ReadValue(&desc->Flags);
+}
+
+bool ReadFileAt(HANDLE file, UINT64 offset, void* out, DWORD size) {
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = static_cast<DWORD>(offset);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD read = 0;
+    return ReadFile(file, out, size, &read, &overlapped) && read == size;
+}
+
+}  // namespace
+
+std::vector<uint8_t> SerializePipelineDesc(
+    const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) {
+    BlobWriter writer;
+    writer.WriteValue(PipelineKind::Graphics);
+    writer.WriteShader(desc.VS);
+    writer.WriteShader(desc.PS);
+    writer.WriteShader(desc.DS);
+    writer.WriteShader(desc.HS);
+    writer.WriteShader(desc.GS);
+
+    const D3D12_STREAM_OUTPUT_DESC& so = desc.StreamOutput;
+    UINT numEntries = so.pSODeclaration ? so.NumEntries : 0;
+    writer.WriteValue(numEntries);
+    for (UINT i = 0; i < numEntries; i++) {
+        const D3D12_SO_DECLARATION_ENTRY& entry = so.pSODeclaration[i];
+        writer.WriteValue(entry.Stream);
+        writer.WriteString(entry.SemanticName);
+        writer.WriteValue(entry.SemanticIndex);
+        writer.WriteValue(entry.StartComponent);
+        writer.WriteValue(entry.ComponentCount);
+        writer.WriteValue(entry.OutputSlot);
+    }
+    UINT numStrides = so.pBufferStrides ? so.NumStrides : 0;
+    writer.WriteValue(numStrides);
+    if (numStrides) {
+        writer.Write(so.pBufferStrides, numStrides * sizeof(UINT));
+    }
+    writer.WriteValue(so.RasterizedStream);
+
+    writer.WriteValue(desc.BlendState);
+    writer.WriteValue(desc.SampleMask);
+    writer.WriteValue(desc.RasterizerState);
+    writer.WriteValue(desc.DepthStencilState);
+
+    const D3D12_INPUT_LAYOUT_DESC& layout = desc.InputLayout;
+    UINT numElements = layout.pInputElementDescs ? layout.NumElements : 0;
+    writer.WriteValue(numElements);
+    for (UINT i = 0; i < numElements; i++) {
+        const D3D12_INPUT_ELEMENT_DESC& element = layout.pInputElementDescs[i];
+        writer.WriteString(element.SemanticName);
+        writer.WriteValue(element.SemanticIndex);
+        writer.WriteValue(element.Format);
+        writer.WriteValue(element.InputSlot);
+        writer.WriteValue(element.AlignedByteOffset);
+        writer.WriteValue(element.InputSlotClass);
+        writer.WriteValue(element.InstanceDataStepRate);
+    }
+
+    writer.WriteValue(desc.IBStripCutValue);
+    writer.WriteValue(desc.PrimitiveTopologyType);
+    writer.WriteValue(desc.NumRenderTargets);
+    writer.WriteValue(desc.RTVFormats);
+    writer.WriteValue(desc.DSVFormat);
+    writer.WriteValue(desc.SampleDesc);
+    writer.WriteValue(desc.NodeMask);
+    writer.WriteValue(desc.Flags);
+    return writer.Take();
+}
+
+std::vector<uint8_t> SerializePipelineDesc(
+    const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc) {
+    BlobWriter writer;
+    writer.WriteValue(PipelineKind::Compute);
+    writer.WriteShader(desc.CS);
+    writer.WriteValue(desc.NodeMask);
+    writer.WriteValue(desc.Flags);
+    return writer.Take();
+}
+
+std::unique_ptr<PipelineDescCopy> DeserializePipelineDesc(const uint8_t* data,
+                                                          size_t size) {
+    BlobReader reader(data, size);
+    PipelineKind kind;
+    if (!reader.ReadValue(&kind)) {
+        return nullptr;
+    }
+
+    if (kind == PipelineKind::Compute) {
+        D3D12_COMPUTE_PIPELINE_STATE_DESC desc = {};
+        if (!reader.ReadShader(&desc.CS) || !reader.ReadValue(&desc.NodeMask) ||
+            !reader.ReadValue(&desc.Flags) || !reader.AtEnd()) {
+            return nullptr;
+        }
+        return std::make_unique<PipelineDescCopy>(desc);
+    }
+
+    if (kind == PipelineKind::Graphics) {
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {};
+        std::vector<D3D12_SO_DECLARATION_ENTRY> soEntries;
+        std::vector<UINT> soStrides;
+        std::vector<D3D12_INPUT_ELEMENT_DESC> inputElements;
+        if (!ReadGraphicsDesc(reader, &desc, &soEntries, &soStrides,
+                              &inputElements) ||
+            !reader.AtEnd()) {
+            return nullptr;
+        }
+        return std::make_unique<PipelineDescCopy>(desc);
+    }
+
+    return nullptr;
+}
+
+PipelineDiskCache::PipelineDiskCache()
+    : m_path(Config::Instance().PipelineCachePath()) {
+    Load();
+    TRACE("PipelineDiskCache created, %zu entries from \"%s\"",
+          m_entries.size(), m_path.c_str());
+}
+
+PipelineDiskCache::~PipelineDiskCache() {
+    // The file can't be rewritten while it is mapped
+    if (m_view) {
+        UnmapViewOfFile(m_view);
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+    }
+
+    WriteNewEntries();
+
+    for (const auto& entry : m_newEntries) {
+        MemoryStats::Instance().Remove(MemoryCategory::PipelineStateCache,
+                                       entry.second.size());
+    }
+    TRACE("PipelineDiskCache destroyed, %zu new entries",
+          m_newEntries.size());
+}
+
+uint32_t PipelineDiskCache::Checksum(const uint8_t* data, size_t size) {
+    return static_cast<uint32_t>(ComputeHash128(data, size).lo);
+}
+
+void PipelineDiskCache::Load() {
+    if (m_path.empty()) {
+        return;
+    }
+
+    // Other processes append to the file while it is mapped here
+    m_file = CreateFileA(m_path.c_str(), GENERIC_READ,
+                         FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        TRACE("No pipeline cache at \"%s\" yet", m_path.c_str());
+        return;
+    }
+
+    LARGE_INTEGER fileSize = {};
+    if (!GetFileSizeEx(m_file, &fileSize) ||
+        fileSize.QuadPart < static_cast<LONGLONG>(sizeof(FileHeader))) {
+        return;
+    }
+    m_mapping =
+        CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping) {
+        m_view = static_cast<const uint8_t*>(
+            MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (!m_view) {
+        WARN("Failed to map pipeline cache \"%s\", error %lu",
+             m_path.c_str(), GetLastError());
+        return;
+    }
+
+    UINT64 size = static_cast<UINT64>(fileSize.QuadPart);
+    FileHeader header;
+    memcpy(&header, m_view, sizeof(header));
+    if (header.magic != kMagic || header.version != kVersion) {
+        WARN("Discarding pipeline cache \"%s\", version %u", m_path.c_str(),
+             header.magic == kMagic ? header.version : 0);
+        return;
+    }
+
+    // Stops at the first torn or corrupt record, the rest is rewritten
+    UINT64 offset = sizeof(FileHeader);
+    while (size - offset >= sizeof(RecordHeader)) {
+        RecordHeader record;
+        memcpy(&record, m_view + offset, sizeof(record));
+        const uint8_t* data = m_view + offset + sizeof(record);
+        if (record.size > size - offset - sizeof(record) ||
+            Checksum(data, record.size) != record.checksum) {
+            WARN("Pipeline cache \"%s\" is truncated at %llu bytes",
+                 m_path.c_str(), offset);
+            break;
+        }
+        m_entries.emplace(record.key, Entry{data, record.size});
+        offset += sizeof(record) + record.size;
+    }
+    m_validSize = offset;
+}
+
+UINT64 PipelineDiskCache::FindAppendOffset(HANDLE file) {
+    LARGE_INTEGER fileSize = {};
+    FileHeader header;
+    if (!GetFileSizeEx(file, &fileSize) ||
+        !ReadFileAt(file, 0, &header, sizeof(header)) ||
+        header.magic != kMagic || header.version != kVersion) {
+        return 0;
+    }
+
+    // Records up to m_validSize were checked by Load and are never
+    // rewritten, only those other processes appended since need checking
+    UINT64 size = static_cast<UINT64>(fileSize.QuadPart);
+    UINT64 offset = m_validSize ? m_validSize : sizeof(FileHeader);
+    if (offset > size) {
+        offset = sizeof(FileHeader);
+    }
+    std::vector<uint8_t> data;
+    while (size - offset >= sizeof(RecordHeader)) {
+        RecordHeader record;
+        if (!ReadFileAt(file, offset, &record, sizeof(record)) ||
+            record.size > size - offset - sizeof(record)) {
+            break;
+        }
+        data.resize(record.size);
+        if (!ReadFileAt(file, offset + sizeof(record), data.data(),
+                        record.size) ||
+            Checksum(data.data(), data.size()) != record.checksum) {
+            break;
+        }
+        offset += sizeof(record) + record.size;
+    }
+    return offset;
+}
+
+void PipelineDiskCache::WriteNewEntries() {
+    if (m_path.empty() || m_newEntries.empty()) {
+        return;
+    }
+
+    HANDLE file = CreateFileA(m_path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        WARN("Failed to open pipeline cache \"%s\" for writing, error %lu",
+             m_path.c_str(), GetLastError());
+        return;
+    }
+
+    // Serializes writers, each appends after what the others wrote
+    OVERLAPPED lockRange = {};
+    if (!LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD,
+                    &lockRange)) {
+        WARN("Failed to lock pipeline cache \"%s\", error %lu",
+             m_path.c_str(), GetLastError());
+        CloseHandle(file);
+        return;
+    }
+
+    // Not truncated: other processes may have the file mapped, and Load
+    // stops at whatever torn bytes are left past the new records anyway
+    UINT64 end = FindAppendOffset(file);
+    std::vector<uint8_t> data;
+    if (!end) {
+        FileHeader header = {kMagic, kVersion};
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&header);
+        data.insert(data.end(), bytes, bytes + sizeof(header));
+    }
+    for (const auto& entry : m_newEntries) {
+        const std::vector<uint8_t>& desc = entry.second;
+        RecordHeader record = {entry.first, static_cast<uint32_t>(desc.size()),
+                               Checksum(desc.data(), desc.size())};
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&record);
+        data.insert(data.end(), bytes, bytes + sizeof(record));
+        data.insert(data.end(), desc.begin(), desc.end());
+    }
+
+    LARGE_INTEGER offset = {};
+    offset.QuadPart = static_cast<LONGLONG>(end);
+    DWORD written = 0;
+    if (!SetFilePointerEx(file, offset, nullptr, FILE_BEGIN) ||
+        !WriteFile(file, data.data(), static_cast<DWORD>(data.size()),
+                   &written, nullptr) ||
+        written != data.size()) {
+        WARN("Failed to write pipeline cache \"%s\", error %lu",
+             m_path.c_str(), GetLastError());
+    } else {
+        TRACE("Wrote %zu entries to pipeline cache \"%s\"",
+              m_newEntries.size(), m_path.c_str());
+    }
+    UnlockFileEx(file, 0, MAXDWORD, MAXDWORD, &lockRange);
+    CloseHandle(file);
+}
+
+bool PipelineDiskCache::Contains(const Hash128& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.count(key) != 0;
+}
+
+void PipelineDiskCache::Store(const Hash128& key, std::vector<uint8_t> desc) {
+    if (desc.size() > UINT32_MAX) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_entries.count(key)) {
+        return;
+    }
+    MemoryStats::Instance().Add(MemoryCategory::PipelineStateCache,
+                                desc.size());
+    m_newEntries.emplace_back(key, std::move(desc));
+    const std::vector<uint8_t>& stored = m_newEntries.back().second;
+    m_entries.emplace(
+        key, Entry{stored.data(), static_cast<uint32_t>(stored.size())});
+}
+
+HRESULT PipelineDiskCache::CreateBlob(const Hash128& key,
+                                      const std::vector<uint8_t>& desc,
+                                      ID3DBlob** ppBlob) {
+    if (!ppBlob) {
+        return E_POINTER;
+    }
+    *ppBlob = nullptr;
+    if (desc.size() > UINT32_MAX) {
+        return E_OUTOFMEMORY;
+    }
+
+    FileHeader header = {kMagic, kVersion};
+    RecordHeader record = {key, static_cast<uint32_t>(desc.size()),
+                           Checksum(desc.data(), desc.size())};
+    HRESULT hr = D3DCreateBlob(sizeof(header) + sizeof(record) + desc.size(),
+                               ppBlob);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    uint8_t* out = static_cast<uint8_t*>((*ppBlob)->GetBufferPointer());
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + sizeof(header), &record, sizeof(record));
+    memcpy(out + sizeof(header) + sizeof(record), desc.data(), desc.size());
+    return S_OK;
+}
+
+std::vector<std::unique_ptr<PipelineDescCopy>>
+PipelineDiskCache::GetLoadedDescs() {
+    std::vector<std::unique_ptr<PipelineDescCopy>> descs;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& [key, entry] : m_entries) {
+        // Entries stored this run are already in the pipeline state cache
+        bool loaded = m_view && entry.data >= m_view &&
+                      entry.data < m_view + m_validSize;
+        if (!loaded) {
+            continue;
+        }
+        std::unique_ptr<PipelineDescCopy> desc =
+            DeserializePipelineDesc(entry.data, entry.size);
+        if (!desc) {
+            WARN("Skipping unreadable pipeline cache entry");
+            continue;
+        }
+        descs.push_back(std::move(desc));
+    }
+    return descs;
+}
+
+}  // namespace dxiided
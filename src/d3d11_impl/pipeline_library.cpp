@@ -0,0 +1,495 @@
+#include "d3d11_impl/pipeline_library.hpp"
+
+#include <cstring>
+#include <cwchar>
+
+#include "common/memory_stats.hpp"
+#include "d3d11_impl/device.hpp"
+#include "d3d11_impl/pipeline_disk_cache.hpp"
+#include "d3d11_impl/pipeline_state.hpp"
+
+namespace dxiided {
+
+HRESULT WrappedD3D12ToD3D11PipelineLibrary::Create(
+    WrappedD3D12ToD3D11Device* device, const void* pLibraryBlob,
+    SIZE_T BlobLength, REFIID riid, void** ppPipelineLibrary) {
+    TRACE("WrappedD3D12ToD3D11PipelineLibrary::Create(%p, %p, %zu, %s, %p)",
+          device, pLibraryBlob, BlobLength, debugstr_guid(&riid).c_str(),
+          ppPipelineLibrary);
+
+    if (!device || !ppPipelineLibrary) {
+        return E_INVALIDARG;
+    }
+    *ppPipelineLibrary = nullptr;
+
+    Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineLibrary> library;
+    library.Attach(new WrappedD3D12ToD3D11PipelineLibrary(device));
+    HRESULT hr = library->Open(pLibraryBlob, BlobLength);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    return library->QueryInterface(riid, ppPipelineLibrary);
+}
+
+WrappedD3D12ToD3D11PipelineLibrary::WrappedD3D12ToD3D11PipelineLibrary(
+    WrappedD3D12ToD3D11Device* device)
+    : m_device(device) {}
+
+WrappedD3D12ToD3D11PipelineLibrary::~WrappedD3D12ToD3D11PipelineLibrary() {
+    TRACE("Pipeline library destroyed, %zu pipelines stored",
+          m_stored.size());
+    MemoryStats::Instance().Remove(MemoryCategory::PipelineStateCache,
+                                   m_recordBytes);
+}
+
+HRESULT WrappedD3D12ToD3D11PipelineLibrary::Open(const void* pLibraryBlob,
+                                                 SIZE_T BlobLength) {
+    if (!BlobLength) {
+        return S_OK;
+    }
+    if (!pLibraryBlob || BlobLength < sizeof(LibraryHeader)) {
+        return E_INVALIDARG;
+    }
+
+    LibraryHeader header;
+    memcpy(&header, pLibraryBlob, sizeof(header));
+    if (header.magic != kMagic) {
+        WARN("Not a pipeline library blob");
+        return E_INVALIDARG;
+    }
+    if (header.version != kVersion ||
+        header.descVersion != PipelineDiskCache::kVersion) {
+        WARN("Pipeline library version %u.%u, expected %u.%u",
+             header.version, header.descVersion, kVersion,
+             PipelineDiskCache::kVersion);
+        return D3D12_ERROR_DRIVER_VERSION_MISMATCH;
+    }
+
+    // Only the tables are checked here, entries are checked when used
+    UINT64 tablesSize =
+        sizeof(LibraryHeader) +
+        static_cast<UINT64>(header.entryCount) * sizeof(IndexEntry) +
+        static_cast<UINT64>(header.recordCount) * sizeof(RecordEntry);
+    if (tablesSize > BlobLength) {
+        WARN("Pipeline library blob is truncated");
+        return E_INVALIDARG;
+    }
+
+    m_blob = static_cast<const uint8_t*>(pLibraryBlob);
+    m_blobSize = BlobLength;
+    m_blobEntries = header.entryCount;
+    m_blobRecords = header.recordCount;
+    TRACE("Opened pipeline library, %u pipelines in %u records",
+          m_blobEntries, m_blobRecords);
+    return S_OK;
+}
+
+WrappedD3D12ToD3D11PipelineLibrary::IndexEntry
+WrappedD3D12ToD3D11PipelineLibrary::GetIndexEntry(uint32_t index) const {
+    IndexEntry entry;
+    memcpy(&entry,
+           m_blob + sizeof(LibraryHeader) + index * sizeof(IndexEntry),
+           sizeof(entry));
+    return entry;
+}
+
+bool WrappedD3D12ToD3D11PipelineLibrary::GetRecordEntry(
+    uint32_t index, RecordEntry* record) const {
+    if (index >= m_blobRecords) {
+        return false;
+    }
+    memcpy(record,
+           m_blob + sizeof(LibraryHeader) +
+               m_blobEntries * sizeof(IndexEntry) +
+               index * sizeof(RecordEntry),
+           sizeof(*record));
+    return static_cast<UINT64>(record->offset) + record->size <= m_blobSize;
+}
+
+bool WrappedD3D12ToD3D11PipelineLibrary::GetEntryName(
+    const IndexEntry& entry, std::wstring* name) const {
+    UINT64 size = static_cast<UINT64>(entry.nameLength) * sizeof(WCHAR);
+    if (entry.nameOffset + size > m_blobSize) {
+        return false;
+    }
+    name->resize(entry.nameLength);
+    memcpy(&(*name)[0], m_blob + entry.nameOffset, size);
+    return true;
+}
+
+void WrappedD3D12ToD3D11PipelineLibrary::SizeBlobLocked() {
+    if (m_blobSized) {
+        return;
+    }
+    m_blobSized = true;
+
+    // Counts the entries the way BuildBlobLocked lays them out
+    std::wstring name;
+    for (uint32_t i = 0; i < m_blobEntries; ++i) {
+        IndexEntry entry = GetIndexEntry(i);
+        RecordEntry record;
+        if (!GetEntryName(entry, &name) ||
+            !GetRecordEntry(entry.record, &record)) {
+            continue;
+        }
+        m_serializedSize +=
+            sizeof(IndexEntry) + entry.nameLength * sizeof(WCHAR);
+        if (m_serializedKeys.insert(record.key).second) {
+            m_serializedSize += sizeof(RecordEntry) + record.size;
+        }
+    }
+}
+
+bool WrappedD3D12ToD3D11PipelineLibrary::FindInBlob(LPCWSTR pName,
+                                                    RecordRef* found) const {
+    // The index is sorted by name, so this only touches log2(n) entries
+    size_t length = wcslen(pName);
+    uint32_t first = 0;
+    uint32_t last = m_blobEntries;
+    std::wstring name;
+    while (first < last) {
+        uint32_t middle = first + (last - first) / 2;
+        IndexEntry entry = GetIndexEntry(middle);
+        if (!GetEntryName(entry, &name)) {
+            WARN("Pipeline library entry %u is out of bounds", middle);
+            return false;
+        }
+
+        int order = name.compare(0, name.size(), pName, length);
+        if (order < 0) {
+            first = middle + 1;
+        } else if (order > 0) {
+            last = middle;
+        } else {
+            RecordEntry record;
+            if (!GetRecordEntry(entry.record, &record)) {
+                WARN("Pipeline library record %u is out of bounds",
+                     entry.record);
+                return false;
+            }
+            *found = {record.key, m_blob + record.offset, record.size};
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WrappedD3D12ToD3D11PipelineLibrary::FindLocked(LPCWSTR pName,
+                                                    RecordRef* found) const {
+    auto it = m_stored.find(pName);
+    if (it != m_stored.end()) {
+        const std::vector<uint8_t>& desc = m_records.at(it->second);
+        *found = {it->second, desc.data(),
+                  static_cast<uint32_t>(desc.size())};
+        return true;
+    }
+    return FindInBlob(pName, found);
+}
+
+HRESULT WrappedD3D12ToD3D11PipelineLibrary::LoadPipeline(
+    const RecordRef& record, REFIID riid, void** ppPipelineState) {
+    // Loaded before, or created from the same desc outside the library
+    Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState> state =
+        m_device->GetPipelineStateCache()->Find({record.key});
+    if (state) {
+        return state.CopyTo(
+            reinterpret_cast<ID3D12PipelineState**>(ppPipelineState));
+    }
+
+    std::unique_ptr<PipelineDescCopy> desc =
+        DeserializePipelineDesc(record.data, record.size);
+    if (!desc) {
+        WARN("Pipeline library record is unreadable");
+        return E_INVALIDARG;
+    }
+    if (desc->IsCompute()) {
+        return WrappedD3D12ToD3D11PipelineState::CreateCompute(
+            m_device, desc->Compute(), riid, ppPipelineState);
+    }
+    return WrappedD3D12ToD3D11PipelineState::CreateGraphics(
+        m_device, desc->Graphics(), riid, ppPipelineState);
+}
+
+std::vector<uint8_t> WrappedD3D12ToD3D11PipelineLibrary::BuildBlobLocked()
+    const {
+    // Every name from the blob and since, in index order
+    std::map<std::wstring, RecordRef> names;
+    std::wstring name;
+    for (uint32_t i = 0; i < m_blobEntries; ++i) {
+        IndexEntry entry = GetIndexEntry(i);
+        RecordEntry record;
+        if (!GetEntryName(entry, &name) ||
+            !GetRecordEntry(entry.record, &record)) {
+            WARN("Dropping pipeline library entry %u, out of bounds", i);
+            continue;
+        }
+        names.emplace(name, RecordRef{record.key, m_blob + record.offset,
+                                      record.size});
+    }
+    for (const auto& [storedName, key] : m_stored) {
+        const std::vector<uint8_t>& desc = m_records.at(key);
+        names.emplace(storedName,
+                      RecordRef{key, desc.data(),
+                                static_cast<uint32_t>(desc.size())});
+    }
+
+    // One record per distinct state
+    std::vector<const RecordRef*> records;
+    std::unordered_map<Hash128, uint32_t, Hash128Hasher> recordIndex;
+    UINT64 namesSize = 0;
+    for (const auto& [entryName, source] : names) {
+        namesSize += entryName.size() * sizeof(WCHAR);
+        if (recordIndex.emplace(source.key, records.size()).second) {
+            records.push_back(&source);
+        }
+    }
+
+    UINT64 namesOffset =
+        sizeof(LibraryHeader) + names.size() * sizeof(IndexEntry) +
+        records.size() * sizeof(RecordEntry);
+    UINT64 dataOffset = namesOffset + namesSize;
+    UINT64 size = dataOffset;
+    for (const RecordRef* record : records) {
+        size += record->size;
+    }
+    if (size > UINT32_MAX) {
+        ERR("Pipeline library of %llu bytes is too large to serialize", size);
+        return {};
+    }
+
+    std::vector<uint8_t> blob(size);
+    LibraryHeader header = {kMagic,
+                            kVersion,
+                            PipelineDiskCache::kVersion,
+                            static_cast<uint32_t>(names.size()),
+                            static_cast<uint32_t>(records.size()),
+                            0};
+    memcpy(blob.data(), &header, sizeof(header));
+
+    uint8_t* index = blob.data() + sizeof(LibraryHeader);
+    uint32_t nameOffset = static_cast<uint32_t>(namesOffset);
+    for (const auto& [entryName, source] : names) {
+        IndexEntry entry = {nameOffset,
+                            static_cast<uint32_t>(entryName.size()),
+                            recordIndex.at(source.key), 0};
+        memcpy(index, &entry, sizeof(entry));
+        index += sizeof(entry);
+        memcpy(blob.data() + nameOffset, entryName.data(),
+               entryName.size() * sizeof(WCHAR));
+        nameOffset += static_cast<uint32_t>(entryName.size() * sizeof(WCHAR));
+    }
+
+    uint8_t* table = index;
+    uint32_t recordOffset = static_cast<uint32_t>(dataOffset);
+    for (const RecordRef* source : records) {
+        RecordEntry record = {source->key, recordOffset, source->size};
+        memcpy(table, &record, sizeof(record));
+        table += sizeof(record);
+        memcpy(blob.data() + recordOffset, source->data, source->size);
+        recordOffset += source->size;
+    }
+    return blob;
+}
+
+// IUnknown methods
+HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11PipelineLibrary::QueryInterface(
+    REFIID riid, void** ppvObject) {
+    TRACE("WrappedD3D12ToD3D11PipelineLibrary::QueryInterface called: %s, %p",
+          debugstr_guid(&riid).c_str(), ppvObject);
+
+    if (!ppvObject) {
+        return E_POINTER;
+    }
+
+    if (riid == __uuidof(ID3D12PipelineLibrary) ||
+        riid == __uuidof(ID3D12DeviceChild) ||
+        riid == __uuidof(ID3D12Object) || riid == __uuidof(IUnknown)) {
+        AddRef();
+        *ppvObject = this;
+        return S_OK;
+    }
+
+    WARN("WrappedD3D12ToD3D11PipelineLibrary::QueryInterface: Unknown "
+         "interface query %s",
+         debugstr_guid(&riid).c_str());
+    *ppvObject = nullptr;
+    return E_NOINTERFACE;
+}
+
+ULONG STDMETHODCALLTYPE WrappedD3D12ToD3D11PipelineLibrary::AddRef() {
+    return m_refCount.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+ULONG STDMETHODCALLTYPE WrappedD3D12ToD3D11PipelineLibrary::Release() {
+    ULONG ref = m_refCount.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    if (ref == 0) {
+        delete this;
+    }
+    return ref;
+}
+
+// ID3D12Object methods
+HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11PipelineLibrary::GetPrivateData(
+    REFGUID guid, UINT* pDataSize, void* pData) {
+    FIXME("WrappedD3D12ToD3D11PipelineLibrary::GetPrivateData not "
+          "implemented");
+    return E_NOTIMPL;
+}
+
+HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11PipelineLibrary::SetPrivateData(
+    REFGUID guid, UINT DataSize, const void* pData) {
+    FIXME("WrappedD3D12ToD3D11PipelineLibrary::SetPrivateData not "
+          "implemented");
+    return E_NOTIMPL;
+}
+
+HRESULT STDMETHODCALLTYPE
+WrappedD3D12ToD3D11PipelineLibrary::SetPrivateDataInterface(
+    REFGUID guid, const IUnknown* pData) {
+    FIXME("WrappedD3D12ToD3D11PipelineLibrary::SetPrivateDataInterface not "
+          "implemented");
+    return E_NOTIMPL;
+}
+
+HRESULT STDMETHODCALLTYPE
+WrappedD3D12ToD3D11PipelineLibrary::SetName(LPCWSTR Name) {
+    TRACE("WrappedD3D12ToD3D11PipelineLibrary::SetName %ls", Name);
+    return S_OK;
+}
+
+// ID3D12DeviceChild methods
+HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11PipelineLibrary::GetDevice(
+    REFIID riid, void** ppvDevice) {
+    TRACE("WrappedD3D12ToD3D11PipelineLibrary::GetDevice %s, %p",
+          debugstr_guid(&riid).c_str(), ppvDevice);
+    return m_device->QueryInterface(riid, ppvDevice);
+}
+
+// ID3D12PipelineLibrary methods
+HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11PipelineLibrary::StorePipeline(
+    LPCWSTR pName, ID3D12PipelineState* pPipeline) {
+    TRACE("WrappedD3D12ToD3D11PipelineLibrary::StorePipeline %ls, %p",
+          pName ? pName : L"(null)", pPipeline);
+
+    if (!pName || !pPipeline) {
+        return E_INVALIDARG;
+    }
+
+    // Compiles a deferred state first, so do it outside the lock
+    auto* state = static_cast<WrappedD3D12ToD3D11PipelineState*>(pPipeline);
+    std::vector<uint8_t> desc;
+    HRESULT hr = state->GetSerializedDesc(&desc);
+    if (FAILED(hr)) {
+        WARN("No desc for pipeline state %p, hr %#x", pPipeline, hr);
+        return hr;
+    }
+    Hash128 key = state->GetKey().hash;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    RecordRef existing;
+    if (FindLocked(pName, &existing)) {
+        WARN("Pipeline %ls is already in the library", pName);
+        return E_INVALIDARG;
+    }
+
+    SizeBlobLocked();
+    m_stored.emplace(pName, key);
+    m_serializedSize += sizeof(IndexEntry) + wcslen(pName) * sizeof(WCHAR);
+    if (m_serializedKeys.insert(key).second) {
+        m_serializedSize += sizeof(RecordEntry) + desc.size();
+    }
+    if (!m_records.count(key)) {
+        m_recordBytes += desc.size();
+        MemoryStats::Instance().Add(MemoryCategory::PipelineStateCache,
+                                    desc.size());
+        m_records.emplace(key, std::move(desc));
+    }
+    return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE
+WrappedD3D12ToD3D11PipelineLibrary::LoadGraphicsPipeline(
+    LPCWSTR pName, const D3D12_GRAPHICS_PIPELINE_STATE_DESC* pDesc,
+    REFIID riid, void** ppPipelineState) {
+    TRACE("WrappedD3D12ToD3D11PipelineLibrary::LoadGraphicsPipeline %ls, "
+          "%p, %s, %p",
+          pName ? pName : L"(null)", pDesc, debugstr_guid(&riid).c_str(),
+          ppPipelineState);
+
+    if (!pName || !pDesc) {
+        return E_INVALIDARG;
+    }
+
+    RecordRef record;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!FindLocked(pName, &record)) {
+            return E_INVALIDARG;
+        }
+    }
+
+    // D3D12 requires the desc the pipeline was stored with
+    if (WrappedD3D12ToD3D11PipelineState::ComputeHash(pDesc).hash !=
+        record.key) {
+        WARN("Pipeline %ls was stored with a different desc", pName);
+        return E_INVALIDARG;
+    }
+    return LoadPipeline(record, riid, ppPipelineState);
+}
+
+HRESULT STDMETHODCALLTYPE
+WrappedD3D12ToD3D11PipelineLibrary::LoadComputePipeline(
+    LPCWSTR pName, const D3D12_COMPUTE_PIPELINE_STATE_DESC* pDesc,
+    REFIID riid, void** ppPipelineState) {
+    TRACE("WrappedD3D12ToD3D11PipelineLibrary::LoadComputePipeline %ls, "
+          "%p, %s, %p",
+          pName ? pName : L"(null)", pDesc, debugstr_guid(&riid).c_str(),
+          ppPipelineState);
+
+    if (!pName || !pDesc) {
+        return E_INVALIDARG;
+    }
+
+    RecordRef record;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!FindLocked(pName, &record)) {
+            return E_INVALIDARG;
+        }
+    }
+
+    if (WrappedD3D12ToD3D11PipelineState::ComputeHash(pDesc).hash !=
+        record.key) {
+        WARN("Pipeline %ls was stored with a different desc", pName);
+        return E_INVALIDARG;
+    }
+    return LoadPipeline(record, riid, ppPipelineState);
+}
+
+SIZE_T STDMETHODCALLTYPE
+WrappedD3D12ToD3D11PipelineLibrary::GetSerializedSize() {
+    TRACE("WrappedD3D12ToD3D11PipelineLibrary::GetSerializedSize");
+    std::lock_guard<std::mutex> lock(m_mutex);
+    SizeBlobLocked();
+    // Serialize fails the same way for a library this large
+    return m_serializedSize > UINT32_MAX ? 0 : m_serializedSize;
+}
+
+HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11PipelineLibrary::Serialize(
+    void* pData, SIZE_T DataSizeInBytes) {
+    TRACE("WrappedD3D12ToD3D11PipelineLibrary::Serialize %p, %zu", pData,
+          DataSizeInBytes);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<uint8_t> blob = BuildBlobLocked();
+    if (blob.empty()) {
+        return E_OUTOFMEMORY;
+    }
+    if (!pData || DataSizeInBytes < blob.size()) {
+        return E_INVALIDARG;
+    }
+    memcpy(pData, blob.data(), blob.size());
+    return S_OK;
+}
+
+}  // namespace dxiided
@@ -1,14 +1,120 @@
 #include "d3d11_impl/pipeline_state.hpp"
+
+#include "common/config.hpp"
+#include "common/memory_stats.hpp"
 #include "d3d11_impl/device.hpp"
 
 namespace dxiided {
 
 // Static member initialization
-std::unordered_map<WrappedD3D12ToD3D11PipelineState::PipelineStateKey,
-                  Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState>,
-                  WrappedD3D12ToD3D11PipelineState::PipelineStateKeyHasher>
-    WrappedD3D12ToD3D11PipelineState::s_pipelineStateCache;
-std::mutex WrappedD3D12ToD3D11PipelineState::s_cacheMutex;
+std::atomic<UINT64> WrappedD3D12ToD3D11PipelineState::s_nextId{1};
+
+namespace {
+
+// Graphics and compute states share the cache
+enum class PipelineKind : uint32_t { Graphics, Compute };
+
+// The hash helpers below feed in fields one by one, struct padding in
+// application descs isn't guaranteed to be zeroed
+
+void HashShader(Hasher128& hasher, const D3D12_SHADER_BYTECODE& shader) {
+    SIZE_T length = shader.pShaderBytecode ? shader.BytecodeLength : 0;
+    hasher.UpdateValue(length);
+    if (length) {
+        hasher.Update(shader.pShaderBytecode, length);
+    }
+}
+
+void HashStreamOutput(Hasher128& hasher, const D3D12_STREAM_OUTPUT_DESC& so) {
+    UINT numEntries = so.pSODeclaration ? so.NumEntries : 0;
+    hasher.UpdateValue(numEntries);
+    for (UINT i = 0; i < numEntries; i++) {
+        const D3D12_SO_DECLARATION_ENTRY& entry = so.pSODeclaration[i];
+        hasher.UpdateValue(entry.Stream);
+        hasher.UpdateString(entry.SemanticName);
+        hasher.UpdateValue(entry.SemanticIndex);
+        hasher.UpdateValue(entry.StartComponent);
+        hasher.UpdateValue(entry.ComponentCount);
+        hasher.UpdateValue(entry.OutputSlot);
+    }
+    UINT numStrides = so.pBufferStrides ? so.NumStrides : 0;
+    hasher.UpdateValue(numStrides);
+    if (numStrides) {
+        hasher.Update(so.pBufferStrides, numStrides * sizeof(UINT));
+    }
+    hasher.UpdateValue(so.RasterizedStream);
+}
+
+void HashBlendState(Hasher128& hasher, const D3D12_BLEND_DESC& blend) {
+    hasher.UpdateValue(blend.AlphaToCoverageEnable);
+    hasher.UpdateValue(blend.IndependentBlendEnable);
+    for (const D3D12_RENDER_TARGET_BLEND_DESC& rt : blend.RenderTarget) {
+        hasher.UpdateValue(rt.BlendEnable);
+        hasher.UpdateValue(rt.LogicOpEnable);
+        hasher.UpdateValue(rt.SrcBlend);
+        hasher.UpdateValue(rt.DestBlend);
+        hasher.UpdateValue(rt.BlendOp);
+        hasher.UpdateValue(rt.SrcBlendAlpha);
+        hasher.UpdateValue(rt.DestBlendAlpha);
+        hasher.UpdateValue(rt.BlendOpAlpha);
+        hasher.UpdateValue(rt.LogicOp);
+        hasher.UpdateValue(rt.RenderTargetWriteMask);
+    }
+}
+
+void HashRasterizerState(Hasher128& hasher,
+                         const D3D12_RASTERIZER_DESC& rasterizer) {
+    hasher.UpdateValue(rasterizer.FillMode);
+    hasher.UpdateValue(rasterizer.CullMode);
+    hasher.UpdateValue(rasterizer.FrontCounterClockwise);
+    hasher.UpdateValue(rasterizer.DepthBias);
+    hasher.UpdateValue(rasterizer.DepthBiasClamp);
+    hasher.UpdateValue(rasterizer.SlopeScaledDepthBias);
+    hasher.UpdateValue(rasterizer.DepthClipEnable);
+    hasher.UpdateValue(rasterizer.MultisampleEnable);
+    hasher.UpdateValue(rasterizer.AntialiasedLineEnable);
+    hasher.UpdateValue(rasterizer.ForcedSampleCount);
+    hasher.UpdateValue(rasterizer.ConservativeRaster);
+}
+
+void HashStencilOp(Hasher128& hasher, const D3D12_DEPTH_STENCILOP_DESC& op) {
+    hasher.UpdateValue(op.StencilFailOp);
+    hasher.UpdateValue(op.StencilDepthFailOp);
+    hasher.UpdateValue(op.StencilPassOp);
+    hasher.UpdateValue(op.StencilFunc);
+}
+
+void HashDepthStencilState(Hasher128& hasher,
+                           const D3D12_DEPTH_STENCIL_DESC& depthStencil) {
+    hasher.UpdateValue(depthStencil.DepthEnable);
+    hasher.UpdateValue(depthStencil.DepthWriteMask);
+    hasher.UpdateValue(depthStencil.DepthFunc);
+    hasher.UpdateValue(depthStencil.StencilEnable);
+    hasher.UpdateValue(depthStencil.StencilReadMask);
+    hasher.UpdateValue(depthStencil.StencilWriteMask);
+    HashStencilOp(hasher, depthStencil.FrontFace);
+    HashStencilOp(hasher, depthStencil.BackFace);
+}
+
+void HashInputLayout(Hasher128& hasher,
+                     const D3D12_INPUT_LAYOUT_DESC& inputLayout) {
+    UINT numElements =
+        inputLayout.pInputElementDescs ? inputLayout.NumElements : 0;
+    hasher.UpdateValue(numElements);
+    for (UINT i = 0; i < numElements; i++) {
+        const D3D12_INPUT_ELEMENT_DESC& element =
+            inputLayout.pInputElementDescs[i];
+        hasher.UpdateString(element.SemanticName);
+        hasher.UpdateValue(element.SemanticIndex);
+        hasher.UpdateValue(element.Format);
+        hasher.UpdateValue(element.InputSlot);
+        hasher.UpdateValue(element.AlignedByteOffset);
+        hasher.UpdateValue(element.InputSlotClass);
+        hasher.UpdateValue(element.InstanceDataStepRate);
+    }
+}
+
+}  // namespace
 
 HRESULT WrappedD3D12ToD3D11PipelineState::CreateGraphics(
     WrappedD3D12ToD3D11Device* device, const D3D12_GRAPHICS_PIPELINE_STATE_DESC* pDesc,
@@ -23,7 +129,7 @@ HRESULT WrappedD3D12ToD3D11PipelineState::CreateGraphics(
     // Try to find cached state
     PipelineStateKey key = ComputeHash(pDesc);
     Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState> cachedState =
-        GetCachedState(key);
+        device->GetPipelineStateCache()->Find(key);
     if (cachedState) {
         return cachedState.CopyTo(
             reinterpret_cast<ID3D12PipelineState**>(ppPipelineState));
@@ -32,13 +138,20 @@ HRESULT WrappedD3D12ToD3D11PipelineState::CreateGraphics(
     // Create new state
     Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState> state =
         new WrappedD3D12ToD3D11PipelineState(device);
-    HRESULT hr = state->InitializeGraphics(pDesc);
-    if (FAILED(hr)) {
-        return hr;
+    state->m_key = key;
+    if (Config::Instance().AsyncPipelineCompile()) {
+        state->DeferCompile(std::make_unique<PipelineDescCopy>(*pDesc));
+    } else {
+        HRESULT hr = state->InitializeGraphics(pDesc);
+        if (FAILED(hr)) {
+            return hr;
+        }
+        state->StoreCachedBlob(*pDesc);
+        state->m_desc = std::make_unique<PipelineDescCopy>(*pDesc);
     }
 
     // Cache the new state
-    CacheState(key, state);
+    device->GetPipelineStateCache()->Insert(key, state);
 
     return state.CopyTo(
         reinterpret_cast<ID3D12PipelineState**>(ppPipelineState));
@@ -57,7 +170,7 @@ HRESULT WrappedD3D12ToD3D11PipelineState::CreateCompute(
     // Try to find cached state
     PipelineStateKey key = ComputeHash(pDesc);
     Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState> cachedState =
-        GetCachedState(key);
+        device->GetPipelineStateCache()->Find(key);
     if (cachedState) {
         return cachedState.CopyTo(
             reinterpret_cast<ID3D12PipelineState**>(ppPipelineState));
@@ -66,106 +179,159 @@ HRESULT WrappedD3D12ToD3D11PipelineState::CreateCompute(
     // Create new state
     Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState> state =
         new WrappedD3D12ToD3D11PipelineState(device);
-    HRESULT hr = state->InitializeCompute(pDesc);
-    if (FAILED(hr)) {
-        return hr;
+    state->m_key = key;
+    if (Config::Instance().AsyncPipelineCompile()) {
+        state->DeferCompile(std::make_unique<PipelineDescCopy>(*pDesc));
+    } else {
+        HRESULT hr = state->InitializeCompute(pDesc);
+        if (FAILED(hr)) {
+            return hr;
+        }
+        state->StoreCachedBlob(*pDesc);
+        state->m_desc = std::make_unique<PipelineDescCopy>(*pDesc);
     }
 
     // Cache the new state
-    CacheState(key, state);
+    device->GetPipelineStateCache()->Insert(key, state);
 
     return state.CopyTo(
         reinterpret_cast<ID3D12PipelineState**>(ppPipelineState));
 }
 
-Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState>
-WrappedD3D12ToD3D11PipelineState::GetCachedState(const PipelineStateKey& key) {
-    TRACE("WrappedD3D12ToD3D11PipelineState::GetCachedState");
-    std::lock_guard<std::mutex> lock(s_cacheMutex);
-    auto it = s_pipelineStateCache.find(key);
-    if (it != s_pipelineStateCache.end()) {
-        return it->second;
+void WrappedD3D12ToD3D11PipelineState::Prewarm(
+    WrappedD3D12ToD3D11Device* device,
+    std::unique_ptr<PipelineDescCopy> desc) {
+    PipelineStateKey key = desc->IsCompute() ? ComputeHash(desc->Compute())
+                                             : ComputeHash(desc->Graphics());
+    if (device->GetPipelineStateCache()->Find(key)) {
+        return;
     }
-    return nullptr;
-}
 
-void WrappedD3D12ToD3D11PipelineState::CacheState(
-    const PipelineStateKey& key,
-    Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState> state) {
-        TRACE("WrappedD3D12ToD3D11PipelineState::CacheState");
-    std::lock_guard<std::mutex> lock(s_cacheMutex);
-    s_pipelineStateCache[key] = state;
+    Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState> state =
+        new WrappedD3D12ToD3D11PipelineState(device);
+    state->m_key = key;
+    state->DeferCompile(std::move(desc));
+    device->GetPipelineStateCache()->Insert(key, state);
 }
 
 WrappedD3D12ToD3D11PipelineState::PipelineStateKey
 WrappedD3D12ToD3D11PipelineState::ComputeHash(
     const D3D12_GRAPHICS_PIPELINE_STATE_DESC* pDesc) {
-        TRACE("WrappedD3D12ToD3D11PipelineState::ComputeHash");
-    PipelineStateKey key;
-
-    // Add all relevant fields to the hash
-    key.hash.insert(
-        key.hash.end(), reinterpret_cast<const uint8_t*>(&pDesc->VS),
-        reinterpret_cast<const uint8_t*>(&pDesc->VS) + sizeof(pDesc->VS));
-    key.hash.insert(
-        key.hash.end(), reinterpret_cast<const uint8_t*>(&pDesc->PS),
-        reinterpret_cast<const uint8_t*>(&pDesc->PS) + sizeof(pDesc->PS));
-    key.hash.insert(
-        key.hash.end(), reinterpret_cast<const uint8_t*>(&pDesc->DS),
-        reinterpret_cast<const uint8_t*>(&pDesc->DS) + sizeof(pDesc->DS));
-    key.hash.insert(
-        key.hash.end(), reinterpret_cast<const uint8_t*>(&pDesc->HS),
-        reinterpret_cast<const uint8_t*>(&pDesc->HS) + sizeof(pDesc->HS));
-    key.hash.insert(
-        key.hash.end(), reinterpret_cast<const uint8_t*>(&pDesc->GS),
-        reinterpret_cast<const uint8_t*>(&pDesc->GS) + sizeof(pDesc->GS));
-
-    // Add input layout
-    for (UINT i = 0; i < pDesc->InputLayout.NumElements; i++) {
-        const auto& element = pDesc->InputLayout.pInputElementDescs[i];
-        key.hash.insert(
-            key.hash.end(), reinterpret_cast<const uint8_t*>(&element),
-            reinterpret_cast<const uint8_t*>(&element) + sizeof(element));
-    }
-
-    // Add other state objects
-    key.hash.insert(key.hash.end(),
-                    reinterpret_cast<const uint8_t*>(&pDesc->BlendState),
-                    reinterpret_cast<const uint8_t*>(&pDesc->BlendState) +
-                        sizeof(pDesc->BlendState));
-    key.hash.insert(key.hash.end(),
-                    reinterpret_cast<const uint8_t*>(&pDesc->RasterizerState),
-                    reinterpret_cast<const uint8_t*>(&pDesc->RasterizerState) +
-                        sizeof(pDesc->RasterizerState));
-    key.hash.insert(
-        key.hash.end(),
-        reinterpret_cast<const uint8_t*>(&pDesc->DepthStencilState),
-        reinterpret_cast<const uint8_t*>(&pDesc->DepthStencilState) +
-            sizeof(pDesc->DepthStencilState));
-
-    return key;
+    TRACE("WrappedD3D12ToD3D11PipelineState::ComputeHash");
+    Hasher128 hasher;
+    hasher.UpdateValue(PipelineKind::Graphics);
+    HashShader(hasher, pDesc->VS);
+    HashShader(hasher, pDesc->PS);
+    HashShader(hasher, pDesc->DS);
+    HashShader(hasher, pDesc->HS);
+    HashShader(hasher, pDesc->GS);
+    HashStreamOutput(hasher, pDesc->StreamOutput);
+    HashBlendState(hasher, pDesc->BlendState);
+    hasher.UpdateValue(pDesc->SampleMask);
+    HashRasterizerState(hasher, pDesc->RasterizerState);
+    HashDepthStencilState(hasher, pDesc->DepthStencilState);
+    HashInputLayout(hasher, pDesc->InputLayout);
+    hasher.UpdateValue(pDesc->IBStripCutValue);
+    hasher.UpdateValue(pDesc->PrimitiveTopologyType);
+    hasher.UpdateValue(pDesc->NumRenderTargets);
+    hasher.UpdateValue(pDesc->RTVFormats);
+    hasher.UpdateValue(pDesc->DSVFormat);
+    hasher.UpdateValue(pDesc->SampleDesc.Count);
+    hasher.UpdateValue(pDesc->SampleDesc.Quality);
+    hasher.UpdateValue(pDesc->Flags);
+    return {hasher.Finalize()};
 }
 
 WrappedD3D12ToD3D11PipelineState::PipelineStateKey
 WrappedD3D12ToD3D11PipelineState::ComputeHash(
     const D3D12_COMPUTE_PIPELINE_STATE_DESC* pDesc) {
     TRACE("WrappedD3D12ToD3D11PipelineState::ComputeHash");
-    PipelineStateKey key;
-
-    // For compute pipeline, we only need to hash the compute shader
-    key.hash.insert(
-        key.hash.end(), reinterpret_cast<const uint8_t*>(&pDesc->CS),
-        reinterpret_cast<const uint8_t*>(&pDesc->CS) + sizeof(pDesc->CS));
-
-    return key;
+    Hasher128 hasher;
+    hasher.UpdateValue(PipelineKind::Compute);
+    HashShader(hasher, pDesc->CS);
+    hasher.UpdateValue(pDesc->Flags);
+    return {hasher.Finalize()};
 }
 
 WrappedD3D12ToD3D11PipelineState::WrappedD3D12ToD3D11PipelineState(
     WrappedD3D12ToD3D11Device* device)
-    : m_device(device) {
+    : m_device(device), m_id(s_nextId.fetch_add(1)) {
     TRACE("WrappedD3D12ToD3D11PipelineState::WrappedD3D12ToD3D11PipelineState %p", device);
 }
 
+void WrappedD3D12ToD3D11PipelineState::DeferCompile(
+    std::unique_ptr<PipelineDescCopy> desc) {
+    m_desc = std::move(desc);
+    m_compileStatus = CompileStatus::Pending;
+    m_compiled.store(false);
+    m_device->GetPipelineCompiler()->Enqueue(this);
+}
+
+HRESULT WrappedD3D12ToD3D11PipelineState::Compile() {
+    std::unique_lock<std::mutex> lock(m_compileMutex);
+    if (m_compileStatus == CompileStatus::Compiling) {
+        m_compileCv.wait(lock, [this] {
+            return m_compileStatus == CompileStatus::Done;
+        });
+    }
+    if (m_compileStatus == CompileStatus::Done) {
+        return m_compileResult;
+    }
+
+    m_compileStatus = CompileStatus::Compiling;
+    lock.unlock();
+
+    HRESULT hr = S_OK;
+    if (m_desc->IsCompute()) {
+        hr = InitializeCompute(m_desc->Compute());
+        if (SUCCEEDED(hr)) {
+            StoreCachedBlob(*m_desc->Compute());
+        }
+    } else {
+        hr = InitializeGraphics(m_desc->Graphics());
+        if (SUCCEEDED(hr)) {
+            StoreCachedBlob(*m_desc->Graphics());
+        }
+    }
+    if (FAILED(hr)) {
+        // Too late to fail the create call, the state binds nothing
+        ERR("Deferred compile of pipeline state %p failed, hr %#x", this, hr);
+    }
+
+    lock.lock();
+    m_compileResult = hr;
+    m_compileStatus = CompileStatus::Done;
+    m_compiled.store(true);
+    m_compileCv.notify_all();
+    return hr;
+}
+
+template <typename Desc>
+void WrappedD3D12ToD3D11PipelineState::StoreCachedBlob(const Desc& desc) {
+    PipelineDiskCache* cache = m_device->GetPipelineDiskCache();
+    if (cache->IsPersistent() && !cache->Contains(m_key.hash)) {
+        cache->Store(m_key.hash, SerializePipelineDesc(desc));
+    }
+}
+
+template <typename T>
+HRESULT WrappedD3D12ToD3D11PipelineState::CreateShader(
+    ShaderStage stage, const D3D12_SHADER_BYTECODE& bytecode,
+    Microsoft::WRL::ComPtr<T>& shader,
+    std::shared_ptr<const ShaderModule>* created) {
+    std::shared_ptr<const ShaderModule> module;
+    HRESULT hr = m_device->GetShaderModuleCache()->GetOrCreate(
+        stage, bytecode.pShaderBytecode, bytecode.BytecodeLength, &module);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    shader = module->As<T>();
+    if (created) {
+        *created = std::move(module);
+    }
+    return S_OK;
+}
+
 HRESULT WrappedD3D12ToD3D11PipelineState::InitializeGraphics(
     const D3D12_GRAPHICS_PIPELINE_STATE_DESC* pDesc) {
     TRACE("Initializing graphics pipeline state");
@@ -211,9 +377,8 @@ HRESULT WrappedD3D12ToD3D11PipelineState::InitializeGraphics(
         return E_FAIL;
     }
     // Create vertex shader
+    std::shared_ptr<const ShaderModule> vertexModule;
     if (pDesc->VS.pShaderBytecode && pDesc->VS.BytecodeLength) {
-        TRACE("Creating vertex shader with bytecode length %zu", pDesc->VS.BytecodeLength);
-        
         // Special case: Some applications pass very small bytecode lengths
         if (pDesc->VS.BytecodeLength < 4) {
             WARN("Vertex shader bytecode length too small: %zu bytes. Treating as null shader.", 
@@ -222,43 +387,15 @@ HRESULT WrappedD3D12ToD3D11PipelineState::InitializeGraphics(
             return S_OK;
         }
 
-        // Validate minimum shader bytecode size for DXBC header
-        if (pDesc->VS.BytecodeLength < 20) {  // DXBC header is at least 20 bytes
-            ERR("Invalid vertex shader: Bytecode length %zu bytes is too small for DXBC header (minimum 20 bytes)", 
-                pDesc->VS.BytecodeLength);
-            return E_INVALIDARG;
-        }
-
-        // Validate DXBC signature and version
-        const uint32_t* dwordData = static_cast<const uint32_t*>(pDesc->VS.pShaderBytecode);
-        const uint8_t* byteData = static_cast<const uint8_t*>(pDesc->VS.pShaderBytecode);
-        
-        // Check for DXBC signature
-        if (byteData[0] != 'D' || byteData[1] != 'X' || byteData[2] != 'B' || byteData[3] != 'C') {
-            ERR("Invalid vertex shader: Missing DXBC signature (got: %c%c%c%c)", 
-                byteData[0], byteData[1], byteData[2], byteData[3]);
-            return E_INVALIDARG;
-        }
-
-        // Log first 32 bytes of shader bytecode for debugging
-        TRACE("Shader bytecode header:");
-        for (size_t i = 0; i < std::min<size_t>(32, pDesc->VS.BytecodeLength); i++) {
-            if (i % 16 == 0) TRACE("\n  %04zx:", i);
-            TRACE(" %02x", byteData[i]);
-        }
-        TRACE("\n");
-
-        // Create the shader
-        HRESULT hr = m_device->GetD3D11Device()->CreateVertexShader(
-            pDesc->VS.pShaderBytecode, pDesc->VS.BytecodeLength, nullptr,
-            &m_vertexShader);
+        // The module cache validates the container the first time it sees
+        // the bytecode
+        HRESULT hr = CreateShader(ShaderStage::Vertex, pDesc->VS,
+                                  m_vertexShader, &vertexModule);
         if (FAILED(hr)) {
             ERR("Failed to create vertex shader, hr %#x. Bytecode length: %zu", 
                 hr, pDesc->VS.BytecodeLength);
             return hr;
         }
-        
-        TRACE("Successfully created vertex shader");
     }
 
     // Create stream output if requested
@@ -281,15 +418,7 @@ HRESULT WrappedD3D12ToD3D11PipelineState::InitializeGraphics(
 
     // Create pixel shader
     if (pDesc->PS.pShaderBytecode && pDesc->PS.BytecodeLength) {
-        TRACE("Creating pixel shader with bytecode length %zu", pDesc->PS.BytecodeLength);
-        // Log first few bytes of shader bytecode for debugging
-        const uint32_t* dwordData = static_cast<const uint32_t*>(pDesc->PS.pShaderBytecode);
-        if (pDesc->PS.BytecodeLength >= 4) {
-            TRACE("Shader bytecode header: %08x", dwordData[0]);
-        }
-        HRESULT hr = m_device->GetD3D11Device()->CreatePixelShader(
-            pDesc->PS.pShaderBytecode, pDesc->PS.BytecodeLength, nullptr,
-            &m_pixelShader);
+        HRESULT hr = CreateShader(ShaderStage::Pixel, pDesc->PS, m_pixelShader);
         if (FAILED(hr)) {
             ERR("Failed to create pixel shader, hr %#x.", hr);
             return hr;
@@ -298,15 +427,8 @@ HRESULT WrappedD3D12ToD3D11PipelineState::InitializeGraphics(
 
     // Create geometry shader
     if (pDesc->GS.pShaderBytecode && pDesc->GS.BytecodeLength) {
-        TRACE("Creating geometry shader with bytecode length %zu", pDesc->GS.BytecodeLength);
-        // Log first few bytes of shader bytecode for debugging
-        const uint32_t* dwordData = static_cast<const uint32_t*>(pDesc->GS.pShaderBytecode);
-        if (pDesc->GS.BytecodeLength >= 4) {
-            TRACE("Shader bytecode header: %08x", dwordData[0]);
-        }
-        HRESULT hr = m_device->GetD3D11Device()->CreateGeometryShader(
-            pDesc->GS.pShaderBytecode, pDesc->GS.BytecodeLength, nullptr,
-            &m_geometryShader);
+        HRESULT hr = CreateShader(ShaderStage::Geometry, pDesc->GS,
+                                  m_geometryShader);
         if (FAILED(hr)) {
             ERR("Failed to create geometry shader, hr %#x.", hr);
             return hr;
@@ -315,15 +437,7 @@ HRESULT WrappedD3D12ToD3D11PipelineState::InitializeGraphics(
 
     // Create hull shader
     if (pDesc->HS.pShaderBytecode && pDesc->HS.BytecodeLength) {
-        TRACE("Creating hull shader with bytecode length %zu", pDesc->HS.BytecodeLength);
-        // Log first few bytes of shader bytecode for debugging
-        const uint32_t* dwordData = static_cast<const uint32_t*>(pDesc->HS.pShaderBytecode);
-        if (pDesc->HS.BytecodeLength >= 4) {
-            TRACE("Shader bytecode header: %08x", dwordData[0]);
-        }
-        HRESULT hr = m_device->GetD3D11Device()->CreateHullShader(
-            pDesc->HS.pShaderBytecode, pDesc->HS.BytecodeLength, nullptr,
-            &m_hullShader);
+        HRESULT hr = CreateShader(ShaderStage::Hull, pDesc->HS, m_hullShader);
         if (FAILED(hr)) {
             ERR("Failed to create hull shader, hr %#x.", hr);
             return hr;
@@ -332,15 +446,8 @@ HRESULT WrappedD3D12ToD3D11PipelineState::InitializeGraphics(
 
     // Create domain shader
     if (pDesc->DS.pShaderBytecode && pDesc->DS.BytecodeLength) {
-        TRACE("Creating domain shader with bytecode length %zu", pDesc->DS.BytecodeLength);
-        // Log first few bytes of shader bytecode for debugging
-        const uint32_t* dwordData = static_cast<const uint32_t*>(pDesc->DS.pShaderBytecode);
-        if (pDesc->DS.BytecodeLength >= 4) {
-            TRACE("Shader bytecode header: %08x", dwordData[0]);
-        }
-        HRESULT hr = m_device->GetD3D11Device()->CreateDomainShader(
-            pDesc->DS.pShaderBytecode, pDesc->DS.BytecodeLength, nullptr,
-            &m_domainShader);
+        HRESULT hr = CreateShader(ShaderStage::Domain, pDesc->DS,
+                                  m_domainShader);
         if (FAILED(hr)) {
             ERR("Failed to create domain shader, hr %#x.", hr);
             return hr;
@@ -365,9 +472,11 @@ HRESULT WrappedD3D12ToD3D11PipelineState::InitializeGraphics(
             d3d11Elem.InstanceDataStepRate = d3d12Elem.InstanceDataStepRate;
         }
 
-        HRESULT hr = m_device->GetD3D11Device()->CreateInputLayout(
+        HRESULT hr = m_device->GetStateObjectCache()->GetInputLayout(
             inputElements.data(), pDesc->InputLayout.NumElements,
             pDesc->VS.pShaderBytecode, pDesc->VS.BytecodeLength,
+            vertexModule->container.inputSignature.Resolve(
+                pDesc->VS.pShaderBytecode),
             &m_inputLayout);
         if (FAILED(hr)) {
             ERR("Failed to create input layout, hr %#x.", hr);
@@ -395,8 +504,9 @@ HRESULT WrappedD3D12ToD3D11PipelineState::InitializeGraphics(
         d3d11RT.RenderTargetWriteMask = d3d12RT.RenderTargetWriteMask;
     }
 
-    HRESULT hr =
-        m_device->GetD3D11Device()->CreateBlendState(&blendDesc, &m_blendState);
+    HRESULT hr = m_device->GetStateObjectCache()->GetBlendState(
+        blendDesc, &m_blendState);
+    m_sampleMask = pDesc->SampleMask;
     if (FAILED(hr)) {
         ERR("Failed to create blend state, hr %#x.", hr);
         return hr;
@@ -420,8 +530,8 @@ HRESULT WrappedD3D12ToD3D11PipelineState::InitializeGraphics(
     rasterizerDesc.AntialiasedLineEnable =
         pDesc->RasterizerState.AntialiasedLineEnable;
 
-    hr = m_device->GetD3D11Device()->CreateRasterizerState(&rasterizerDesc,
-                                                           &m_rasterizerState);
+    hr = m_device->GetStateObjectCache()->GetRasterizerState(
+        rasterizerDesc, &m_rasterizerState);
     if (FAILED(hr)) {
         ERR("Failed to create rasterizer state, hr %#x.", hr);
         return hr;
@@ -459,13 +569,14 @@ HRESULT WrappedD3D12ToD3D11PipelineState::InitializeGraphics(
     depthStencilDesc.BackFace.StencilFunc =
         static_cast<D3D11_COMPARISON_FUNC>(backFace.StencilFunc);
 
-    hr = m_device->GetD3D11Device()->CreateDepthStencilState(
-        &depthStencilDesc, &m_depthStencilState);
+    hr = m_device->GetStateObjectCache()->GetDepthStencilState(
+        depthStencilDesc, &m_depthStencilState);
     if (FAILED(hr)) {
         ERR("Failed to create depth-stencil state, hr %#x.", hr);
         return hr;
     }
 
+    BuildSignature();
     return S_OK;
 }
 
@@ -473,6 +584,14 @@ HRESULT WrappedD3D12ToD3D11PipelineState::CreateStreamOutputShader(
     const D3D12_STREAM_OUTPUT_DESC* pSODesc, const void* pShaderBytecode,
     SIZE_T BytecodeLength) {
         TRACE("WrappedD3D12ToD3D11PipelineState::CreateStreamOutputShader: Creating stream output shader");
+    // Stream output shaders bypass the shader module cache, which
+    // validates every other shader
+    DxbcContainerInfo container;
+    HRESULT hr = ValidateDxbc(pShaderBytecode, BytecodeLength, &container);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
     // Convert D3D12 stream output declarations to D3D11
     std::vector<D3D11_SO_DECLARATION_ENTRY> soDeclarations(pSODesc->NumEntries);
     for (UINT i = 0; i < pSODesc->NumEntries; i++) {
@@ -516,20 +635,13 @@ HRESULT WrappedD3D12ToD3D11PipelineState::InitializeCompute(
         return E_INVALIDARG;
     }
 
-    TRACE("Creating compute shader with bytecode length %zu", pDesc->CS.BytecodeLength);
-    // Log first few bytes of shader bytecode for debugging
-    const uint32_t* dwordData = static_cast<const uint32_t*>(pDesc->CS.pShaderBytecode);
-    if (pDesc->CS.BytecodeLength >= 4) {
-        TRACE("Shader bytecode header: %08x", dwordData[0]);
-    }
-    HRESULT hr = m_device->GetD3D11Device()->CreateComputeShader(
-        pDesc->CS.pShaderBytecode, pDesc->CS.BytecodeLength, nullptr,
-        &m_computeShader);
+    HRESULT hr = CreateShader(ShaderStage::Compute, pDesc->CS, m_computeShader);
     if (FAILED(hr)) {
         ERR("Failed to create compute shader, hr %#x.", hr);
         return hr;
     }
 
+    BuildSignature();
     return S_OK;
 }
 
@@ -606,48 +718,153 @@ HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11PipelineState::GetDevice(
     return m_device->QueryInterface(riid, ppvDevice);
 }
 
+HRESULT WrappedD3D12ToD3D11PipelineState::GetSerializedDesc(
+    std::vector<uint8_t>* desc) {
+    HRESULT hr = m_compiled.load() ? m_compileResult : Compile();
+    if (FAILED(hr)) {
+        return hr;
+    }
+    *desc = m_desc->IsCompute() ? SerializePipelineDesc(*m_desc->Compute())
+                                : SerializePipelineDesc(*m_desc->Graphics());
+    return S_OK;
+}
+
 // ID3D12PipelineState methods
 HRESULT STDMETHODCALLTYPE WrappedD3D12ToD3D11PipelineState::GetCachedBlob(
     ID3DBlob** ppBlob) {
     TRACE("WrappedD3D12ToD3D11PipelineState::GetCachedBlob %p", ppBlob);
-    FIXME("We don't implement pipeline state caching yet");
-    return E_NOTIMPL;
+    if (!ppBlob) {
+        return E_POINTER;
+    }
+    *ppBlob = nullptr;
+
+    // Only states that compiled successfully have a blob
+    std::vector<uint8_t> desc;
+    HRESULT hr = GetSerializedDesc(&desc);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    return PipelineDiskCache::CreateBlob(m_key.hash, desc, ppBlob);
+}
+
+void WrappedD3D12ToD3D11PipelineState::BuildSignature() {
+    auto set = [this](PipelineSetter setter, const void* object) {
+        m_signature[static_cast<UINT>(setter)] = object;
+    };
+    set(PipelineSetter::VertexShader, m_vertexShader.Get());
+    set(PipelineSetter::PixelShader, m_pixelShader.Get());
+    set(PipelineSetter::GeometryShader, GetGeometryShader());
+    set(PipelineSetter::HullShader, m_hullShader.Get());
+    set(PipelineSetter::DomainShader, m_domainShader.Get());
+    set(PipelineSetter::ComputeShader, m_computeShader.Get());
+    set(PipelineSetter::InputLayout, m_inputLayout.Get());
+    set(PipelineSetter::BlendState, m_blendState.Get());
+    set(PipelineSetter::RasterizerState, m_rasterizerState.Get());
+    set(PipelineSetter::DepthStencilState, m_depthStencilState.Get());
 }
 
-void WrappedD3D12ToD3D11PipelineState::Apply(ID3D11DeviceContext* context) {
+uint32_t WrappedD3D12ToD3D11PipelineState::GetChangedSetters(
+    const WrappedD3D12ToD3D11PipelineState* previous) {
+    if (!m_compiled.load() && FAILED(Compile())) {
+        return 0;
+    }
+
+    // Shader and state objects are shared between pipeline states, so
+    // comparing pointers finds what the previous state already bound. An
+    // object the previous state had and this one lacks is unbound; after
+    // a clear there is nothing to unbind.
+    uint32_t setters = 0;
+    for (UINT i = 0; i < kPipelineSetterCount; ++i) {
+        const void* bound = previous ? previous->m_signature[i] : nullptr;
+        if (bound != m_signature[i]) {
+            setters |= 1u << i;
+        }
+    }
+    // The sample mask is set with the blend state
+    if (m_blendState && previous && previous->m_sampleMask != m_sampleMask) {
+        setters |= PipelineSetterBit(PipelineSetter::BlendState);
+    }
+    return setters;
+}
+
+void WrappedD3D12ToD3D11PipelineState::Apply(
+    ID3D11DeviceContext* context, const FLOAT blendFactor[4],
+    UINT stencilRef, const WrappedD3D12ToD3D11PipelineState* previous) {
     TRACE("WrappedD3D12ToD3D11PipelineState::Apply");
+    ApplySetters(context, GetChangedSetters(previous), blendFactor,
+                 stencilRef);
+}
 
-    if (m_vertexShader) {
+void WrappedD3D12ToD3D11PipelineState::ApplySetters(
+    ID3D11DeviceContext* context, uint32_t setters,
+    const FLOAT blendFactor[4], UINT stencilRef) const {
+    auto changed = [setters](PipelineSetter setter) {
+        return (setters & PipelineSetterBit(setter)) != 0;
+    };
+    if (changed(PipelineSetter::VertexShader)) {
         context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
     }
-    if (m_pixelShader) {
+    if (changed(PipelineSetter::PixelShader)) {
         context->PSSetShader(m_pixelShader.Get(), nullptr, 0);
     }
-    if (m_streamOutShader) {
-        context->GSSetShader(m_streamOutShader.Get(), nullptr, 0);
-    } else if (m_geometryShader) {
-        context->GSSetShader(m_geometryShader.Get(), nullptr, 0);
+    if (changed(PipelineSetter::GeometryShader)) {
+        context->GSSetShader(GetGeometryShader(), nullptr, 0);
     }
-    if (m_hullShader) {
+    if (changed(PipelineSetter::HullShader)) {
         context->HSSetShader(m_hullShader.Get(), nullptr, 0);
     }
-    if (m_domainShader) {
+    if (changed(PipelineSetter::DomainShader)) {
         context->DSSetShader(m_domainShader.Get(), nullptr, 0);
     }
-    if (m_computeShader) {
+    if (changed(PipelineSetter::ComputeShader)) {
         context->CSSetShader(m_computeShader.Get(), nullptr, 0);
     }
-    if (m_inputLayout) {
+    if (changed(PipelineSetter::InputLayout)) {
         context->IASetInputLayout(m_inputLayout.Get());
     }
-    if (m_blendState) {
-        context->OMSetBlendState(m_blendState.Get(), nullptr, 0xffffffff);
+    if (changed(PipelineSetter::BlendState)) {
+        context->OMSetBlendState(m_blendState.Get(), blendFactor,
+                                 m_sampleMask);
     }
-    if (m_rasterizerState) {
+    if (changed(PipelineSetter::RasterizerState)) {
         context->RSSetState(m_rasterizerState.Get());
     }
-    if (m_depthStencilState) {
-        context->OMSetDepthStencilState(m_depthStencilState.Get(), 0);
+    if (changed(PipelineSetter::DepthStencilState)) {
+        context->OMSetDepthStencilState(m_depthStencilState.Get(),
+                                        stencilRef);
+    }
+}
+
+PipelineStateCache::PipelineStateCache() {
+    TRACE("PipelineStateCache created");
+}
+
+PipelineStateCache::~PipelineStateCache() {
+    TRACE("PipelineStateCache destroyed, %zu states cached", m_states.size());
+    MemoryStats::Instance().Remove(
+        MemoryCategory::PipelineStateCache,
+        m_states.size() *
+            (sizeof(Key) +
+             sizeof(Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState>)));
+}
+
+Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState>
+PipelineStateCache::Find(const Key& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_states.find(key);
+    if (it != m_states.end()) {
+        return it->second;
+    }
+    return nullptr;
+}
+
+void PipelineStateCache::Insert(
+    const Key& key,
+    Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11PipelineState> state) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_states.insert_or_assign(key, state).second) {
+        MemoryStats::Instance().Add(MemoryCategory::PipelineStateCache,
+                                    sizeof(key) + sizeof(state));
     }
 }
 
@@ -0,0 +1,304 @@
+#include "d3d11_impl/pipeline_stream.hpp"
+
+#include <climits>
+
+namespace dxiided {
+
+namespace {
+
+using ParseFn = void (*)(const void* data, ParsedPipelineStream* parsed);
+
+struct SubobjectInfo {
+    D3D12_PIPELINE_STATE_SUBOBJECT_TYPE type;
+    size_t size;
+    size_t alignment;
+    ParseFn parse;
+};
+
+template <typename T>
+constexpr SubobjectInfo Subobject(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE type,
+                                  ParseFn parse) {
+    return {type, sizeof(T), alignof(T), parse};
+}
+
+// Subobjects are read in place, the stream is aligned like the structs in
+// it
+template <typename T>
+const T& As(const void* data) {
+    return *static_cast<const T*>(data);
+}
+
+// Indexed by subobject type. Each subobject in the stream is its type
+// followed by the inner struct at that struct's alignment, and the next
+// one starts at pointer alignment.
+constexpr SubobjectInfo kSubobjects[] = {
+    Subobject<ID3D12RootSignature*>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.pRootSignature = As<ID3D12RootSignature*>(data);
+            parsed->compute.pRootSignature = As<ID3D12RootSignature*>(data);
+        }),
+    Subobject<D3D12_SHADER_BYTECODE>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.VS = As<D3D12_SHADER_BYTECODE>(data);
+        }),
+    Subobject<D3D12_SHADER_BYTECODE>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.PS = As<D3D12_SHADER_BYTECODE>(data);
+        }),
+    Subobject<D3D12_SHADER_BYTECODE>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.DS = As<D3D12_SHADER_BYTECODE>(data);
+        }),
+    Subobject<D3D12_SHADER_BYTECODE>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.HS = As<D3D12_SHADER_BYTECODE>(data);
+        }),
+    Subobject<D3D12_SHADER_BYTECODE>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.GS = As<D3D12_SHADER_BYTECODE>(data);
+        }),
+    Subobject<D3D12_SHADER_BYTECODE>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->compute.CS = As<D3D12_SHADER_BYTECODE>(data);
+        }),
+    Subobject<D3D12_STREAM_OUTPUT_DESC>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.StreamOutput = As<D3D12_STREAM_OUTPUT_DESC>(data);
+        }),
+    Subobject<D3D12_BLEND_DESC>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_BLEND,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.BlendState = As<D3D12_BLEND_DESC>(data);
+        }),
+    Subobject<UINT>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_MASK,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.SampleMask = As<UINT>(data);
+        }),
+    Subobject<D3D12_RASTERIZER_DESC>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RASTERIZER,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.RasterizerState = As<D3D12_RASTERIZER_DESC>(data);
+        }),
+    Subobject<D3D12_DEPTH_STENCIL_DESC>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.DepthStencilState =
+                As<D3D12_DEPTH_STENCIL_DESC>(data);
+        }),
+    Subobject<D3D12_INPUT_LAYOUT_DESC>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.InputLayout = As<D3D12_INPUT_LAYOUT_DESC>(data);
+        }),
+    Subobject<D3D12_INDEX_BUFFER_STRIP_CUT_VALUE>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_IB_STRIP_CUT_VALUE,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.IBStripCutValue =
+                As<D3D12_INDEX_BUFFER_STRIP_CUT_VALUE>(data);
+        }),
+    Subobject<D3D12_PRIMITIVE_TOPOLOGY_TYPE>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PRIMITIVE_TOPOLOGY,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.PrimitiveTopologyType =
+                As<D3D12_PRIMITIVE_TOPOLOGY_TYPE>(data);
+        }),
+    Subobject<D3D12_RT_FORMAT_ARRAY>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RENDER_TARGET_FORMATS,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            const auto& formats = As<D3D12_RT_FORMAT_ARRAY>(data);
+            parsed->graphics.NumRenderTargets = formats.NumRenderTargets;
+            for (UINT i = 0; i < 8; ++i) {
+                parsed->graphics.RTVFormats[i] = formats.RTFormats[i];
+            }
+        }),
+    Subobject<DXGI_FORMAT>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL_FORMAT,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.DSVFormat = As<DXGI_FORMAT>(data);
+        }),
+    Subobject<DXGI_SAMPLE_DESC>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_DESC,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.SampleDesc = As<DXGI_SAMPLE_DESC>(data);
+        }),
+    Subobject<UINT>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_NODE_MASK,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.NodeMask = As<UINT>(data);
+            parsed->compute.NodeMask = As<UINT>(data);
+        }),
+    Subobject<D3D12_CACHED_PIPELINE_STATE>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CACHED_PSO,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.CachedPSO = As<D3D12_CACHED_PIPELINE_STATE>(data);
+            parsed->compute.CachedPSO = As<D3D12_CACHED_PIPELINE_STATE>(data);
+        }),
+    Subobject<D3D12_PIPELINE_STATE_FLAGS>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_FLAGS,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            parsed->graphics.Flags = As<D3D12_PIPELINE_STATE_FLAGS>(data);
+            parsed->compute.Flags = As<D3D12_PIPELINE_STATE_FLAGS>(data);
+        }),
+    Subobject<D3D12_DEPTH_STENCIL_DESC1>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL1,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            const auto& desc = As<D3D12_DEPTH_STENCIL_DESC1>(data);
+            if (desc.DepthBoundsTestEnable) {
+                FIXME("Depth bounds test is not supported");
+            }
+            D3D12_DEPTH_STENCIL_DESC& out = parsed->graphics.DepthStencilState;
+            out.DepthEnable = desc.DepthEnable;
+            out.DepthWriteMask = desc.DepthWriteMask;
+            out.DepthFunc = desc.DepthFunc;
+            out.StencilEnable = desc.StencilEnable;
+            out.StencilReadMask = desc.StencilReadMask;
+            out.StencilWriteMask = desc.StencilWriteMask;
+            out.FrontFace = desc.FrontFace;
+            out.BackFace = desc.BackFace;
+        }),
+    Subobject<D3D12_VIEW_INSTANCING_DESC>(
+        D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VIEW_INSTANCING,
+        [](const void* data, ParsedPipelineStream* parsed) {
+            if (As<D3D12_VIEW_INSTANCING_DESC>(data).ViewInstanceCount > 1) {
+                FIXME("View instancing is not supported");
+            }
+        }),
+};
+
+constexpr UINT kSubobjectCount = sizeof(kSubobjects) / sizeof(kSubobjects[0]);
+
+constexpr bool SubobjectsMatchTypes() {
+    for (UINT i = 0; i < kSubobjectCount; ++i) {
+        if (static_cast<UINT>(kSubobjects[i].type) != i) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(SubobjectsMatchTypes(),
+              "kSubobjects must be indexed by subobject type");
+
+constexpr UINT TypeBit(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE type) {
+    return 1u << static_cast<UINT>(type);
+}
+
+constexpr UINT kGraphicsShaderBits =
+    TypeBit(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS) |
+    TypeBit(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS) |
+    TypeBit(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS) |
+    TypeBit(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS) |
+    TypeBit(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS);
+
+constexpr UINT kDepthStencilBits =
+    TypeBit(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL) |
+    TypeBit(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL1);
+
+size_t AlignUp(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// What D3D12 uses for subobjects the stream leaves out
+void SetDefaults(ParsedPipelineStream* parsed) {
+    parsed->graphics = {};
+    parsed->compute = {};
+
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc = parsed->graphics;
+    desc.SampleMask = UINT_MAX;
+    desc.SampleDesc.Count = 1;
+
+    for (auto& rt : desc.BlendState.RenderTarget) {
+        rt.SrcBlend = D3D12_BLEND_ONE;
+        rt.DestBlend = D3D12_BLEND_ZERO;
+        rt.BlendOp = D3D12_BLEND_OP_ADD;
+        rt.SrcBlendAlpha = D3D12_BLEND_ONE;
+        rt.DestBlendAlpha = D3D12_BLEND_ZERO;
+        rt.BlendOpAlpha = D3D12_BLEND_OP_ADD;
+        rt.LogicOp = D3D12_LOGIC_OP_NOOP;
+        rt.RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+    }
+
+    desc.RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
+    desc.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
+    desc.RasterizerState.DepthClipEnable = TRUE;
+
+    D3D12_DEPTH_STENCIL_DESC& depthStencil = desc.DepthStencilState;
+    depthStencil.DepthEnable = TRUE;
+    depthStencil.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+    depthStencil.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
+    depthStencil.StencilReadMask = D3D12_DEFAULT_STENCIL_READ_MASK;
+    depthStencil.StencilWriteMask = D3D12_DEFAULT_STENCIL_WRITE_MASK;
+    for (auto* face : {&depthStencil.FrontFace, &depthStencil.BackFace}) {
+        face->StencilFailOp = D3D12_STENCIL_OP_KEEP;
+        face->StencilDepthFailOp = D3D12_STENCIL_OP_KEEP;
+        face->StencilPassOp = D3D12_STENCIL_OP_KEEP;
+        face->StencilFunc = D3D12_COMPARISON_FUNC_ALWAYS;
+    }
+}
+
+}  // namespace
+
+HRESULT ParsePipelineStateStream(const D3D12_PIPELINE_STATE_STREAM_DESC& desc,
+                                 ParsedPipelineStream* parsed) {
+    const uint8_t* stream =
+        static_cast<const uint8_t*>(desc.pPipelineStateSubobjectStream);
+    size_t size = desc.SizeInBytes;
+    if (!stream || !size) {
+        return E_INVALIDARG;
+    }
+
+    SetDefaults(parsed);
+
+    UINT seen = 0;
+    size_t offset = 0;
+    while (offset < size) {
+        if (size - offset < sizeof(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE)) {
+            WARN("Pipeline state stream ends inside a subobject");
+            return E_INVALIDARG;
+        }
+        UINT type =
+            As<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE>(stream + offset);
+        if (type >= kSubobjectCount) {
+            WARN("Unsupported pipeline state subobject type %u", type);
+            return E_INVALIDARG;
+        }
+
+        const SubobjectInfo& info = kSubobjects[type];
+        size_t inner = AlignUp(
+            offset + sizeof(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE),
+            info.alignment);
+        if (inner > size || size - inner < info.size) {
+            WARN("Pipeline state subobject %u runs past the stream", type);
+            return E_INVALIDARG;
+        }
+
+        UINT bit = TypeBit(info.type);
+        if ((seen & bit) ||
+            ((bit & kDepthStencilBits) && (seen & kDepthStencilBits))) {
+            WARN("Pipeline state subobject %u appears twice", type);
+            return E_INVALIDARG;
+        }
+        seen |= bit;
+
+        info.parse(stream + inner, parsed);
+        offset = AlignUp(inner + info.size, sizeof(void*));
+    }
+
+    parsed->isCompute =
+        (seen & TypeBit(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS)) != 0;
+    if (parsed->isCompute && (seen & kGraphicsShaderBits)) {
+        WARN("Pipeline state stream has both compute and graphics shaders");
+        return E_INVALIDARG;
+    }
+    return S_OK;
+}
+
+}  // namespace dxiided
@@ -0,0 +1,375 @@
+#include "d3d11_impl/readback_manager.hpp"
+
+#include <d3d11_4.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "common/memory_stats.hpp"
+#include "d3d11_impl/format_info.hpp"
+#include "d3d11_impl/resource.hpp"
+#include "d3d11_impl/row_copy.hpp"
+#include "d3d11_impl/submission_tracker.hpp"
+
+namespace dxiided {
+
+ReadbackManager::ReadbackManager(ID3D11Device* device,
+                                 ID3D11DeviceContext* context,
+                                 SubmissionTracker* tracker)
+    : m_device(device), m_context(context), m_tracker(tracker) {
+    TRACE("ReadbackManager created");
+
+    // The completion thread polls the immediate context, which is only safe
+    // once the runtime serializes context calls for us
+    Microsoft::WRL::ComPtr<ID3D11Multithread> multithread;
+    if (SUCCEEDED(m_context.As(&multithread))) {
+        multithread->SetMultithreadProtected(TRUE);
+        m_completionThread =
+            std::thread(&ReadbackManager::CompletionThreadMain, this);
+    } else {
+        WARN("ID3D11Multithread unavailable, readbacks resolve on Map only");
+    }
+}
+
+ReadbackManager::~ReadbackManager() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    if (m_completionThread.joinable()) {
+        m_completionThread.join();
+    }
+    TRACE("ReadbackManager destroyed, %zu copies still pending",
+          m_pending.size());
+    for (const auto& bucket : m_pool) {
+        for (const PooledStaging& pooled : bucket.second) {
+            MemoryStats::Instance().Remove(MemoryCategory::ReadbackStaging,
+                                           pooled.size);
+        }
+    }
+}
+
+UINT ReadbackManager::GetBucketSize(UINT size) {
+    UINT bucket = kMinBucketSize;
+    while (bucket < size && bucket < (1u << 31)) {
+        bucket <<= 1;
+    }
+    return std::max(bucket, size);
+}
+
+TransientKey ReadbackManager::GetStagingKey(ID3D11Resource* resource) {
+    D3D11_RESOURCE_DIMENSION dimension = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+    resource->GetType(&dimension);
+    switch (dimension) {
+        case D3D11_RESOURCE_DIMENSION_BUFFER: {
+            D3D11_BUFFER_DESC desc = {};
+            static_cast<ID3D11Buffer*>(resource)->GetDesc(&desc);
+            return TransientKey::FromDesc(desc);
+        }
+        case D3D11_RESOURCE_DIMENSION_TEXTURE1D: {
+            D3D11_TEXTURE1D_DESC desc = {};
+            static_cast<ID3D11Texture1D*>(resource)->GetDesc(&desc);
+            return TransientKey::FromDesc(desc);
+        }
+        case D3D11_RESOURCE_DIMENSION_TEXTURE2D: {
+            D3D11_TEXTURE2D_DESC desc = {};
+            static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc);
+            return TransientKey::FromDesc(desc);
+        }
+        case D3D11_RESOURCE_DIMENSION_TEXTURE3D: {
+            D3D11_TEXTURE3D_DESC desc = {};
+            static_cast<ID3D11Texture3D*>(resource)->GetDesc(&desc);
+            return TransientKey::FromDesc(desc);
+        }
+        default:
+            return TransientKey();
+    }
+}
+
+UINT64 ReadbackManager::GetStagingSize(const TransientKey& key) {
+    if (key.dimension == D3D11_RESOURCE_DIMENSION_BUFFER) {
+        return key.width;
+    }
+    // Staging textures have a single mip and array slice
+    UINT64 size = GetFormatRowSize(key.format, key.width) *
+                  GetFormatRowCount(key.format, std::max(key.height, 1u));
+    if (key.dimension == D3D11_RESOURCE_DIMENSION_TEXTURE3D) {
+        size *= std::max(key.depthOrArraySize, 1u);
+    }
+    return size;
+}
+
+Microsoft::WRL::ComPtr<ID3D11Resource> ReadbackManager::AcquirePooled(
+    const TransientKey& key) {
+    UINT64 completed = m_tracker->GetCompletedSerial();
+
+    std::lock_guard<std::mutex> lock(m_poolMutex);
+    std::lock_guard<std::mutex> pendingLock(m_mutex);
+    auto bucket = m_pool.find(key);
+    if (bucket == m_pool.end()) {
+        return nullptr;
+    }
+    for (auto it = bucket->second.begin(); it != bucket->second.end(); ++it) {
+        // The GPU must be done with it and its contents already consumed
+        if (it->lastUsedSerial <= completed &&
+            !IsPendingLocked(it->resource.Get())) {
+            Microsoft::WRL::ComPtr<ID3D11Resource> resource = it->resource;
+            MemoryStats::Instance().Remove(MemoryCategory::ReadbackStaging,
+                                           it->size);
+            bucket->second.erase(it);
+            return resource;
+        }
+    }
+    return nullptr;
+}
+
+Microsoft::WRL::ComPtr<ID3D11Resource> ReadbackManager::AcquireStagingBuffer(
+    UINT size) {
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = GetBucketSize(size);
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+    Microsoft::WRL::ComPtr<ID3D11Resource> pooled =
+        AcquirePooled(TransientKey::FromDesc(desc));
+    if (pooled) {
+        return pooled;
+    }
+
+    Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+    HRESULT hr = m_device->CreateBuffer(&desc, nullptr, &buffer);
+    if (FAILED(hr)) {
+        ERR("Failed to create %u byte readback staging buffer, hr %#x",
+            desc.ByteWidth, hr);
+        return nullptr;
+    }
+
+    TRACE("Created readback staging buffer %p, size %u", buffer.Get(),
+          desc.ByteWidth);
+    return buffer;
+}
+
+Microsoft::WRL::ComPtr<ID3D11Resource> ReadbackManager::AcquireStagingTexture(
+    D3D11_RESOURCE_DIMENSION dimension, DXGI_FORMAT format, UINT width,
+    UINT height, UINT depth) {
+    // Block-compressed staging textures must cover whole blocks
+    const FormatInfo& info = GetFormatInfo(format);
+    width = (width + info.blockWidth - 1) / info.blockWidth * info.blockWidth;
+    height = (height + info.blockHeight - 1) / info.blockHeight *
+             info.blockHeight;
+
+    Microsoft::WRL::ComPtr<ID3D11Resource> staging;
+    HRESULT hr = E_INVALIDARG;
+    switch (dimension) {
+        case D3D11_RESOURCE_DIMENSION_TEXTURE1D: {
+            D3D11_TEXTURE1D_DESC desc = {};
+            desc.Width = width;
+            desc.MipLevels = 1;
+            desc.ArraySize = 1;
+            desc.Format = format;
+            desc.Usage = D3D11_USAGE_STAGING;
+            desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+            staging = AcquirePooled(TransientKey::FromDesc(desc));
+            if (staging) {
+                return staging;
+            }
+            Microsoft::WRL::ComPtr<ID3D11Texture1D> texture;
+            hr = m_device->CreateTexture1D(&desc, nullptr, &texture);
+            staging = texture;
+            break;
+        }
+        case D3D11_RESOURCE_DIMENSION_TEXTURE2D: {
+            D3D11_TEXTURE2D_DESC desc = {};
+            desc.Width = width;
+            desc.Height = height;
+            desc.MipLevels = 1;
+            desc.ArraySize = 1;
+            desc.Format = format;
+            desc.SampleDesc.Count = 1;
+            desc.Usage = D3D11_USAGE_STAGING;
+            desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+            staging = AcquirePooled(TransientKey::FromDesc(desc));
+            if (staging) {
+                return staging;
+            }
+            Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+            hr = m_device->CreateTexture2D(&desc, nullptr, &texture);
+            staging = texture;
+            break;
+        }
+        case D3D11_RESOURCE_DIMENSION_TEXTURE3D: {
+            D3D11_TEXTURE3D_DESC desc = {};
+            desc.Width = width;
+            desc.Height = height;
+            desc.Depth = depth;
+            desc.MipLevels = 1;
+            desc.Format = format;
+            desc.Usage = D3D11_USAGE_STAGING;
+            desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+            staging = AcquirePooled(TransientKey::FromDesc(desc));
+            if (staging) {
+                return staging;
+            }
+            Microsoft::WRL::ComPtr<ID3D11Texture3D> texture;
+            hr = m_device->CreateTexture3D(&desc, nullptr, &texture);
+            staging = texture;
+            break;
+        }
+        default:
+            break;
+    }
+
+    if (FAILED(hr)) {
+        ERR("Failed to create %ux%ux%u readback staging texture, hr %#x",
+            width, height, depth, hr);
+        return nullptr;
+    }
+
+    TRACE("Created readback staging texture %p, %ux%ux%u format %d",
+          staging.Get(), width, height, depth, format);
+    return staging;
+}
+
+void ReadbackManager::ReleaseStaging(
+    Microsoft::WRL::ComPtr<ID3D11Resource> staging, UINT64 lastUsedSerial) {
+    if (!staging) {
+        return;
+    }
+
+    TransientKey key = GetStagingKey(staging.Get());
+
+    std::lock_guard<std::mutex> lock(m_poolMutex);
+    auto& bucket = m_pool[key];
+    if (bucket.size() < kMaxPooledPerBucket) {
+        UINT64 size = GetStagingSize(key);
+        bucket.push_back({staging, lastUsedSerial, size});
+        MemoryStats::Instance().Add(MemoryCategory::ReadbackStaging, size);
+    }
+}
+
+void ReadbackManager::Submit(const std::vector<ReadbackCopy>& copies,
+                             UINT64 serial) {
+    if (copies.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const ReadbackCopy& copy : copies) {
+            m_pending.push_back(copy);
+            m_pending.back().serial = serial;
+        }
+    }
+    m_cv.notify_all();
+
+    TRACE("Queued %zu readback copies at serial %llu", copies.size(), serial);
+}
+
+void ReadbackManager::Resolve(WrappedD3D12ToD3D11Resource* target) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (;;) {
+        auto it = std::find_if(m_pending.begin(), m_pending.end(),
+                               [target](const ReadbackCopy& copy) {
+                                   return copy.target == target;
+                               });
+        if (it == m_pending.end()) {
+            break;
+        }
+
+        UINT64 serial = it->serial;
+        lock.unlock();
+        m_tracker->WaitForSerial(m_context.Get(), serial);
+        lock.lock();
+
+        ResolveCompletedLocked(
+            std::max(serial, m_tracker->GetCompletedSerial()), true);
+    }
+}
+
+void ReadbackManager::Cancel(WrappedD3D12ToD3D11Resource* target) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(),
+                                   [target](const ReadbackCopy& copy) {
+                                       return copy.target == target;
+                                   }),
+                    m_pending.end());
+}
+
+bool ReadbackManager::IsPendingLocked(ID3D11Resource* staging) const {
+    return std::any_of(m_pending.begin(), m_pending.end(),
+                       [staging](const ReadbackCopy& copy) {
+                           return copy.staging.Get() == staging;
+                       });
+}
+
+void ReadbackManager::ResolveCompletedLocked(UINT64 completedSerial,
+                                             bool wait) {
+    // Copies are applied in submission order so later writes win
+    while (!m_pending.empty() && m_pending.front().serial <= completedSerial) {
+        if (!ResolveCopyLocked(m_pending.front(), wait)) {
+            break;
+        }
+        m_pending.pop_front();
+    }
+}
+
+bool ReadbackManager::ResolveCopyLocked(const ReadbackCopy& copy, bool wait) {
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    HRESULT hr = m_context->Map(copy.staging.Get(), 0, D3D11_MAP_READ,
+                                wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+    if (hr == DXGI_ERROR_WAS_STILL_DRAWING) {
+        return false;
+    }
+    if (FAILED(hr)) {
+        ERR("Failed to map readback staging buffer, hr %#x", hr);
+        return true;
+    }
+
+    uint8_t* shadow = copy.target->GetReadbackShadow();
+    UINT64 shadowSize = copy.target->GetReadbackShadowSize();
+    if (shadow && copy.dstOffset + copy.size <= shadowSize) {
+        if (copy.rowCount) {
+            CopySlices(shadow + copy.dstOffset, copy.rowPitch,
+                       copy.depthPitch, mapped.pData, mapped.RowPitch,
+                       mapped.DepthPitch, copy.rowSize, copy.rowCount,
+                       copy.sliceCount, false);
+        } else {
+            memcpy(shadow + copy.dstOffset, mapped.pData,
+                   static_cast<size_t>(copy.size));
+        }
+    } else {
+        ERR("Readback copy of %llu bytes at %llu out of bounds", copy.size,
+            copy.dstOffset);
+    }
+
+    m_context->Unmap(copy.staging.Get(), 0);
+    return true;
+}
+
+void ReadbackManager::CompletionThreadMain() {
+    TRACE("Readback completion thread started");
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop) {
+        if (m_pending.empty()) {
+            m_cv.wait(lock, [this] { return m_stop || !m_pending.empty(); });
+            continue;
+        }
+
+        lock.unlock();
+        UINT64 completed = m_tracker->Poll(m_context.Get());
+        lock.lock();
+
+        ResolveCompletedLocked(completed, false);
+        if (!m_pending.empty()) {
+            m_cv.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+
+    TRACE("Readback completion thread stopped");
+}
+
+}  // namespace dxiided
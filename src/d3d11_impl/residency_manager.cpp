@@ -0,0 +1,170 @@
+#include "d3d11_impl/residency_manager.hpp"
+
+#include <algorithm>
+
+#include "d3d11_impl/submission_tracker.hpp"
+
+namespace dxiided {
+
+ResidencyManager::ResidencyManager(ID3D11Device* device,
+                                   SubmissionTracker* tracker)
+    : m_tracker(tracker) {
+    Microsoft::WRL::ComPtr<IDXGIDevice> dxgiDevice;
+    Microsoft::WRL::ComPtr<IDXGIAdapter> adapter;
+    if (FAILED(device->QueryInterface(IID_PPV_ARGS(&dxgiDevice))) ||
+        FAILED(dxgiDevice->GetAdapter(&adapter)) ||
+        FAILED(adapter.As(&m_adapter))) {
+        WARN("IDXGIAdapter3 unavailable, video memory budget not tracked");
+    }
+    TRACE("ResidencyManager created");
+}
+
+ResidencyManager::~ResidencyManager() {
+    TRACE("ResidencyManager destroyed, %zu resources tracked",
+          m_entries.size());
+}
+
+void ResidencyManager::ApplyPriorityLocked(Entry& entry) {
+    if (!entry.resource) {
+        return;
+    }
+    entry.resource->SetEvictionPriority(entry.evicted || entry.demoted
+                                            ? DXGI_RESOURCE_PRIORITY_MINIMUM
+                                            : entry.priority);
+}
+
+void ResidencyManager::Register(WrappedD3D12ToD3D11Resource* resource,
+                                ID3D11Resource* d3d11Resource, UINT64 size) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = m_entries[resource];
+    entry.resource = d3d11Resource;
+    entry.size = size;
+    entry.lastUsedSerial = m_tracker->GetNextSerial();
+    entry.demoted = false;
+
+    // Recycled D3D11 resources keep the priority of their last owner, and
+    // residency calls may predate the D3D11 resource
+    ApplyPriorityLocked(entry);
+}
+
+void ResidencyManager::Unregister(WrappedD3D12ToD3D11Resource* resource) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.erase(resource);
+}
+
+void ResidencyManager::MakeResident(WrappedD3D12ToD3D11Resource* resource) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = m_entries[resource];
+    entry.evicted = false;
+    entry.demoted = false;
+    entry.lastUsedSerial = m_tracker->GetNextSerial();
+    ApplyPriorityLocked(entry);
+}
+
+void ResidencyManager::Evict(WrappedD3D12ToD3D11Resource* resource) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = m_entries[resource];
+    entry.evicted = true;
+    ApplyPriorityLocked(entry);
+}
+
+void ResidencyManager::SetPriority(WrappedD3D12ToD3D11Resource* resource,
+                                   UINT priority) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = m_entries[resource];
+    entry.priority = priority;
+    ApplyPriorityLocked(entry);
+}
+
+void ResidencyManager::NoteView(WrappedD3D12ToD3D11Resource* resource) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = m_entries[resource];
+    entry.viewed = true;
+    if (entry.demoted) {
+        entry.demoted = false;
+        ApplyPriorityLocked(entry);
+    }
+}
+
+void ResidencyManager::MarkUsed(
+    const std::vector<WrappedD3D12ToD3D11Resource*>& resources,
+    UINT64 serial) {
+    if (resources.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (WrappedD3D12ToD3D11Resource* resource : resources) {
+        auto it = m_entries.find(resource);
+        if (it == m_entries.end()) {
+            continue;
+        }
+        Entry& entry = it->second;
+        entry.lastUsedSerial = std::max(entry.lastUsedSerial, serial);
+        if (entry.demoted) {
+            entry.demoted = false;
+            ApplyPriorityLocked(entry);
+        }
+    }
+}
+
+void ResidencyManager::OnSubmitted(UINT64 serial) {
+    if (!m_adapter) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (serial - m_lastPollSerial < kBudgetPollInterval) {
+        return;
+    }
+    m_lastPollSerial = serial;
+
+    DXGI_QUERY_VIDEO_MEMORY_INFO info = {};
+    HRESULT hr = m_adapter->QueryVideoMemoryInfo(
+        0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info);
+    if (FAILED(hr)) {
+        WARN("QueryVideoMemoryInfo failed, hr %#x", hr);
+        return;
+    }
+
+    if (info.CurrentUsage > info.Budget) {
+        TRACE("Video memory usage %llu over budget %llu", info.CurrentUsage,
+              info.Budget);
+        DemoteColdLocked(info.CurrentUsage - info.Budget);
+    }
+}
+
+void ResidencyManager::DemoteColdLocked(UINT64 overage) {
+    UINT64 submitted = m_tracker->GetLastSubmittedSerial();
+
+    std::vector<Entry*> cold;
+    for (auto& [resource, entry] : m_entries) {
+        if (entry.resource && !entry.evicted && !entry.demoted &&
+            !entry.viewed &&
+            entry.lastUsedSerial + kColdSerials <= submitted) {
+            cold.push_back(&entry);
+        }
+    }
+
+    // Least recently used first, until the overage is covered
+    std::sort(cold.begin(), cold.end(), [](const Entry* a, const Entry* b) {
+        return a->lastUsedSerial < b->lastUsedSerial;
+    });
+
+    UINT64 demotedBytes = 0;
+    size_t demotedCount = 0;
+    for (Entry* entry : cold) {
+        if (demotedBytes >= overage) {
+            break;
+        }
+        entry->demoted = true;
+        ApplyPriorityLocked(*entry);
+        demotedBytes += entry->size;
+        demotedCount++;
+    }
+
+    TRACE("Demoted %zu cold resources, %llu bytes of %llu over budget",
+          demotedCount, demotedBytes, overage);
+}
+
+}  // namespace dxiided
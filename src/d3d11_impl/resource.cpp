@@ -1,10 +1,73 @@
 #include "d3d11_impl/resource.hpp"
 
+#include <algorithm>
+#include <cstring>
+
+#include "common/config.hpp"
+#include "common/memory_stats.hpp"
 #include "d3d11_impl/device.hpp"
+#include "d3d11_impl/format_info.hpp"
 #include "d3d11_impl/gpu_va_mgr.hpp"
+#include "d3d11_impl/readback_manager.hpp"
+#include "d3d11_impl/resource_materializer.hpp"
+#include "d3d11_impl/row_copy.hpp"
+#include "d3d11_impl/upload_ring.hpp"
 
 namespace dxiided {
 
+namespace {
+
+// Missing from older mingw-w64 d3d12.h
+constexpr D3D12_HEAP_FLAGS kHeapFlagCreateNotZeroed =
+    static_cast<D3D12_HEAP_FLAGS>(0x1000);
+
+// {43e48b71-e529-418c-8fcc-5e8bb36adfae}
+constexpr GUID kWrapperBackPointerGuid = {
+    0x43e48b71, 0xe529, 0x418c,
+    {0x8f, 0xcc, 0x5e, 0x8b, 0xb3, 0x6a, 0xdf, 0xae}};
+
+// Byte offset of a box's first block within a mapped subresource
+SIZE_T GetBoxOffset(DXGI_FORMAT format, const D3D12_BOX& box, UINT rowPitch,
+                    UINT depthPitch) {
+    const FormatInfo& info = GetFormatInfo(format);
+    return static_cast<SIZE_T>(box.front) * depthPitch +
+           static_cast<SIZE_T>(box.top / info.blockHeight) * rowPitch +
+           static_cast<SIZE_T>(box.left / info.blockWidth) *
+               info.bytesPerBlock;
+}
+
+UINT64 EstimateTextureSize(UINT width, UINT height, UINT depth,
+                           UINT arraySize, UINT mipLevels, DXGI_FORMAT format,
+                           UINT sampleCount) {
+    UINT64 size = 0;
+    for (UINT mip = 0; mip < std::max(mipLevels, 1u); ++mip) {
+        size += GetFormatRowSize(format, width) *
+                GetFormatRowCount(format, height) * depth;
+        if (width == 1 && height == 1 && depth == 1) {
+            break;
+        }
+        width = std::max(width >> 1, 1u);
+        height = std::max(height >> 1, 1u);
+        depth = std::max(depth >> 1, 1u);
+    }
+    return size * std::max(arraySize, 1u) * std::max(sampleCount, 1u);
+}
+
+MemoryCategory GetHeapMemoryCategory(D3D12_HEAP_TYPE type) {
+    switch (type) {
+        case D3D12_HEAP_TYPE_DEFAULT:
+            return MemoryCategory::DefaultHeap;
+        case D3D12_HEAP_TYPE_UPLOAD:
+            return MemoryCategory::UploadHeap;
+        case D3D12_HEAP_TYPE_READBACK:
+            return MemoryCategory::ReadbackHeap;
+        default:
+            return MemoryCategory::CustomHeap;
+    }
+}
+
+}  // namespace
+
 HRESULT WrappedD3D12ToD3D11Resource::Create(
     WrappedD3D12ToD3D11Device* device,
     const D3D12_HEAP_PROPERTIES* pHeapProperties, D3D12_HEAP_FLAGS HeapFlags,
@@ -29,11 +92,53 @@ HRESULT WrappedD3D12ToD3D11Resource::Create(
         new WrappedD3D12ToD3D11Resource(device, pHeapProperties, HeapFlags,
                                         pDesc, InitialState);
 
-    if (!resource->GetD3D11Resource()) {
+    if (!resource->IsValid()) {
         ERR("Failed to create D3D11 resource.");
         return E_FAIL;
     }
 
+    // Large resources can be built ahead of their first use
+    const Config& config = Config::Instance();
+    if (config.LazyResources() && config.BackgroundCreate() &&
+        resource->m_d3d11Size >= config.BackgroundCreateMinSize()) {
+        device->GetResourceMaterializer()->Enqueue(resource.Get());
+    }
+
+    return resource.CopyTo(reinterpret_cast<ID3D12Resource**>(ppvResource));
+}
+
+HRESULT WrappedD3D12ToD3D11Resource::CreateReserved(
+    WrappedD3D12ToD3D11Device* device, const D3D12_RESOURCE_DESC* pDesc,
+    D3D12_RESOURCE_STATES InitialState, REFIID riid, void** ppvResource) {
+    TRACE("WrappedD3D12ToD3D11Resource::CreateReserved(%p, %p, %#x, %s, %p)",
+          device, pDesc, InitialState, debugstr_guid(&riid).c_str(),
+          ppvResource);
+
+    if (!device || !pDesc || !ppvResource) {
+        WARN("Invalid parameters: device=%p, pDesc=%p, ppvResource=%p",
+             device, pDesc, ppvResource);
+        return E_INVALIDARG;
+    }
+
+    // D3D11 has no tiled 1D textures, and D3D12 doesn't allow them either
+    if (pDesc->Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE1D) {
+        WARN("Reserved 1D textures are not supported.");
+        return E_INVALIDARG;
+    }
+
+    D3D12_HEAP_PROPERTIES heapProperties = {};
+    heapProperties.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+    Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11Resource> resource =
+        new WrappedD3D12ToD3D11Resource(device, &heapProperties,
+                                        D3D12_HEAP_FLAG_NONE, pDesc,
+                                        InitialState, true);
+
+    if (!resource->IsValid()) {
+        ERR("Failed to create D3D11 tiled resource.");
+        return E_FAIL;
+    }
+
     return resource.CopyTo(reinterpret_cast<ID3D12Resource**>(ppvResource));
 }
 
@@ -64,7 +169,8 @@ HRESULT WrappedD3D12ToD3D11Resource::Create(WrappedD3D12ToD3D11Device* device,
 WrappedD3D12ToD3D11Resource::WrappedD3D12ToD3D11Resource(
     WrappedD3D12ToD3D11Device* device,
     const D3D12_HEAP_PROPERTIES* pHeapProperties, D3D12_HEAP_FLAGS HeapFlags,
-    const D3D12_RESOURCE_DESC* pDesc, D3D12_RESOURCE_STATES InitialState)
+    const D3D12_RESOURCE_DESC* pDesc, D3D12_RESOURCE_STATES InitialState,
+    bool reserved)
     : m_device(device),
       m_resource(nullptr),
       m_desc(*pDesc),
@@ -74,19 +180,37 @@ WrappedD3D12ToD3D11Resource::WrappedD3D12ToD3D11Resource(
       m_currentState(InitialState),
       m_state(InitialState),
       m_isUAV(false),
-      m_format(pDesc->Format) {
+      m_format(pDesc->Format),
+      m_reserved(reserved) {
+    HRESULT hr = E_INVALIDARG;
+
+    // Tiled resources can't generate mips
+    UINT miscFlags = GetMiscFlags(pDesc);
+    if (m_reserved) {
+        miscFlags = (miscFlags & ~D3D11_RESOURCE_MISC_GENERATE_MIPS) |
+                    D3D11_RESOURCE_MISC_TILED;
+    }
+
     // If it looks like a buffer (1D with height=1), treat it as one
     if (pDesc->Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ||
         (pDesc->Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE1D &&
          pDesc->Height == 1)) {
-        D3D11_BUFFER_DESC bufferDesc = {};
+        D3D11_BUFFER_DESC& bufferDesc = m_d3d11Desc.buffer;
         bufferDesc.ByteWidth = static_cast<UINT>(pDesc->Width);
         bufferDesc.Usage = GetD3D11Usage(pHeapProperties);
         bufferDesc.BindFlags = GetD3D11BindFlags(pDesc);
         bufferDesc.CPUAccessFlags = GetD3D11CPUAccessFlags(pHeapProperties);
-        bufferDesc.MiscFlags = GetMiscFlags(pDesc);
+        bufferDesc.MiscFlags = miscFlags;
         bufferDesc.StructureByteStride = 0;
 
+        // Upload buffers live in GPU memory and are fed through a renaming
+        // ring, the application only ever maps the CPU shadow
+        m_useUploadRing = pHeapProperties->Type == D3D12_HEAP_TYPE_UPLOAD;
+        if (m_useUploadRing) {
+            bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+            bufferDesc.CPUAccessFlags = 0;
+        }
+
         // If this buffer will be used as SRV/UAV, set format
         if (bufferDesc.BindFlags &
             (D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS)) {
@@ -102,23 +226,25 @@ WrappedD3D12ToD3D11Resource::WrappedD3D12ToD3D11Resource(
               bufferDesc.Usage, bufferDesc.CPUAccessFlags,
               bufferDesc.BindFlags);
 
-        Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
-        HRESULT hr = m_device->GetD3D11Device()->CreateBuffer(&bufferDesc,
-                                                              nullptr, &buffer);
-
-        if (FAILED(hr)) {
-            ERR("Failed to create D3D11 buffer, hr %#x", hr);
-            return;
+        // GPU copies into readback buffers are resolved into this on Map
+        if (pHeapProperties->Type == D3D12_HEAP_TYPE_READBACK) {
+            m_readbackShadow.resize(bufferDesc.ByteWidth);
+            MemoryStats::Instance().Add(MemoryCategory::ReadbackShadow,
+                                        m_readbackShadow.size());
         }
 
-        m_resource = buffer;
+        m_d3d11Dimension = D3D11_RESOURCE_DIMENSION_BUFFER;
+        m_d3d11Size = bufferDesc.ByteWidth;
 
+        // A null output only validates the desc
+        hr = m_device->GetD3D11Device()->CreateBuffer(&bufferDesc, nullptr,
+                                                      nullptr);
     } else {
         DXGI_FORMAT format = GetViewFormat(pDesc->Format);
         switch (pDesc->Dimension) {
             case D3D12_RESOURCE_DIMENSION_TEXTURE1D: {
                 TRACE("D3D12_RESOURCE_DIMENSION_TEXTURE1D match");
-                D3D11_TEXTURE1D_DESC texDesc = {};
+                D3D11_TEXTURE1D_DESC& texDesc = m_d3d11Desc.texture1D;
                 texDesc.Width = static_cast<UINT>(pDesc->Width);
                 texDesc.MipLevels = pDesc->MipLevels;
                 texDesc.ArraySize = pDesc->DepthOrArraySize;
@@ -133,20 +259,17 @@ WrappedD3D12ToD3D11Resource::WrappedD3D12ToD3D11Resource(
                         : 0;
                 texDesc.MiscFlags = 0;
 
-                Microsoft::WRL::ComPtr<ID3D11Texture1D> texture;
-                HRESULT hr = m_device->GetD3D11Device()->CreateTexture1D(
-                    &texDesc, nullptr, &texture);
-                if (FAILED(hr)) {
-                    ERR("Failed to create texture 1D, hr %#x.", hr);
-                    return;
-                }
-                m_resource = texture;
-                StoreInDeviceMap();
+                m_d3d11Dimension = D3D11_RESOURCE_DIMENSION_TEXTURE1D;
+                m_d3d11Size = EstimateTextureSize(
+                    texDesc.Width, 1, 1, texDesc.ArraySize, texDesc.MipLevels,
+                    texDesc.Format, 1);
+                hr = m_device->GetD3D11Device()->CreateTexture1D(
+                    &texDesc, nullptr, nullptr);
                 break;
             }
             case D3D12_RESOURCE_DIMENSION_TEXTURE2D: {
                 TRACE("D3D12_RESOURCE_DIMENSION_TEXTURE2D match");
-                D3D11_TEXTURE2D_DESC texDesc = {};
+                D3D11_TEXTURE2D_DESC& texDesc = m_d3d11Desc.texture2D;
                 texDesc.Width = static_cast<UINT>(pDesc->Width);
                 texDesc.Height = pDesc->Height;
                 texDesc.MipLevels = pDesc->MipLevels;
@@ -161,22 +284,20 @@ WrappedD3D12ToD3D11Resource::WrappedD3D12ToD3D11Resource(
                     : (GetD3D11Usage(pHeapProperties) == D3D11_USAGE_STAGING)
                         ? (D3D11_CPU_ACCESS_READ | D3D11_CPU_ACCESS_WRITE)
                         : 0;
-                texDesc.MiscFlags = GetMiscFlags(pDesc);
-
-                Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
-                HRESULT hr = m_device->GetD3D11Device()->CreateTexture2D(
-                    &texDesc, nullptr, &texture);
-                if (FAILED(hr)) {
-                    ERR("Failed to create texture 2D, hr %#x.", hr);
-                    return;
-                }
-                m_resource = texture;
-                StoreInDeviceMap();
+                texDesc.MiscFlags = miscFlags;
+
+                m_d3d11Dimension = D3D11_RESOURCE_DIMENSION_TEXTURE2D;
+                m_d3d11Size = EstimateTextureSize(
+                    texDesc.Width, texDesc.Height, 1, texDesc.ArraySize,
+                    texDesc.MipLevels, texDesc.Format,
+                    texDesc.SampleDesc.Count);
+                hr = m_device->GetD3D11Device()->CreateTexture2D(
+                    &texDesc, nullptr, nullptr);
                 break;
             }
             case D3D12_RESOURCE_DIMENSION_TEXTURE3D: {
                 TRACE("D3D12_RESOURCE_DIMENSION_TEXTURE3D match");
-                D3D11_TEXTURE3D_DESC texDesc = {};
+                D3D11_TEXTURE3D_DESC& texDesc = m_d3d11Desc.texture3D;
                 texDesc.Width = static_cast<UINT>(pDesc->Width);
                 texDesc.Height = pDesc->Height;
                 texDesc.Depth = pDesc->DepthOrArraySize;
@@ -190,17 +311,14 @@ WrappedD3D12ToD3D11Resource::WrappedD3D12ToD3D11Resource(
                     : (GetD3D11Usage(pHeapProperties) == D3D11_USAGE_STAGING)
                         ? (D3D11_CPU_ACCESS_READ | D3D11_CPU_ACCESS_WRITE)
                         : 0;
-                texDesc.MiscFlags = GetMiscFlags(pDesc);
-
-                Microsoft::WRL::ComPtr<ID3D11Texture3D> texture;
-                HRESULT hr = m_device->GetD3D11Device()->CreateTexture3D(
-                    &texDesc, nullptr, &texture);
-                if (FAILED(hr)) {
-                    ERR("Failed to create texture 3D, hr %#x.", hr);
-                    return;
-                }
-                m_resource = texture;
-                StoreInDeviceMap();
+                texDesc.MiscFlags = miscFlags;
+
+                m_d3d11Dimension = D3D11_RESOURCE_DIMENSION_TEXTURE3D;
+                m_d3d11Size = EstimateTextureSize(
+                    texDesc.Width, texDesc.Height, texDesc.Depth, 1,
+                    texDesc.MipLevels, texDesc.Format, 1);
+                hr = m_device->GetD3D11Device()->CreateTexture3D(
+                    &texDesc, nullptr, nullptr);
                 break;
             }
             default:
@@ -209,9 +327,130 @@ WrappedD3D12ToD3D11Resource::WrappedD3D12ToD3D11Resource(
         }
     }
 
+    if (FAILED(hr)) {
+        ERR("Invalid D3D11 desc for resource %p, hr %#x.", this, hr);
+        m_d3d11Dimension = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+        return;
+    }
+
     TRACE(
         "Creating resource type=%d, format=%d, width=%llu, height=%u, this=%p",
         m_desc.Dimension, m_desc.Format, m_desc.Width, m_desc.Height, this);
+
+    // The D3D11 resource is normally created on first use
+    if (!Config::Instance().LazyResources() && !Materialize()) {
+        m_d3d11Dimension = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+    }
+}
+
+ID3D11Resource* WrappedD3D12ToD3D11Resource::Materialize() {
+    std::lock_guard<std::mutex> lock(m_materializeMutex);
+    if (m_materialized.load() ||
+        m_d3d11Dimension == D3D11_RESOURCE_DIMENSION_UNKNOWN) {
+        return m_resource.Get();
+    }
+
+    ID3D11Device* d3d11Device = m_device->GetD3D11Device();
+    Microsoft::WRL::ComPtr<ID3D11Resource> recycled;
+    HRESULT hr = E_FAIL;
+
+    switch (m_d3d11Dimension) {
+        case D3D11_RESOURCE_DIMENSION_BUFFER: {
+            const D3D11_BUFFER_DESC& desc = m_d3d11Desc.buffer;
+            Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+            recycled = AcquireTransient(TransientKey::FromDesc(desc));
+            hr = recycled ? recycled.As(&buffer)
+                          : d3d11Device->CreateBuffer(&desc, nullptr, &buffer);
+            if (FAILED(hr)) {
+                ERR("Failed to create D3D11 buffer, hr %#x", hr);
+                return nullptr;
+            }
+
+            if (m_useUploadRing) {
+                m_uploadRing = UploadRing::Create(d3d11Device, buffer.Get());
+                if (!m_uploadRing) {
+                    ERR("Failed to create upload ring for buffer %p",
+                        buffer.Get());
+                    return nullptr;
+                }
+
+                // A recycled buffer still holds its previous owner's data
+                if (recycled) {
+                    m_uploadRing->MarkAllDirty();
+                    m_device->GetUploadRingManager()->Activate(
+                        m_uploadRing.get());
+                }
+            }
+            m_resource = buffer;
+            break;
+        }
+        case D3D11_RESOURCE_DIMENSION_TEXTURE1D: {
+            const D3D11_TEXTURE1D_DESC& desc = m_d3d11Desc.texture1D;
+            Microsoft::WRL::ComPtr<ID3D11Texture1D> texture;
+            recycled = AcquireTransient(TransientKey::FromDesc(desc));
+            hr = recycled
+                     ? recycled.As(&texture)
+                     : d3d11Device->CreateTexture1D(&desc, nullptr, &texture);
+            if (FAILED(hr)) {
+                ERR("Failed to create texture 1D, hr %#x.", hr);
+                return nullptr;
+            }
+            m_resource = texture;
+            break;
+        }
+        case D3D11_RESOURCE_DIMENSION_TEXTURE2D: {
+            const D3D11_TEXTURE2D_DESC& desc = m_d3d11Desc.texture2D;
+            Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+            recycled = AcquireTransient(TransientKey::FromDesc(desc));
+            hr = recycled
+                     ? recycled.As(&texture)
+                     : d3d11Device->CreateTexture2D(&desc, nullptr, &texture);
+            if (FAILED(hr)) {
+                ERR("Failed to create texture 2D, hr %#x.", hr);
+                return nullptr;
+            }
+            m_resource = texture;
+            break;
+        }
+        case D3D11_RESOURCE_DIMENSION_TEXTURE3D: {
+            const D3D11_TEXTURE3D_DESC& desc = m_d3d11Desc.texture3D;
+            Microsoft::WRL::ComPtr<ID3D11Texture3D> texture;
+            recycled = AcquireTransient(TransientKey::FromDesc(desc));
+            hr = recycled
+                     ? recycled.As(&texture)
+                     : d3d11Device->CreateTexture3D(&desc, nullptr, &texture);
+            if (FAILED(hr)) {
+                ERR("Failed to create texture 3D, hr %#x.", hr);
+                return nullptr;
+            }
+            m_resource = texture;
+            break;
+        }
+        default:
+            return nullptr;
+    }
+
+    AttachBackPointer();
+
+    // Replay private data set while the resource did not exist yet
+    for (const PendingPrivateData& data : m_pendingPrivateData) {
+        m_resource->SetPrivateData(data.guid,
+                                   static_cast<UINT>(data.bytes.size()),
+                                   data.bytes.data());
+    }
+    m_pendingPrivateData.clear();
+
+    m_device->GetResidencyManager()->Register(this, m_resource.Get(),
+                                              m_d3d11Size);
+    if (!m_reserved) {
+        MemoryStats::Instance().Add(
+            GetHeapMemoryCategory(m_heapProperties.Type), m_d3d11Size);
+    }
+
+    TRACE("Materialized D3D11 resource %p for %p, %llu bytes%s",
+          m_resource.Get(), this, m_d3d11Size, recycled ? " (recycled)" : "");
+    m_materialized.store(true);
+    return m_resource.Get();
 }
 
 WrappedD3D12ToD3D11Resource::WrappedD3D12ToD3D11Resource(
@@ -228,12 +467,35 @@ WrappedD3D12ToD3D11Resource::WrappedD3D12ToD3D11Resource(
       m_isUAV(false),
       m_format(pDesc->Format) {
     if (resource) {
-        StoreInDeviceMap();
+        AttachBackPointer();
+        m_materialized.store(true);
     }
 }
 
 WrappedD3D12ToD3D11Resource::~WrappedD3D12ToD3D11Resource() {
     TRACE("Destroying resource this=%p", this);
+    m_device->GetResidencyManager()->Unregister(this);
+    if (m_uploadRing) {
+        m_device->GetUploadRingManager()->Remove(m_uploadRing.get());
+    }
+    if (!m_readbackShadow.empty()) {
+        m_device->GetReadbackManager()->Cancel(this);
+        MemoryStats::Instance().Remove(MemoryCategory::ReadbackShadow,
+                                       m_readbackShadow.size());
+    }
+    if (m_materialized.load() && !m_reserved) {
+        MemoryStats::Instance().Remove(
+            GetHeapMemoryCategory(m_heapProperties.Type), m_d3d11Size);
+    }
+    // Recycled or externally owned resources outlive the wrapper. Another
+    // wrapper may have taken the resource over since, leave its pointer be.
+    if (m_resource && FromD3D11Resource(m_resource.Get()) == this) {
+        m_resource->SetPrivateData(kWrapperBackPointerGuid, 0, nullptr);
+    }
+    if (m_transient && m_resource) {
+        m_device->GetTransientPool()->Release(m_transientKey, m_resource.Get(),
+                                              m_d3d11Size);
+    }
   // Free the GPU virtual address
     D3D12_GPU_VIRTUAL_ADDRESS address = m_device->GetGPUVAManager()->GetGPUVirtualAddressFromResource(this);
     if (address != 0) {
@@ -241,6 +503,40 @@ WrappedD3D12ToD3D11Resource::~WrappedD3D12ToD3D11Resource() {
     }
 }
 
+bool WrappedD3D12ToD3D11Resource::IsTransientEligible() const {
+    if (m_reserved || (m_heapFlags & D3D12_HEAP_FLAG_SHARED)) {
+        return false;
+    }
+
+    // Upload rings overwrite the whole recycled buffer on first flush
+    if (m_heapProperties.Type == D3D12_HEAP_TYPE_UPLOAD) {
+        return m_desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER;
+    }
+    if (m_heapProperties.Type != D3D12_HEAP_TYPE_DEFAULT) {
+        return false;
+    }
+
+    // Otherwise committed memory must read as zero, unless the app opted
+    // out or the resource has to be cleared, discarded or copied to first
+    if (m_heapFlags & kHeapFlagCreateNotZeroed) {
+        return true;
+    }
+    return m_desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER &&
+           (m_desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET |
+                            D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL));
+}
+
+Microsoft::WRL::ComPtr<ID3D11Resource>
+WrappedD3D12ToD3D11Resource::AcquireTransient(const TransientKey& key) {
+    if (!IsTransientEligible()) {
+        return nullptr;
+    }
+
+    m_transient = true;
+    m_transientKey = key;
+    return m_device->GetTransientPool()->Acquire(key);
+}
+
 D3D12_GPU_VIRTUAL_ADDRESS WrappedD3D12ToD3D11Resource::GetGPUVirtualAddress() {
     TRACE("GetGPUVirtualAddress called for resource %p", this);
     D3D12_GPU_VIRTUAL_ADDRESS address = m_device->GetGPUVAManager()->AllocateGPUVirtualAddress(this);
@@ -248,25 +544,30 @@ D3D12_GPU_VIRTUAL_ADDRESS WrappedD3D12ToD3D11Resource::GetGPUVirtualAddress() {
     return address;
 }
 
-void WrappedD3D12ToD3D11Resource::StoreInDeviceMap() {
-    TRACE("StoreInDeviceMap for resource %p, type: %d", this, m_desc.Dimension);
+void WrappedD3D12ToD3D11Resource::AttachBackPointer() {
+    WrappedD3D12ToD3D11Resource* self = this;
+    HRESULT hr = m_resource->SetPrivateData(kWrapperBackPointerGuid,
+                                            sizeof(self), &self);
+    if (FAILED(hr)) {
+        ERR("Failed to attach wrapper %p to %p, hr %#x", this,
+            m_resource.Get(), hr);
+    }
+}
 
-    // Store D3D11<->D3D12 resource mapping
-    Microsoft::WRL::ComPtr<ID3D11Resource> d3d11Resource;
-    if (SUCCEEDED(m_resource.As(&d3d11Resource))) {
-        m_device->StoreD3D11ResourceMapping(this, d3d11Resource.Get());
+WrappedD3D12ToD3D11Resource* WrappedD3D12ToD3D11Resource::FromD3D11Resource(
+    ID3D11Resource* resource) {
+    if (!resource) {
+        return nullptr;
+    }
 
-        // Extra debug info for buffers
-        if (m_desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER) {
-            Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
-            if (SUCCEEDED(m_resource.As(&buffer))) {
-                D3D11_BUFFER_DESC desc = {};
-                buffer->GetDesc(&desc);
-                TRACE("  Buffer info - BindFlags: %u, ByteWidth: %u, Usage: %d",
-                      desc.BindFlags, desc.ByteWidth, desc.Usage);
-            }
-        }
+    WrappedD3D12ToD3D11Resource* wrapper = nullptr;
+    UINT size = sizeof(wrapper);
+    if (FAILED(resource->GetPrivateData(kWrapperBackPointerGuid, &size,
+                                        &wrapper)) ||
+        size != sizeof(wrapper)) {
+        return nullptr;
     }
+    return wrapper;
 }
 
 UINT WrappedD3D12ToD3D11Resource::GetMiscFlags(
@@ -525,10 +826,10 @@ HRESULT WrappedD3D12ToD3D11Resource::QueryInterface(REFIID riid,
 
     // Handle D3D11 resource mapping interface
     if (riid == __uuidof(ID3D11Resource)) {
-        if (m_resource) {
-            m_resource->AddRef();  // AddRef on the underlying resource instead
-                                   // of the wrapper
-            *ppvObject = m_resource.Get();
+        if (ID3D11Resource* resource = GetD3D11Resource()) {
+            resource->AddRef();  // AddRef on the underlying resource instead
+                                 // of the wrapper
+            *ppvObject = resource;
             return S_OK;
         }
     }
@@ -558,6 +859,37 @@ HRESULT WrappedD3D12ToD3D11Resource::GetPrivateData(REFGUID guid,
                                                     void* pData) {
     TRACE("WrappedD3D12ToD3D11Resource::GetPrivateData called: %s, %p, %p",
           debugstr_guid(&guid).c_str(), pDataSize, pData);
+
+    {
+        std::lock_guard<std::mutex> lock(m_materializeMutex);
+        if (!m_materialized.load()) {
+            if (!pDataSize) {
+                return E_INVALIDARG;
+            }
+
+            auto it = std::find_if(m_pendingPrivateData.begin(),
+                                   m_pendingPrivateData.end(),
+                                   [&guid](const PendingPrivateData& data) {
+                                       return data.guid == guid;
+                                   });
+            if (it == m_pendingPrivateData.end()) {
+                *pDataSize = 0;
+                return DXGI_ERROR_NOT_FOUND;
+            }
+
+            UINT size = static_cast<UINT>(it->bytes.size());
+            if (pData && *pDataSize < size) {
+                *pDataSize = size;
+                return DXGI_ERROR_MORE_DATA;
+            }
+            if (pData) {
+                memcpy(pData, it->bytes.data(), size);
+            }
+            *pDataSize = size;
+            return S_OK;
+        }
+    }
+
     return m_resource->GetPrivateData(guid, pDataSize, pData);
 }
 
@@ -565,6 +897,27 @@ HRESULT WrappedD3D12ToD3D11Resource::SetPrivateData(REFGUID guid, UINT DataSize,
                                                     const void* pData) {
     TRACE("WrappedD3D12ToD3D11Resource::SetPrivateData %s, %u, %p",
           debugstr_guid(&guid).c_str(), DataSize, pData);
+
+    {
+        // Names and tags alone shouldn't force the resource into existence
+        std::lock_guard<std::mutex> lock(m_materializeMutex);
+        if (!m_materialized.load()) {
+            m_pendingPrivateData.erase(
+                std::remove_if(m_pendingPrivateData.begin(),
+                               m_pendingPrivateData.end(),
+                               [&guid](const PendingPrivateData& data) {
+                                   return data.guid == guid;
+                               }),
+                m_pendingPrivateData.end());
+            if (pData && DataSize) {
+                const uint8_t* bytes = static_cast<const uint8_t*>(pData);
+                m_pendingPrivateData.push_back(
+                    {guid, std::vector<uint8_t>(bytes, bytes + DataSize)});
+            }
+            return S_OK;
+        }
+    }
+
     return m_resource->SetPrivateData(guid, DataSize, pData);
 }
 
@@ -572,12 +925,17 @@ HRESULT WrappedD3D12ToD3D11Resource::SetPrivateDataInterface(
     REFGUID guid, const IUnknown* pData) {
     TRACE("WrappedD3D12ToD3D11Resource::SetPrivateDataInterface %s, %p",
           debugstr_guid(&guid).c_str(), pData);
-    return m_resource->SetPrivateDataInterface(guid, pData);
+
+    ID3D11Resource* resource = GetD3D11Resource();
+    if (!resource) {
+        return E_FAIL;
+    }
+    return resource->SetPrivateDataInterface(guid, pData);
 }
 
 HRESULT WrappedD3D12ToD3D11Resource::SetName(LPCWSTR Name) {
     TRACE("WrappedD3D12ToD3D11Resource::SetName %s", debugstr_w(Name).c_str());
-    return m_resource->SetPrivateData(
+    return SetPrivateData(
         WKPDID_D3DDebugObjectName,
         static_cast<UINT>((wcslen(Name) + 1) * sizeof(WCHAR)), Name);
 }
@@ -601,6 +959,28 @@ HRESULT WrappedD3D12ToD3D11Resource::Map(UINT Subresource,
         return E_INVALIDARG;
     }
 
+    // Readback buffers are served from their shadow, everything else needs
+    // the D3D11 resource from here on
+    if (m_readbackShadow.empty() && !GetD3D11Resource()) {
+        ERR("Failed to create D3D11 resource for Map");
+        return E_OUTOFMEMORY;
+    }
+
+    if (m_uploadRing) {
+        *ppData = m_uploadRing->Map();
+        m_device->GetUploadRingManager()->Activate(m_uploadRing.get());
+        TRACE("Mapped upload shadow at %p", *ppData);
+        return S_OK;
+    }
+
+    if (!m_readbackShadow.empty()) {
+        // Only waits for the submissions that copied into this buffer
+        m_device->GetReadbackManager()->Resolve(this);
+        *ppData = m_readbackShadow.data();
+        TRACE("Mapped readback shadow at %p", *ppData);
+        return S_OK;
+    }
+
     D3D11_MAPPED_SUBRESOURCE mappedResource;
     D3D11_MAP mapType;
 
@@ -638,6 +1018,19 @@ void WrappedD3D12ToD3D11Resource::Unmap(UINT Subresource,
                                         const D3D12_RANGE* pWrittenRange) {
     TRACE("WrappedD3D12ToD3D11Resource::Unmap %u, %p", Subresource,
           pWrittenRange);
+
+    if (m_uploadRing) {
+        // A null range means the whole resource may have been written
+        m_uploadRing->Unmap(pWrittenRange ? pWrittenRange->Begin : 0,
+                            pWrittenRange ? pWrittenRange->End
+                                          : m_uploadRing->GetSize());
+        return;
+    }
+
+    if (!m_readbackShadow.empty() || !m_materialized.load()) {
+        return;
+    }
+
     m_device->GetD3D11Context()->Unmap(m_resource.Get(), Subresource);
 }
 
@@ -669,8 +1062,54 @@ HRESULT WrappedD3D12ToD3D11Resource::WriteToSubresource(
         "%u, %u",
         DstSubresource, pDstBox, pSrcData, SrcRowPitch, SrcDepthPitch);
 
+    ID3D11Resource* resource = GetD3D11Resource();
+    if (!resource) {
+        ERR("Failed to create D3D11 resource for WriteToSubresource");
+        return E_OUTOFMEMORY;
+    }
+
+    // Write-combined custom heaps are dynamic textures, which only map
+    // with discard and can't take UpdateSubresource. Writes land in a CPU
+    // shadow first so a partial box keeps the texels around it.
+    SubresourceLayout layout = {};
+    if (GetSubresourceLayout(DstSubresource, &layout) &&
+        layout.usage == D3D11_USAGE_DYNAMIC) {
+        UINT64 rowSize = GetFormatRowSize(layout.format, layout.width);
+        UINT rows = GetFormatRowCount(layout.format, layout.height);
+        UINT64 sliceSize = rowSize * rows;
+        std::vector<uint8_t>& shadow = m_dynamicShadows[DstSubresource];
+        shadow.resize(static_cast<size_t>(sliceSize * layout.depth));
+
+        D3D12_BOX box = {0, 0, 0, layout.width, layout.height, layout.depth};
+        if (pDstBox) {
+            box = *pDstBox;
+        }
+        CopySlices(shadow.data() +
+                       GetBoxOffset(layout.format, box,
+                                    static_cast<UINT>(rowSize),
+                                    static_cast<UINT>(sliceSize)),
+                   rowSize, sliceSize, pSrcData, SrcRowPitch, SrcDepthPitch,
+                   GetFormatRowSize(layout.format, box.right - box.left),
+                   GetFormatRowCount(layout.format, box.bottom - box.top),
+                   box.back - box.front, false);
+
+        D3D11_MAPPED_SUBRESOURCE mapped = {};
+        HRESULT hr = m_device->GetD3D11Context()->Map(
+            resource, DstSubresource, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+        if (FAILED(hr)) {
+            ERR("Failed to map subresource %u for writing, hr %#x",
+                DstSubresource, hr);
+            return hr;
+        }
+        CopySlices(mapped.pData, mapped.RowPitch, mapped.DepthPitch,
+                   shadow.data(), rowSize, sliceSize, rowSize, rows,
+                   layout.depth, true);
+        m_device->GetD3D11Context()->Unmap(resource, DstSubresource);
+        return S_OK;
+    }
+
     m_device->GetD3D11Context()->UpdateSubresource(
-        m_resource.Get(), DstSubresource,
+        resource, DstSubresource,
         reinterpret_cast<const D3D11_BOX*>(pDstBox), pSrcData, SrcRowPitch,
         SrcDepthPitch);
 
@@ -683,10 +1122,131 @@ HRESULT WrappedD3D12ToD3D11Resource::ReadFromSubresource(
     TRACE("WrappedD3D12ToD3D11Resource::ReadFromSubresource %p, %u, %u, %u, %p",
           pDstData, DstRowPitch, DstDepthPitch, SrcSubresource, pSrcBox);
 
-    // D3D11 doesn't have a direct equivalent for reading from a subresource
-    // We need to create a staging resource and copy the data
-    FIXME("ReadFromSubresource not implemented yet.");
-    return E_NOTIMPL;
+    if (!pDstData) {
+        return E_INVALIDARG;
+    }
+
+    ID3D11Resource* resource = GetD3D11Resource();
+    if (!resource) {
+        ERR("Failed to create D3D11 resource for ReadFromSubresource");
+        return E_OUTOFMEMORY;
+    }
+
+    SubresourceLayout layout = {};
+    if (!GetSubresourceLayout(SrcSubresource, &layout)) {
+        ERR("ReadFromSubresource on a non-texture resource");
+        return E_INVALIDARG;
+    }
+
+    // CPU-readable textures map directly, the rest go through staging
+    ID3D11DeviceContext* context = m_device->GetD3D11Context();
+    ReadbackManager* readbackManager = m_device->GetReadbackManager();
+    Microsoft::WRL::ComPtr<ID3D11Resource> source = resource;
+    Microsoft::WRL::ComPtr<ID3D11Resource> staging;
+    UINT sourceSubresource = SrcSubresource;
+    if (layout.usage != D3D11_USAGE_STAGING ||
+        !(layout.cpuAccessFlags & D3D11_CPU_ACCESS_READ)) {
+        staging = readbackManager->AcquireStagingTexture(
+            layout.dimension, layout.format, layout.width, layout.height,
+            layout.depth);
+        if (!staging) {
+            return E_OUTOFMEMORY;
+        }
+        source = staging;
+        context->CopySubresourceRegion(source.Get(), 0, 0, 0, 0, resource,
+                                       SrcSubresource, nullptr);
+        sourceSubresource = 0;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    HRESULT hr = context->Map(source.Get(), sourceSubresource,
+                              D3D11_MAP_READ, 0, &mapped);
+    if (FAILED(hr)) {
+        ERR("Failed to map subresource %u for reading, hr %#x",
+            SrcSubresource, hr);
+        readbackManager->ReleaseStaging(staging, 0);
+        return hr;
+    }
+
+    D3D12_BOX box = {0, 0, 0, layout.width, layout.height, layout.depth};
+    if (pSrcBox) {
+        box = *pSrcBox;
+    }
+    CopySlices(pDstData, DstRowPitch, DstDepthPitch,
+               static_cast<const uint8_t*>(mapped.pData) +
+                   GetBoxOffset(layout.format, box, mapped.RowPitch,
+                                mapped.DepthPitch),
+               mapped.RowPitch, mapped.DepthPitch,
+               GetFormatRowSize(layout.format, box.right - box.left),
+               GetFormatRowCount(layout.format, box.bottom - box.top),
+               box.back - box.front, false);
+    context->Unmap(source.Get(), sourceSubresource);
+
+    // The map above already waited for the staging copy
+    readbackManager->ReleaseStaging(staging, 0);
+    return S_OK;
+}
+
+bool WrappedD3D12ToD3D11Resource::GetSubresourceLayout(
+    UINT subresource, SubresourceLayout* layout) {
+    if (!m_resource) {
+        return false;
+    }
+
+    m_resource->GetType(&layout->dimension);
+    UINT mipLevels = 1;
+    switch (layout->dimension) {
+        case D3D11_RESOURCE_DIMENSION_TEXTURE1D: {
+            Microsoft::WRL::ComPtr<ID3D11Texture1D> texture;
+            m_resource.As(&texture);
+            D3D11_TEXTURE1D_DESC desc = {};
+            texture->GetDesc(&desc);
+            mipLevels = desc.MipLevels;
+            layout->format = desc.Format;
+            layout->usage = desc.Usage;
+            layout->cpuAccessFlags = desc.CPUAccessFlags;
+            layout->width = desc.Width;
+            layout->height = 1;
+            layout->depth = 1;
+            break;
+        }
+        case D3D11_RESOURCE_DIMENSION_TEXTURE2D: {
+            Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+            m_resource.As(&texture);
+            D3D11_TEXTURE2D_DESC desc = {};
+            texture->GetDesc(&desc);
+            mipLevels = desc.MipLevels;
+            layout->format = desc.Format;
+            layout->usage = desc.Usage;
+            layout->cpuAccessFlags = desc.CPUAccessFlags;
+            layout->width = desc.Width;
+            layout->height = desc.Height;
+            layout->depth = 1;
+            break;
+        }
+        case D3D11_RESOURCE_DIMENSION_TEXTURE3D: {
+            Microsoft::WRL::ComPtr<ID3D11Texture3D> texture;
+            m_resource.As(&texture);
+            D3D11_TEXTURE3D_DESC desc = {};
+            texture->GetDesc(&desc);
+            mipLevels = desc.MipLevels;
+            layout->format = desc.Format;
+            layout->usage = desc.Usage;
+            layout->cpuAccessFlags = desc.CPUAccessFlags;
+            layout->width = desc.Width;
+            layout->height = desc.Height;
+            layout->depth = desc.Depth;
+            break;
+        }
+        default:
+            return false;
+    }
+
+    UINT mip = subresource % std::max(mipLevels, 1u);
+    layout->width = std::max(layout->width >> mip, 1u);
+    layout->height = std::max(layout->height >> mip, 1u);
+    layout->depth = std::max(layout->depth >> mip, 1u);
+    return true;
 }
 
 HRESULT WrappedD3D12ToD3D11Resource::GetHeapProperties(
@@ -0,0 +1,70 @@
+#include "d3d11_impl/resource_materializer.hpp"
+
+#include "d3d11_impl/resource.hpp"
+
+namespace dxiided {
+
+ResourceMaterializer::ResourceMaterializer() {
+    TRACE("ResourceMaterializer created");
+}
+
+ResourceMaterializer::~ResourceMaterializer() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_queue.clear();
+    }
+    m_cv.notify_all();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+    TRACE("ResourceMaterializer destroyed");
+}
+
+void ResourceMaterializer::Enqueue(WrappedD3D12ToD3D11Resource* resource) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stop) {
+            return;
+        }
+
+        // The worker only starts once something actually needs it
+        if (!m_worker.joinable()) {
+            m_worker = std::thread(&ResourceMaterializer::WorkerMain, this);
+        }
+        m_queue.push_back(resource);
+    }
+    m_cv.notify_one();
+}
+
+void ResourceMaterializer::WorkerMain() {
+    TRACE("Resource materializer thread started");
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop) {
+        if (m_queue.empty()) {
+            m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            continue;
+        }
+
+        Microsoft::WRL::ComPtr<WrappedD3D12ToD3D11Resource> resource =
+            std::move(m_queue.front());
+        m_queue.pop_front();
+        lock.unlock();
+
+        // Skipped if the application released the resource while it was
+        // queued, and a no-op if the application got to it first
+        resource->AddRef();
+        bool released = resource->Release() == 1;
+        if (!released && !resource->Materialize()) {
+            WARN("Background creation of resource %p failed", resource.Get());
+        }
+        resource.Reset();
+
+        lock.lock();
+    }
+
+    TRACE("Resource materializer thread stopped");
+}
+
+}  // namespace dxiided
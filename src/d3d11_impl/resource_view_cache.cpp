@@ -1,9 +1,19 @@
 #include "d3d11_impl/resource_view_cache.hpp"
 
+#include "common/memory_stats.hpp"
 #include "d3d11_impl/resource.hpp"
 
 namespace dxiided {
 
+namespace {
+
+// Approximate footprint of one cached view, not counting the view itself
+constexpr UINT64 kViewEntrySize =
+    sizeof(WrappedD3D12ToD3D11ResourceViewCache::ViewKey) +
+    sizeof(Microsoft::WRL::ComPtr<IUnknown>);
+
+}  // namespace
+
 // Static member initialization
 std::unordered_map<WrappedD3D12ToD3D11ResourceViewCache::ViewKey,
                    Microsoft::WRL::ComPtr<IUnknown>,
@@ -96,6 +106,7 @@ WrappedD3D12ToD3D11ResourceViewCache::GetOrCreateSRV(
     }
 
     s_viewCache[key] = srv;
+    MemoryStats::Instance().Add(MemoryCategory::ViewCache, kViewEntrySize);
     return srv;
 }
 
@@ -131,6 +142,7 @@ WrappedD3D12ToD3D11ResourceViewCache::GetOrCreateRTV(
     }
 
     s_viewCache[key] = rtv;
+    MemoryStats::Instance().Add(MemoryCategory::ViewCache, kViewEntrySize);
     return rtv;
 }
 
@@ -166,6 +178,7 @@ WrappedD3D12ToD3D11ResourceViewCache::GetOrCreateDSV(
     }
 
     s_viewCache[key] = dsv;
+    MemoryStats::Instance().Add(MemoryCategory::ViewCache, kViewEntrySize);
     return dsv;
 }
 
@@ -200,6 +213,7 @@ WrappedD3D12ToD3D11ResourceViewCache::GetOrCreateUAV(
     }
 
     s_viewCache[key] = uav;
+    MemoryStats::Instance().Add(MemoryCategory::ViewCache, kViewEntrySize);
     return uav;
 }
 
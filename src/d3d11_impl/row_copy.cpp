@@ -0,0 +1,157 @@
+#include "d3d11_impl/row_copy.hpp"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "common/debug.hpp"
+
+namespace dxiided {
+
+namespace {
+
+using RowKernel = void (*)(uint8_t* dst, const uint8_t* src, size_t size);
+
+void CopyRowCached(uint8_t* dst, const uint8_t* src, size_t size) {
+    // The CRT memcpy is already vectorized for cacheable memory
+    memcpy(dst, src, size);
+}
+
+// Copies up to the first aligned destination byte, returns bytes left
+size_t CopyHead(uint8_t** dst, const uint8_t** src, size_t size,
+                uintptr_t alignment) {
+    size_t head = (alignment - (reinterpret_cast<uintptr_t>(*dst) &
+                                (alignment - 1))) &
+                  (alignment - 1);
+    head = std::min(head, size);
+    memcpy(*dst, *src, head);
+    *dst += head;
+    *src += head;
+    return size - head;
+}
+
+void CopyRowStreamSse2(uint8_t* dst, const uint8_t* src, size_t size) {
+    size = CopyHead(&dst, &src, size, 16);
+    for (; size >= 64; size -= 64, dst += 64, src += 64) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst), a);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), b);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), c);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), d);
+    }
+    for (; size >= 16; size -= 16, dst += 16, src += 16) {
+        _mm_stream_si128(
+            reinterpret_cast<__m128i*>(dst),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+    }
+    memcpy(dst, src, size);
+}
+
+__attribute__((target("avx2"))) void CopyRowStreamAvx2(uint8_t* dst,
+                                                       const uint8_t* src,
+                                                       size_t size) {
+    size = CopyHead(&dst, &src, size, 32);
+    for (; size >= 128; size -= 128, dst += 128, src += 128) {
+        __m256i a =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        __m256i b =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 32));
+        __m256i c =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 64));
+        __m256i d =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 96));
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(dst), a);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 32), b);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 64), c);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 96), d);
+    }
+    for (; size >= 32; size -= 32, dst += 32, src += 32) {
+        _mm256_stream_si256(
+            reinterpret_cast<__m256i*>(dst),
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)));
+    }
+    memcpy(dst, src, size);
+}
+
+RowKernel SelectStreamKernel() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        TRACE("Using AVX2 streaming row copies");
+        return CopyRowStreamAvx2;
+    }
+    TRACE("Using SSE2 streaming row copies");
+    return CopyRowStreamSse2;
+}
+
+RowKernel GetKernel(bool writeCombined) {
+    static const RowKernel streamKernel = SelectStreamKernel();
+    return writeCombined ? streamKernel : CopyRowCached;
+}
+
+void CopyRowsWith(RowKernel kernel, uint8_t* dst, size_t dstRowPitch,
+                  const uint8_t* src, size_t srcRowPitch, size_t rowSize,
+                  uint32_t rowCount) {
+    // Tightly packed rows collapse into a single copy
+    if (dstRowPitch == rowSize && srcRowPitch == rowSize) {
+        kernel(dst, src, rowSize * rowCount);
+        return;
+    }
+
+    for (uint32_t row = 0; row < rowCount; ++row) {
+        kernel(dst, src, rowSize);
+        dst += dstRowPitch;
+        src += srcRowPitch;
+    }
+}
+
+}  // namespace
+
+void CopyRows(void* dst, size_t dstRowPitch, const void* src,
+              size_t srcRowPitch, size_t rowSize, uint32_t rowCount,
+              bool writeCombined) {
+    if (!rowSize || !rowCount) {
+        return;
+    }
+
+    CopyRowsWith(GetKernel(writeCombined), static_cast<uint8_t*>(dst),
+                 dstRowPitch, static_cast<const uint8_t*>(src), srcRowPitch,
+                 rowSize, rowCount);
+    if (writeCombined) {
+        _mm_sfence();
+    }
+}
+
+void CopySlices(void* dst, size_t dstRowPitch, size_t dstSlicePitch,
+                const void* src, size_t srcRowPitch, size_t srcSlicePitch,
+                size_t rowSize, uint32_t rowCount, uint32_t sliceCount,
+                bool writeCombined) {
+    if (!rowSize || !rowCount || !sliceCount) {
+        return;
+    }
+
+    RowKernel kernel = GetKernel(writeCombined);
+    auto* dstBytes = static_cast<uint8_t*>(dst);
+    auto* srcBytes = static_cast<const uint8_t*>(src);
+    size_t sliceSize = rowSize * rowCount;
+    if (dstRowPitch == rowSize && srcRowPitch == rowSize &&
+        dstSlicePitch == sliceSize && srcSlicePitch == sliceSize) {
+        kernel(dstBytes, srcBytes, sliceSize * sliceCount);
+    } else {
+        for (uint32_t slice = 0; slice < sliceCount; ++slice) {
+            CopyRowsWith(kernel, dstBytes, dstRowPitch, srcBytes,
+                         srcRowPitch, rowSize, rowCount);
+            dstBytes += dstSlicePitch;
+            srcBytes += srcSlicePitch;
+        }
+    }
+    if (writeCombined) {
+        _mm_sfence();
+    }
+}
+
+}  // namespace dxiided
@@ -0,0 +1,54 @@
+#include "d3d11_impl/scratch_buffer_pool.hpp"
+
+#include <algorithm>
+
+#include "common/memory_stats.hpp"
+
+namespace dxiided {
+
+ScratchBufferPool::ScratchBufferPool(ID3D11Device* device)
+    : m_device(device) {
+    TRACE("ScratchBufferPool created");
+}
+
+ScratchBufferPool::~ScratchBufferPool() {
+    TRACE("ScratchBufferPool destroyed, %zu buffers", m_buffers.size());
+    for (const auto& buffer : m_buffers) {
+        MemoryStats::Instance().Remove(MemoryCategory::ScratchBuffers,
+                                       buffer.first);
+    }
+}
+
+ID3D11Buffer* ScratchBufferPool::Acquire(UINT size) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_buffers.lower_bound(size);
+    if (it != m_buffers.end()) {
+        return it->second.Get();
+    }
+
+    UINT bucketSize = kMinBucketSize;
+    while (bucketSize < size && bucketSize < (1u << 31)) {
+        bucketSize <<= 1;
+    }
+    bucketSize = std::max(bucketSize, size);
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = bucketSize;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+
+    Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+    HRESULT hr = m_device->CreateBuffer(&desc, nullptr, &buffer);
+    if (FAILED(hr)) {
+        ERR("Failed to create %u byte scratch buffer, hr %#x", bucketSize,
+            hr);
+        return nullptr;
+    }
+
+    TRACE("Created scratch buffer %p, size %u", buffer.Get(), bucketSize);
+    m_buffers.emplace(bucketSize, buffer);
+    MemoryStats::Instance().Add(MemoryCategory::ScratchBuffers, bucketSize);
+    return buffer.Get();
+}
+
+}  // namespace dxiided
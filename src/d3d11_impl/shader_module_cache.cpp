@@ -0,0 +1,118 @@
+#include "d3d11_impl/shader_module_cache.hpp"
+
+#include "common/memory_stats.hpp"
+
+namespace dxiided {
+
+ShaderModuleCache::ShaderModuleCache(ID3D11Device* device)
+    : m_device(device) {
+    TRACE("ShaderModuleCache created");
+}
+
+ShaderModuleCache::~ShaderModuleCache() {
+    TRACE("ShaderModuleCache destroyed, %zu modules, %llu hits, %llu misses",
+          m_modules.size(), m_hits, m_misses);
+    for (const auto& entry : m_modules) {
+        MemoryStats::Instance().Remove(MemoryCategory::ShaderModules,
+                                       entry.second->bytecodeLength);
+    }
+}
+
+HRESULT ShaderModuleCache::CreateShader(
+    ShaderStage stage, const void* bytecode, SIZE_T length,
+    ID3D11DeviceChild** shader) {
+    switch (stage) {
+        case ShaderStage::Vertex: {
+            Microsoft::WRL::ComPtr<ID3D11VertexShader> vs;
+            HRESULT hr =
+                m_device->CreateVertexShader(bytecode, length, nullptr, &vs);
+            *shader = vs.Detach();
+            return hr;
+        }
+        case ShaderStage::Pixel: {
+            Microsoft::WRL::ComPtr<ID3D11PixelShader> ps;
+            HRESULT hr =
+                m_device->CreatePixelShader(bytecode, length, nullptr, &ps);
+            *shader = ps.Detach();
+            return hr;
+        }
+        case ShaderStage::Geometry: {
+            Microsoft::WRL::ComPtr<ID3D11GeometryShader> gs;
+            HRESULT hr =
+                m_device->CreateGeometryShader(bytecode, length, nullptr, &gs);
+            *shader = gs.Detach();
+            return hr;
+        }
+        case ShaderStage::Hull: {
+            Microsoft::WRL::ComPtr<ID3D11HullShader> hs;
+            HRESULT hr =
+                m_device->CreateHullShader(bytecode, length, nullptr, &hs);
+            *shader = hs.Detach();
+            return hr;
+        }
+        case ShaderStage::Domain: {
+            Microsoft::WRL::ComPtr<ID3D11DomainShader> ds;
+            HRESULT hr =
+                m_device->CreateDomainShader(bytecode, length, nullptr, &ds);
+            *shader = ds.Detach();
+            return hr;
+        }
+        case ShaderStage::Compute: {
+            Microsoft::WRL::ComPtr<ID3D11ComputeShader> cs;
+            HRESULT hr =
+                m_device->CreateComputeShader(bytecode, length, nullptr, &cs);
+            *shader = cs.Detach();
+            return hr;
+        }
+    }
+    return E_INVALIDARG;
+}
+
+HRESULT ShaderModuleCache::GetOrCreate(
+    ShaderStage stage, const void* bytecode, SIZE_T length,
+    std::shared_ptr<const ShaderModule>* module) {
+    if (!bytecode || !length || !module) {
+        return E_INVALIDARG;
+    }
+
+    Key key = {ComputeHash128(bytecode, length), stage};
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_modules.find(key);
+        if (it != m_modules.end()) {
+            m_hits++;
+            *module = it->second;
+            return S_OK;
+        }
+    }
+
+    // Created outside the lock so unrelated shaders compile in parallel
+    auto created = std::make_shared<ShaderModule>();
+    created->stage = stage;
+    created->bytecodeLength = length;
+    HRESULT hr = ValidateDxbc(bytecode, length, &created->container);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    hr = CreateShader(stage, bytecode, length, &created->shader);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto inserted = m_modules.emplace(key, std::move(created));
+    if (inserted.second) {
+        m_misses++;
+        MemoryStats::Instance().Add(MemoryCategory::ShaderModules, length);
+        TRACE("Created shader module %p, stage %u, %zu bytes",
+              inserted.first->second->shader.Get(),
+              static_cast<UINT>(stage), length);
+    } else {
+        // Another thread created the same shader first
+        m_hits++;
+    }
+    *module = inserted.first->second;
+    return S_OK;
+}
+
+}  // namespace dxiided
@@ -0,0 +1,168 @@
+#include "d3d11_impl/state_object_cache.hpp"
+
+#include <mutex>
+
+#include "d3d11_impl/dxbc.hpp"
+
+namespace dxiided {
+
+namespace {
+
+// Field by field, the descs have padding after their UINT8 members
+Hash128 HashBlendDesc(const D3D11_BLEND_DESC& desc) {
+    Hasher128 hasher;
+    hasher.UpdateValue(desc.AlphaToCoverageEnable);
+    hasher.UpdateValue(desc.IndependentBlendEnable);
+    for (const auto& rt : desc.RenderTarget) {
+        hasher.UpdateValue(rt.BlendEnable);
+        hasher.UpdateValue(rt.SrcBlend);
+        hasher.UpdateValue(rt.DestBlend);
+        hasher.UpdateValue(rt.BlendOp);
+        hasher.UpdateValue(rt.SrcBlendAlpha);
+        hasher.UpdateValue(rt.DestBlendAlpha);
+        hasher.UpdateValue(rt.BlendOpAlpha);
+        hasher.UpdateValue(rt.RenderTargetWriteMask);
+    }
+    return hasher.Finalize();
+}
+
+Hash128 HashRasterizerDesc(const D3D11_RASTERIZER_DESC& desc) {
+    Hasher128 hasher;
+    hasher.UpdateValue(desc.FillMode);
+    hasher.UpdateValue(desc.CullMode);
+    hasher.UpdateValue(desc.FrontCounterClockwise);
+    hasher.UpdateValue(desc.DepthBias);
+    hasher.UpdateValue(desc.DepthBiasClamp);
+    hasher.UpdateValue(desc.SlopeScaledDepthBias);
+    hasher.UpdateValue(desc.DepthClipEnable);
+    hasher.UpdateValue(desc.ScissorEnable);
+    hasher.UpdateValue(desc.MultisampleEnable);
+    hasher.UpdateValue(desc.AntialiasedLineEnable);
+    return hasher.Finalize();
+}
+
+void HashStencilOp(Hasher128& hasher, const D3D11_DEPTH_STENCILOP_DESC& op) {
+    hasher.UpdateValue(op.StencilFailOp);
+    hasher.UpdateValue(op.StencilDepthFailOp);
+    hasher.UpdateValue(op.StencilPassOp);
+    hasher.UpdateValue(op.StencilFunc);
+}
+
+Hash128 HashDepthStencilDesc(const D3D11_DEPTH_STENCIL_DESC& desc) {
+    Hasher128 hasher;
+    hasher.UpdateValue(desc.DepthEnable);
+    hasher.UpdateValue(desc.DepthWriteMask);
+    hasher.UpdateValue(desc.DepthFunc);
+    hasher.UpdateValue(desc.StencilEnable);
+    hasher.UpdateValue(desc.StencilReadMask);
+    hasher.UpdateValue(desc.StencilWriteMask);
+    HashStencilOp(hasher, desc.FrontFace);
+    HashStencilOp(hasher, desc.BackFace);
+    return hasher.Finalize();
+}
+
+Hash128 HashInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT count,
+                        const void* vsBytecode, SIZE_T vsLength,
+                        const DxbcChunk& vsSignature) {
+    // A layout works with any shader that has the same input signature
+    Hasher128 hasher;
+    if (vsSignature.data) {
+        hasher.Update(vsSignature.data, vsSignature.size);
+    } else {
+        hasher.Update(vsBytecode, vsLength);
+    }
+
+    hasher.UpdateValue(count);
+    for (UINT i = 0; i < count; ++i) {
+        const D3D11_INPUT_ELEMENT_DESC& element = elements[i];
+        hasher.UpdateString(element.SemanticName);
+        hasher.UpdateValue(element.SemanticIndex);
+        hasher.UpdateValue(element.Format);
+        hasher.UpdateValue(element.InputSlot);
+        hasher.UpdateValue(element.AlignedByteOffset);
+        hasher.UpdateValue(element.InputSlotClass);
+        hasher.UpdateValue(element.InstanceDataStepRate);
+    }
+    return hasher.Finalize();
+}
+
+}  // namespace
+
+StateObjectCache::StateObjectCache(ID3D11Device* device) : m_device(device) {
+    TRACE("StateObjectCache created");
+}
+
+StateObjectCache::~StateObjectCache() {
+    TRACE("StateObjectCache destroyed, %zu blend, %zu rasterizer, "
+          "%zu depth-stencil states, %zu input layouts",
+          m_blendStates.objects.size(), m_rasterizerStates.objects.size(),
+          m_depthStencilStates.objects.size(), m_inputLayouts.objects.size());
+}
+
+template <typename T, typename CreateFn>
+HRESULT StateObjectCache::GetOrCreate(Table<T>& table, const Hash128& key,
+                                      CreateFn create, T** object) {
+    {
+        std::shared_lock<std::shared_mutex> lock(table.mutex);
+        auto it = table.objects.find(key);
+        if (it != table.objects.end()) {
+            return it->second.CopyTo(object);
+        }
+    }
+
+    Microsoft::WRL::ComPtr<T> created;
+    HRESULT hr = create(created.GetAddressOf());
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(table.mutex);
+    auto inserted = table.objects.emplace(key, std::move(created));
+    return inserted.first->second.CopyTo(object);
+}
+
+HRESULT StateObjectCache::GetBlendState(const D3D11_BLEND_DESC& desc,
+                                        ID3D11BlendState** state) {
+    return GetOrCreate(
+        m_blendStates, HashBlendDesc(desc),
+        [&](ID3D11BlendState** created) {
+            return m_device->CreateBlendState(&desc, created);
+        },
+        state);
+}
+
+HRESULT StateObjectCache::GetRasterizerState(
+    const D3D11_RASTERIZER_DESC& desc, ID3D11RasterizerState** state) {
+    return GetOrCreate(
+        m_rasterizerStates, HashRasterizerDesc(desc),
+        [&](ID3D11RasterizerState** created) {
+            return m_device->CreateRasterizerState(&desc, created);
+        },
+        state);
+}
+
+HRESULT StateObjectCache::GetDepthStencilState(
+    const D3D11_DEPTH_STENCIL_DESC& desc, ID3D11DepthStencilState** state) {
+    return GetOrCreate(
+        m_depthStencilStates, HashDepthStencilDesc(desc),
+        [&](ID3D11DepthStencilState** created) {
+            return m_device->CreateDepthStencilState(&desc, created);
+        },
+        state);
+}
+
+HRESULT StateObjectCache::GetInputLayout(
+    const D3D11_INPUT_ELEMENT_DESC* elements, UINT count,
+    const void* vsBytecode, SIZE_T vsLength, const DxbcChunk& vsSignature,
+    ID3D11InputLayout** layout) {
+    return GetOrCreate(
+        m_inputLayouts,
+        HashInputLayout(elements, count, vsBytecode, vsLength, vsSignature),
+        [&](ID3D11InputLayout** created) {
+            return m_device->CreateInputLayout(elements, count, vsBytecode,
+                                               vsLength, created);
+        },
+        layout);
+}
+
+}  // namespace dxiided
@@ -0,0 +1,91 @@
+#include "d3d11_impl/submission_tracker.hpp"
+
+namespace dxiided {
+
+SubmissionTracker::SubmissionTracker(ID3D11Device* device) : m_device(device) {
+    TRACE("SubmissionTracker created for device %p", device);
+}
+
+SubmissionTracker::~SubmissionTracker() {
+    TRACE("SubmissionTracker destroyed, %zu submissions still pending",
+          m_pending.size());
+}
+
+UINT64 SubmissionTracker::Submit(ID3D11DeviceContext* context) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    UINT64 serial = m_nextSerial.fetch_add(1);
+
+    Microsoft::WRL::ComPtr<ID3D11Query> query;
+    if (!m_freeQueries.empty()) {
+        query = std::move(m_freeQueries.back());
+        m_freeQueries.pop_back();
+    } else {
+        D3D11_QUERY_DESC queryDesc = {};
+        queryDesc.Query = D3D11_QUERY_EVENT;
+        HRESULT hr = m_device->CreateQuery(&queryDesc, &query);
+        if (FAILED(hr)) {
+            ERR("Failed to create event query for serial %llu, hr %#x", serial,
+                hr);
+            return serial;
+        }
+    }
+
+    context->End(query.Get());
+    m_pending.push_back({serial, query});
+    TRACE("SubmissionTracker: submitted serial %llu", serial);
+    return serial;
+}
+
+UINT64 SubmissionTracker::Poll(ID3D11DeviceContext* context) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Queries complete in order, so stop at the first one still pending
+    while (!m_pending.empty()) {
+        PendingSubmission& front = m_pending.front();
+        if (front.serial <= m_completedSerial.load()) {
+            m_freeQueries.push_back(std::move(front.query));
+            m_pending.pop_front();
+            continue;
+        }
+
+        HRESULT hr = context->GetData(front.query.Get(), nullptr, 0,
+                                      D3D11_ASYNC_GETDATA_DONOTFLUSH);
+        if (hr != S_OK) {
+            break;
+        }
+
+        MarkCompleted(front.serial);
+        m_freeQueries.push_back(std::move(front.query));
+        m_pending.pop_front();
+    }
+
+    return m_completedSerial.load();
+}
+
+void SubmissionTracker::WaitForSerial(ID3D11DeviceContext* context,
+                                      UINT64 serial) {
+    if (serial <= m_completedSerial.load()) {
+        return;
+    }
+
+    if (serial >= m_nextSerial.load()) {
+        WARN("Waiting for serial %llu which was never submitted", serial);
+        return;
+    }
+
+    TRACE("SubmissionTracker: waiting for serial %llu", serial);
+    context->Flush();
+    while (Poll(context) < serial) {
+        Sleep(0);
+    }
+}
+
+void SubmissionTracker::MarkCompleted(UINT64 serial) {
+    UINT64 completed = m_completedSerial.load();
+    while (serial > completed &&
+           !m_completedSerial.compare_exchange_weak(completed, serial)) {
+    }
+}
+
+}  // namespace dxiided
@@ -0,0 +1,123 @@
+#include "d3d11_impl/tile_pool.hpp"
+
+#include <algorithm>
+#include <climits>
+
+#include "common/memory_stats.hpp"
+
+namespace dxiided {
+
+TilePoolManager::TilePoolManager(ID3D11Device* device,
+                                 ID3D11DeviceContext* context) {
+    D3D11_FEATURE_DATA_D3D11_OPTIONS1 options = {};
+    if (FAILED(device->QueryInterface(IID_PPV_ARGS(&m_device2))) ||
+        FAILED(context->QueryInterface(IID_PPV_ARGS(&m_context2))) ||
+        FAILED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS1,
+                                           &options, sizeof(options)))) {
+        WARN("ID3D11Device2 unavailable, tiled resources disabled");
+        return;
+    }
+
+    m_tier = options.TiledResourcesTier;
+    TRACE("TilePoolManager created, tiled resources tier %d", m_tier);
+}
+
+TilePoolManager::~TilePoolManager() {
+    TRACE("TilePoolManager destroyed, %u tiles, %zu free ranges", m_poolTiles,
+          m_freeTiles.GetFreeRangeCount());
+    MemoryStats::Instance().Remove(
+        MemoryCategory::TilePool, static_cast<UINT64>(m_poolTiles) * kTileSize);
+}
+
+ID3D11Buffer* TilePoolManager::GetTilePool() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pool.Get();
+}
+
+UINT TilePoolManager::GetTileCount(ID3D11Resource* resource) {
+    UINT tileCount = 0;
+    UINT subresourceTilings = 0;
+    m_device2->GetResourceTiling(resource, &tileCount, nullptr, nullptr,
+                                 &subresourceTilings, 0, nullptr);
+    return tileCount;
+}
+
+HRESULT TilePoolManager::GrowLocked(UINT minTiles) {
+    UINT64 newTiles = std::max<UINT64>(
+        {static_cast<UINT64>(m_poolTiles) * 2,
+         static_cast<UINT64>(m_poolTiles) + minTiles, kMinPoolTiles});
+    newTiles = std::min<UINT64>(newTiles, UINT_MAX);
+    if (newTiles - m_poolTiles < minTiles) {
+        ERR("Tile pool can't grow by %u tiles.", minTiles);
+        return E_OUTOFMEMORY;
+    }
+
+    UINT64 newSize = newTiles * kTileSize;
+    HRESULT hr = S_OK;
+    if (!m_pool) {
+        // ByteWidth is 32 bits, anything beyond goes through a resize
+        D3D11_BUFFER_DESC desc = {};
+        desc.ByteWidth = static_cast<UINT>(
+            std::min<UINT64>(newSize, UINT_MAX / kTileSize * kTileSize));
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.MiscFlags = D3D11_RESOURCE_MISC_TILE_POOL;
+        hr = m_device2->CreateBuffer(&desc, nullptr, &m_pool);
+        if (SUCCEEDED(hr) && desc.ByteWidth < newSize) {
+            hr = m_context2->ResizeTilePool(m_pool.Get(), newSize);
+        }
+    } else {
+        hr = m_context2->ResizeTilePool(m_pool.Get(), newSize);
+    }
+    if (FAILED(hr)) {
+        ERR("Failed to grow tile pool to %llu bytes, hr %#x", newSize, hr);
+        return hr;
+    }
+
+    TRACE("Tile pool grown from %u to %llu tiles", m_poolTiles, newTiles);
+    UINT oldTiles = m_poolTiles;
+    m_poolTiles = static_cast<UINT>(newTiles);
+    MemoryStats::Instance().Add(
+        MemoryCategory::TilePool,
+        static_cast<UINT64>(m_poolTiles - oldTiles) * kTileSize);
+    m_freeTiles.AddFree(oldTiles, m_poolTiles - oldTiles);
+    return S_OK;
+}
+
+HRESULT TilePoolManager::Allocate(UINT tileCount, UINT* firstTile) {
+    if (!IsSupported()) {
+        return E_NOTIMPL;
+    }
+    if (!tileCount || !firstTile) {
+        return E_INVALIDARG;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_freeTiles.Allocate(tileCount, firstTile)) {
+        // Growth extends the free tail, which then fits
+        HRESULT hr = GrowLocked(tileCount);
+        if (FAILED(hr)) {
+            return hr;
+        }
+        m_freeTiles.Allocate(tileCount, firstTile);
+    }
+
+    TRACE("Allocated tiles [%u, %u) of %u", *firstTile,
+          *firstTile + tileCount, m_poolTiles);
+    return S_OK;
+}
+
+void TilePoolManager::Free(UINT firstTile, UINT tileCount) {
+    if (!tileCount) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_freeTiles.AddFree(firstTile, tileCount);
+
+    TRACE("Freed tiles [%u, %u), %zu free ranges", firstTile,
+          firstTile + tileCount, m_freeTiles.GetFreeRangeCount());
+}
+
+}  // namespace dxiided
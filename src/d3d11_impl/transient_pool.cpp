@@ -0,0 +1,222 @@
+#include "d3d11_impl/transient_pool.hpp"
+
+#include "common/memory_stats.hpp"
+#include "d3d11_impl/submission_tracker.hpp"
+
+namespace dxiided {
+
+TransientKey TransientKey::FromDesc(const D3D11_BUFFER_DESC& desc) {
+    TransientKey key;
+    key.dimension = D3D11_RESOURCE_DIMENSION_BUFFER;
+    key.width = desc.ByteWidth;
+    key.usage = desc.Usage;
+    key.bindFlags = desc.BindFlags;
+    key.cpuAccessFlags = desc.CPUAccessFlags;
+    key.miscFlags = desc.MiscFlags;
+    key.structureByteStride = desc.StructureByteStride;
+    return key;
+}
+
+TransientKey TransientKey::FromDesc(const D3D11_TEXTURE1D_DESC& desc) {
+    TransientKey key;
+    key.dimension = D3D11_RESOURCE_DIMENSION_TEXTURE1D;
+    key.width = desc.Width;
+    key.depthOrArraySize = desc.ArraySize;
+    key.mipLevels = desc.MipLevels;
+    key.format = desc.Format;
+    key.usage = desc.Usage;
+    key.bindFlags = desc.BindFlags;
+    key.cpuAccessFlags = desc.CPUAccessFlags;
+    key.miscFlags = desc.MiscFlags;
+    return key;
+}
+
+TransientKey TransientKey::FromDesc(const D3D11_TEXTURE2D_DESC& desc) {
+    TransientKey key;
+    key.dimension = D3D11_RESOURCE_DIMENSION_TEXTURE2D;
+    key.width = desc.Width;
+    key.height = desc.Height;
+    key.depthOrArraySize = desc.ArraySize;
+    key.mipLevels = desc.MipLevels;
+    key.format = desc.Format;
+    key.sampleCount = desc.SampleDesc.Count;
+    key.sampleQuality = desc.SampleDesc.Quality;
+    key.usage = desc.Usage;
+    key.bindFlags = desc.BindFlags;
+    key.cpuAccessFlags = desc.CPUAccessFlags;
+    key.miscFlags = desc.MiscFlags;
+    return key;
+}
+
+TransientKey TransientKey::FromDesc(const D3D11_TEXTURE3D_DESC& desc) {
+    TransientKey key;
+    key.dimension = D3D11_RESOURCE_DIMENSION_TEXTURE3D;
+    key.width = desc.Width;
+    key.height = desc.Height;
+    key.depthOrArraySize = desc.Depth;
+    key.mipLevels = desc.MipLevels;
+    key.format = desc.Format;
+    key.usage = desc.Usage;
+    key.bindFlags = desc.BindFlags;
+    key.cpuAccessFlags = desc.CPUAccessFlags;
+    key.miscFlags = desc.MiscFlags;
+    return key;
+}
+
+bool TransientKey::operator==(const TransientKey& other) const {
+    return dimension == other.dimension && width == other.width &&
+           height == other.height &&
+           depthOrArraySize == other.depthOrArraySize &&
+           mipLevels == other.mipLevels && format == other.format &&
+           sampleCount == other.sampleCount &&
+           sampleQuality == other.sampleQuality && usage == other.usage &&
+           bindFlags == other.bindFlags &&
+           cpuAccessFlags == other.cpuAccessFlags &&
+           miscFlags == other.miscFlags &&
+           structureByteStride == other.structureByteStride;
+}
+
+size_t TransientKeyHash::operator()(const TransientKey& key) const {
+    const UINT fields[] = {static_cast<UINT>(key.dimension),
+                           key.width,
+                           key.height,
+                           key.depthOrArraySize,
+                           key.mipLevels,
+                           static_cast<UINT>(key.format),
+                           key.sampleCount,
+                           key.sampleQuality,
+                           static_cast<UINT>(key.usage),
+                           key.bindFlags,
+                           key.cpuAccessFlags,
+                           key.miscFlags,
+                           key.structureByteStride};
+
+    // FNV-1a over the desc fields
+    UINT64 hash = 14695981039346656037ull;
+    for (UINT field : fields) {
+        hash = (hash ^ field) * 1099511628211ull;
+    }
+    return static_cast<size_t>(hash);
+}
+
+TransientResourcePool::TransientResourcePool(SubmissionTracker* tracker)
+    : m_tracker(tracker) {
+    TRACE("TransientResourcePool created");
+}
+
+TransientResourcePool::~TransientResourcePool() {
+    TRACE("TransientResourcePool destroyed: %llu hits, %llu misses, "
+          "%llu evictions, %zu resources still pooled",
+          m_hits, m_misses, m_evictions, m_pooledCount);
+    MemoryStats::Instance().Remove(MemoryCategory::TransientPool,
+                                   m_pooledBytes);
+}
+
+Microsoft::WRL::ComPtr<ID3D11Resource> TransientResourcePool::Acquire(
+    const TransientKey& key) {
+    UINT64 completed = m_tracker->GetCompletedSerial();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+
+    // Entries are in release order, so the front is the first to retire
+    if (it == m_entries.end() || it->second.empty() ||
+        it->second.front().releaseSerial > completed) {
+        m_misses++;
+        return nullptr;
+    }
+
+    Entry entry = std::move(it->second.front());
+    it->second.pop_front();
+    if (it->second.empty()) {
+        m_entries.erase(it);
+    }
+
+    m_pooledBytes -= entry.size;
+    m_pooledCount--;
+    m_hits++;
+    MemoryStats::Instance().Remove(MemoryCategory::TransientPool, entry.size);
+    TRACE("Recycled transient resource %p, %llu bytes",
+          entry.resource.Get(), entry.size);
+    return entry.resource;
+}
+
+void TransientResourcePool::Release(const TransientKey& key,
+                                    ID3D11Resource* resource, UINT64 size) {
+    if (!resource || size > kMaxEntryBytes) {
+        return;
+    }
+
+    // Work recorded up to now may still reference the resource
+    UINT64 releaseSerial = m_tracker->GetLastSubmittedSerial();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (m_pooledCount > 0 && m_pooledBytes + size > kMaxPooledBytes) {
+        EvictOldestLocked();
+    }
+
+    m_entries[key].push_back({resource, releaseSerial, size});
+    m_pooledBytes += size;
+    m_pooledCount++;
+    MemoryStats::Instance().Add(MemoryCategory::TransientPool, size);
+}
+
+void TransientResourcePool::Trim(ID3D11DeviceContext* context) {
+    m_tracker->Poll(context);
+    UINT64 submitted = m_tracker->GetLastSubmittedSerial();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        std::deque<Entry>& entries = it->second;
+        while (!entries.empty() &&
+               entries.front().releaseSerial + kMaxAgeSerials < submitted) {
+            m_pooledBytes -= entries.front().size;
+            m_pooledCount--;
+            m_evictions++;
+            MemoryStats::Instance().Remove(MemoryCategory::TransientPool,
+                                           entries.front().size);
+            entries.pop_front();
+        }
+        it = entries.empty() ? m_entries.erase(it) : std::next(it);
+    }
+
+    if (submitted - m_lastReportSerial >= kReportInterval) {
+        m_lastReportSerial = submitted;
+        UINT64 total = m_hits + m_misses;
+        TRACE("Transient pool: %llu/%llu hits (%.1f%%), %zu resources, "
+              "%llu bytes pooled, %llu evictions",
+              m_hits, total, total ? 100.0 * m_hits / total : 0.0,
+              m_pooledCount, m_pooledBytes, m_evictions);
+    }
+}
+
+TransientResourcePool::Stats TransientResourcePool::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return {m_hits, m_misses, m_evictions, m_pooledBytes, m_pooledCount};
+}
+
+void TransientResourcePool::EvictOldestLocked() {
+    auto oldest = m_entries.end();
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (oldest == m_entries.end() ||
+            it->second.front().releaseSerial <
+                oldest->second.front().releaseSerial) {
+            oldest = it;
+        }
+    }
+    if (oldest == m_entries.end()) {
+        return;
+    }
+
+    m_pooledBytes -= oldest->second.front().size;
+    m_pooledCount--;
+    m_evictions++;
+    MemoryStats::Instance().Remove(MemoryCategory::TransientPool,
+                                   oldest->second.front().size);
+    oldest->second.pop_front();
+    if (oldest->second.empty()) {
+        m_entries.erase(oldest);
+    }
+}
+
+}  // namespace dxiided
@@ -0,0 +1,307 @@
+#include "d3d11_impl/upload_ring.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "common/memory_stats.hpp"
+#include "d3d11_impl/submission_tracker.hpp"
+
+namespace dxiided {
+
+namespace {
+
+// Gaps smaller than this between dirty ranges are copied rather than split
+constexpr UINT kDirtyMergeGap = 64 * 1024;
+
+}  // namespace
+
+std::unique_ptr<UploadRing> UploadRing::Create(ID3D11Device* device,
+                                               ID3D11Buffer* target) {
+    if (!device || !target) {
+        ERR("UploadRing::Create: Invalid parameters.");
+        return nullptr;
+    }
+
+    D3D11_BUFFER_DESC desc = {};
+    target->GetDesc(&desc);
+
+    std::unique_ptr<UploadRing> ring(
+        new UploadRing(device, target, desc.ByteWidth));
+
+    // Write watching lets persistently mapped buffers report exactly which
+    // pages the application touched since the last submission
+    ring->m_shadow = static_cast<uint8_t*>(
+        VirtualAlloc(nullptr, desc.ByteWidth,
+                     MEM_RESERVE | MEM_COMMIT | MEM_WRITE_WATCH,
+                     PAGE_READWRITE));
+    if (ring->m_shadow) {
+        SYSTEM_INFO info = {};
+        GetSystemInfo(&info);
+        ring->m_writeWatch = true;
+        ring->m_watchAddresses.resize(
+            (desc.ByteWidth + info.dwPageSize - 1) / info.dwPageSize);
+    } else {
+        WARN("Write watch unavailable, tracking upload writes by range");
+        ring->m_shadow = static_cast<uint8_t*>(VirtualAlloc(
+            nullptr, desc.ByteWidth, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+    }
+
+    if (!ring->m_shadow) {
+        ERR("Failed to allocate %u byte upload shadow.", desc.ByteWidth);
+        return nullptr;
+    }
+
+    MemoryStats::Instance().Add(MemoryCategory::UploadShadow, desc.ByteWidth);
+    TRACE("Created upload ring %p for buffer %p, size %u", ring.get(), target,
+          desc.ByteWidth);
+    return ring;
+}
+
+UploadRing::UploadRing(ID3D11Device* device, ID3D11Buffer* target, UINT size)
+    : m_device(device), m_target(target), m_size(size) {}
+
+UploadRing::~UploadRing() {
+    TRACE("Destroying upload ring %p, %zu versions", this, m_versions.size());
+    if (m_shadow) {
+        VirtualFree(m_shadow, 0, MEM_RELEASE);
+        MemoryStats::Instance().Remove(MemoryCategory::UploadShadow, m_size);
+    }
+    MemoryStats::Instance().Remove(
+        MemoryCategory::UploadStaging,
+        static_cast<UINT64>(m_versions.size()) * m_size);
+}
+
+void* UploadRing::Map() {
+    m_mapCount.fetch_add(1);
+    return m_shadow;
+}
+
+void UploadRing::Unmap(SIZE_T writtenBegin, SIZE_T writtenEnd) {
+    m_mapCount.fetch_sub(1);
+
+    // With write watch the touched pages are already known
+    if (m_writeWatch || writtenEnd <= writtenBegin) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_dirtyMutex);
+    UINT begin = static_cast<UINT>(std::min<SIZE_T>(writtenBegin, m_size));
+    UINT end = static_cast<UINT>(std::min<SIZE_T>(writtenEnd, m_size));
+    if (m_dirtyEnd <= m_dirtyBegin) {
+        m_dirtyBegin = begin;
+        m_dirtyEnd = end;
+    } else {
+        m_dirtyBegin = std::min(m_dirtyBegin, begin);
+        m_dirtyEnd = std::max(m_dirtyEnd, end);
+    }
+}
+
+bool UploadRing::CollectDirtyRanges(std::vector<DirtyRange>* ranges) {
+    ranges->clear();
+
+    if (m_writeWatch) {
+        ULONG_PTR count = m_watchAddresses.size();
+        ULONG granularity = 0;
+        if (GetWriteWatch(WRITE_WATCH_FLAG_RESET, m_shadow, m_size,
+                          m_watchAddresses.data(), &count, &granularity) == 0) {
+            for (ULONG_PTR i = 0; i < count; ++i) {
+                UINT begin = static_cast<UINT>(
+                    static_cast<uint8_t*>(m_watchAddresses[i]) - m_shadow);
+                UINT end =
+                    std::min(begin + static_cast<UINT>(granularity), m_size);
+                ranges->push_back({begin, end});
+            }
+        } else {
+            WARN("GetWriteWatch failed, flushing whole upload buffer");
+            ranges->push_back({0, m_size});
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(m_dirtyMutex);
+        if (IsMapped()) {
+            // Persistently mapped without write watch: assume everything
+            ranges->push_back({0, m_size});
+        } else if (m_dirtyEnd > m_dirtyBegin) {
+            ranges->push_back({m_dirtyBegin, m_dirtyEnd});
+        }
+        m_dirtyBegin = m_dirtyEnd = 0;
+    }
+
+    if (m_flushAll.exchange(false)) {
+        ranges->clear();
+        ranges->push_back({0, m_size});
+    }
+
+    if (ranges->empty()) {
+        return false;
+    }
+
+    // Merge neighbouring ranges so small gaps don't turn into extra copies
+    std::sort(ranges->begin(), ranges->end(),
+              [](const DirtyRange& a, const DirtyRange& b) {
+                  return a.begin < b.begin;
+              });
+    size_t merged = 0;
+    for (size_t i = 1; i < ranges->size(); ++i) {
+        DirtyRange& last = (*ranges)[merged];
+        const DirtyRange& next = (*ranges)[i];
+        if (next.begin <= last.end + kDirtyMergeGap) {
+            last.end = std::max(last.end, next.end);
+        } else {
+            (*ranges)[++merged] = next;
+        }
+    }
+    ranges->resize(merged + 1);
+    return true;
+}
+
+size_t UploadRing::AcquireVersion(ID3D11DeviceContext* context,
+                                  SubmissionTracker* tracker) {
+    UINT64 completed = tracker->Poll(context);
+    size_t index = m_ring.AcquireIdle(completed);
+    if (index != VersionRing::kNoVersion) {
+        return index;
+    }
+
+    if (m_ring.CanGrow()) {
+        D3D11_BUFFER_DESC desc = {};
+        desc.ByteWidth = m_size;
+        desc.Usage = D3D11_USAGE_STAGING;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+        Microsoft::WRL::ComPtr<ID3D11Buffer> staging;
+        HRESULT hr = m_device->CreateBuffer(&desc, nullptr, &staging);
+        if (SUCCEEDED(hr)) {
+            TRACE("Upload ring %p growing to %zu versions", this,
+                  m_versions.size() + 1);
+            m_versions.push_back(staging);
+            MemoryStats::Instance().Add(MemoryCategory::UploadStaging, m_size);
+            return m_ring.Grow();
+        }
+        WARN("Failed to create upload version, hr %#x", hr);
+    }
+
+    // Every version is still in flight, wait for the oldest one
+    index = m_ring.AcquireOldest();
+    if (index == VersionRing::kNoVersion) {
+        ERR("No version of upload ring %p can be waited for", this);
+        return index;
+    }
+    TRACE("Upload ring %p exhausted, waiting for serial %llu", this,
+          m_ring.GetSerial(index));
+    tracker->WaitForSerial(context, m_ring.GetSerial(index));
+    return index;
+}
+
+HRESULT UploadRing::Flush(ID3D11DeviceContext* context,
+                          SubmissionTracker* tracker, size_t* version) {
+    std::vector<DirtyRange> ranges;
+    if (!CollectDirtyRanges(&ranges)) {
+        return S_FALSE;
+    }
+
+    size_t index = AcquireVersion(context, tracker);
+    if (index == VersionRing::kNoVersion) {
+        ERR("No upload version available for ring %p", this);
+        // The write watch was already reset, so copy everything next time
+        m_flushAll.store(true);
+        return E_OUTOFMEMORY;
+    }
+
+    ID3D11Buffer* staging = m_versions[index].Get();
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    HRESULT hr = context->Map(staging, 0, D3D11_MAP_WRITE,
+                              D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+    if (hr == DXGI_ERROR_WAS_STILL_DRAWING) {
+        WARN("Upload version %p still busy, mapping synchronously", staging);
+        hr = context->Map(staging, 0, D3D11_MAP_WRITE, 0, &mapped);
+    }
+    if (FAILED(hr)) {
+        ERR("Failed to map upload version, hr %#x", hr);
+        m_flushAll.store(true);
+        return hr;
+    }
+
+    for (const DirtyRange& range : ranges) {
+        memcpy(static_cast<uint8_t*>(mapped.pData) + range.begin,
+               m_shadow + range.begin, range.end - range.begin);
+    }
+    context->Unmap(staging, 0);
+
+    for (const DirtyRange& range : ranges) {
+        D3D11_BOX box = {range.begin, 0, 0, range.end, 1, 1};
+        context->CopySubresourceRegion(m_target.Get(), 0, range.begin, 0, 0,
+                                       staging, 0, &box);
+    }
+
+    m_ring.MarkFlushed(index);
+    *version = index;
+    TRACE("Flushed %zu dirty ranges of upload ring %p with version %zu",
+          ranges.size(), this, *version);
+    return S_OK;
+}
+
+void UploadRing::MarkSubmitted(size_t version, UINT64 serial) {
+    m_ring.MarkSubmitted(version, serial);
+}
+
+UploadRingManager::UploadRingManager(SubmissionTracker* tracker)
+    : m_tracker(tracker) {
+    TRACE("UploadRingManager created");
+}
+
+UploadRingManager::~UploadRingManager() {
+    TRACE("UploadRingManager destroyed, %zu rings still active",
+          m_active.size());
+}
+
+void UploadRingManager::Activate(UploadRing* ring) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_active.insert(ring);
+}
+
+void UploadRingManager::Remove(UploadRing* ring) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_active.erase(ring);
+    m_unsubmitted.erase(ring);
+}
+
+void UploadRingManager::FlushPending(ID3D11DeviceContext* context,
+                                     std::vector<FlushedVersion>* flushed) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto it = m_active.begin(); it != m_active.end();) {
+        UploadRing* ring = *it;
+        size_t version;
+        HRESULT hr = ring->Flush(context, m_tracker, &version);
+        if (hr == S_OK) {
+            flushed->push_back({ring, version});
+            m_unsubmitted[ring]++;
+        }
+
+        // Persistently mapped rings stay active until they are unmapped,
+        // and rings that failed to flush until a retry gets their writes
+        // through
+        if (ring->IsMapped() || FAILED(hr)) {
+            ++it;
+        } else {
+            it = m_active.erase(it);
+        }
+    }
+}
+
+void UploadRingManager::MarkSubmitted(
+    const std::vector<FlushedVersion>& flushed, UINT64 serial) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const FlushedVersion& entry : flushed) {
+        auto it = m_unsubmitted.find(entry.ring);
+        if (it == m_unsubmitted.end()) {
+            continue;
+        }
+        entry.ring->MarkSubmitted(entry.version, serial);
+        if (--it->second == 0) {
+            m_unsubmitted.erase(it);
+        }
+    }
+}
+
+}  // namespace dxiided
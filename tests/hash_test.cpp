@@ -0,0 +1,101 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "common/hash.hpp"
+#include "test_util.hpp"
+
+using dxiided::ComputeHash128;
+using dxiided::Hash128;
+using dxiided::Hasher128;
+
+namespace {
+
+std::vector<uint8_t> MakeBytes(size_t size, uint32_t seed) {
+    std::vector<uint8_t> bytes(size);
+    for (uint8_t& byte : bytes) {
+        seed = seed * 1664525u + 1013904223u;
+        byte = static_cast<uint8_t>(seed >> 24);
+    }
+    return bytes;
+}
+
+void EmptyInput() {
+    Hash128 empty = Hasher128().Finalize();
+    CHECK(empty.lo == 0 && empty.hi == 0);
+    CHECK(ComputeHash128(nullptr, 0) == empty);
+}
+
+void SplitInvariance() {
+    // Every length around the 16-byte block size, split at every offset
+    for (size_t size = 0; size < 70; ++size) {
+        std::vector<uint8_t> bytes = MakeBytes(size, 7);
+        Hash128 whole = ComputeHash128(bytes.data(), size);
+        for (size_t split = 0; split <= size; ++split) {
+            Hasher128 hasher;
+            hasher.Update(bytes.data(), split);
+            hasher.Update(bytes.data() + split, size - split);
+            CHECK(hasher.Finalize() == whole);
+        }
+
+        Hasher128 bytewise;
+        for (size_t i = 0; i < size; ++i) {
+            bytewise.Update(&bytes[i], 1);
+        }
+        CHECK(bytewise.Finalize() == whole);
+    }
+}
+
+void ContentNotAddress() {
+    // Equal bytecode in two allocations hashes the same
+    std::vector<uint8_t> a = MakeBytes(4096, 3);
+    std::vector<uint8_t> b = a;
+    CHECK(a.data() != b.data());
+    CHECK(ComputeHash128(a.data(), a.size()) ==
+          ComputeHash128(b.data(), b.size()));
+
+    // And any single flipped bit changes it
+    Hash128 original = ComputeHash128(a.data(), a.size());
+    for (size_t bit = 0; bit < 64; ++bit) {
+        std::vector<uint8_t> c = a;
+        size_t index = bit * 61 % c.size();
+        c[index] ^= static_cast<uint8_t>(1u << (bit % 8));
+        CHECK(ComputeHash128(c.data(), c.size()) != original);
+    }
+}
+
+void LengthIsPartOfTheKey() {
+    // Trailing zeros must not collide with the shorter input
+    uint8_t zeros[32] = {};
+    for (size_t size = 0; size < sizeof(zeros); ++size) {
+        CHECK(ComputeHash128(zeros, size) !=
+              ComputeHash128(zeros, size + 1));
+    }
+}
+
+void StringsDontRunTogether() {
+    Hasher128 a;
+    a.UpdateString("ab");
+    a.UpdateString("c");
+    Hasher128 b;
+    b.UpdateString("a");
+    b.UpdateString("bc");
+    CHECK(a.Finalize() != b.Finalize());
+
+    Hasher128 null;
+    null.UpdateString(nullptr);
+    Hasher128 empty;
+    empty.UpdateString("");
+    CHECK(null.Finalize() == empty.Finalize());
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(EmptyInput);
+    RUN_TEST(SplitInvariance);
+    RUN_TEST(ContentNotAddress);
+    RUN_TEST(LengthIsPartOfTheKey);
+    RUN_TEST(StringsDontRunTogether);
+    return dxiided_test::g_failures;
+}
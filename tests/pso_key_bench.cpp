@@ -0,0 +1,179 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/hash.hpp"
+
+using dxiided::Hash128;
+using dxiided::Hash128Hasher;
+using dxiided::Hasher128;
+
+namespace {
+
+// Host-side stand-ins for the parts of D3D12_GRAPHICS_PIPELINE_STATE_DESC
+// the keys read, with the same sizes
+struct Bytecode {
+    const void* data;
+    size_t length;
+};
+
+struct InputElement {
+    const char* semantic;
+    uint32_t fields[6];
+};
+
+struct GraphicsDesc {
+    Bytecode vs, ps, ds, hs, gs;
+    uint8_t blend[328];
+    uint8_t rasterizer[44];
+    uint8_t depthStencil[52];
+    const InputElement* elements;
+    uint32_t elementCount;
+};
+
+constexpr int kShaders = 300;
+constexpr int kPipelines = 2000;
+constexpr int kLoads = 4;
+
+// The key before: the desc bytes, bytecode pointers included, turned into
+// a std::string for std::hash on every lookup
+struct BytesKeyHasher {
+    size_t operator()(const std::vector<uint8_t>& key) const {
+        return std::hash<std::string>()(
+            std::string(key.begin(), key.end()));
+    }
+};
+
+std::vector<uint8_t> BytesKey(const GraphicsDesc& desc) {
+    std::vector<uint8_t> key;
+    auto append = [&key](const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        key.insert(key.end(), bytes, bytes + size);
+    };
+    append(&desc.vs, sizeof(desc.vs) * 5);
+    for (uint32_t i = 0; i < desc.elementCount; ++i) {
+        append(&desc.elements[i], sizeof(desc.elements[i]));
+    }
+    append(desc.blend, sizeof(desc.blend));
+    append(desc.rasterizer, sizeof(desc.rasterizer));
+    append(desc.depthStencil, sizeof(desc.depthStencil));
+    return key;
+}
+
+// The key now: shader contents and state fields in a fixed 128-bit hash
+void HashShader(Hasher128& hasher, const Bytecode& shader) {
+    size_t length = shader.data ? shader.length : 0;
+    hasher.UpdateValue(length);
+    if (length) {
+        hasher.Update(shader.data, length);
+    }
+}
+
+Hash128 ContentKey(const GraphicsDesc& desc) {
+    Hasher128 hasher;
+    HashShader(hasher, desc.vs);
+    HashShader(hasher, desc.ps);
+    HashShader(hasher, desc.ds);
+    HashShader(hasher, desc.hs);
+    HashShader(hasher, desc.gs);
+    hasher.Update(desc.blend, sizeof(desc.blend));
+    hasher.Update(desc.rasterizer, sizeof(desc.rasterizer));
+    hasher.Update(desc.depthStencil, sizeof(desc.depthStencil));
+    hasher.UpdateValue(desc.elementCount);
+    for (uint32_t i = 0; i < desc.elementCount; ++i) {
+        hasher.UpdateString(desc.elements[i].semantic);
+        hasher.UpdateValue(desc.elements[i].fields);
+    }
+    return hasher.Finalize();
+}
+
+// What one level load hands the device: bytecode freshly read from disk
+// into new allocations, and pipelines combining it with varying state
+struct LoadedLevel {
+    std::vector<std::unique_ptr<uint8_t[]>> shaders;
+    std::vector<size_t> shaderSizes;
+    std::vector<GraphicsDesc> pipelines;
+};
+
+LoadedLevel LoadLevel(const InputElement* elements) {
+    LoadedLevel level;
+    uint32_t seed = 12345;
+    auto next = [&seed] {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+
+    for (int i = 0; i < kShaders; ++i) {
+        size_t size = 1024 + next() % (16 * 1024);
+        level.shaders.emplace_back(new uint8_t[size]);
+        for (size_t b = 0; b < size; ++b) {
+            level.shaders.back()[b] = static_cast<uint8_t>(next());
+        }
+        level.shaderSizes.push_back(size);
+    }
+
+    for (int i = 0; i < kPipelines; ++i) {
+        GraphicsDesc desc = {};
+        int vs = next() % (kShaders / 2);
+        int ps = kShaders / 2 + next() % (kShaders / 2);
+        desc.vs = {level.shaders[vs].get(), level.shaderSizes[vs]};
+        desc.ps = {level.shaders[ps].get(), level.shaderSizes[ps]};
+        desc.blend[0] = static_cast<uint8_t>(i);
+        desc.rasterizer[0] = static_cast<uint8_t>(i >> 8);
+        desc.elements = elements;
+        desc.elementCount = 4;
+        level.pipelines.push_back(desc);
+    }
+    return level;
+}
+
+template <typename Map, typename KeyFn>
+void Run(const char* name, KeyFn key) {
+    static const InputElement elements[4] = {
+        {"POSITION", {0, 6, 0, 0, 0, 0}},
+        {"NORMAL", {0, 6, 0, 12, 0, 0}},
+        {"TEXCOORD", {0, 16, 0, 24, 0, 0}},
+        {"TANGENT", {0, 2, 0, 32, 0, 0}},
+    };
+
+    // Older levels stay loaded, as they would across a streaming world
+    std::vector<LoadedLevel> levels;
+    Map cache;
+    size_t hits = 0;
+    size_t lookups = 0;
+    double seconds = 0;
+    for (int load = 0; load < kLoads; ++load) {
+        levels.push_back(LoadLevel(elements));
+
+        auto start = std::chrono::steady_clock::now();
+        for (const GraphicsDesc& desc : levels.back().pipelines) {
+            auto result = cache.emplace(key(desc), 0);
+            hits += result.second ? 0 : 1;
+            ++lookups;
+        }
+        seconds += std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+    }
+
+    std::printf("%-14s %8.0f ns/lookup, %zu of %zu lookups hit, "
+                "%zu entries\n",
+                name, seconds * 1e9 / lookups, hits, lookups, cache.size());
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%d pipelines over %d shaders, loaded %d times\n",
+                kPipelines, kShaders, kLoads);
+    Run<std::unordered_map<std::vector<uint8_t>, int, BytesKeyHasher>>(
+        "pointer bytes", BytesKey);
+    Run<std::unordered_map<Hash128, int, Hash128Hasher>>("content hash",
+                                                          ContentKey);
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include <cstdint>
+
+#include "common/range_allocator.hpp"
+#include "test_util.hpp"
+
+using dxiided::RangeAllocator;
+
+namespace {
+
+// Stands in for the tile pool: growing it hands the new tiles to the
+// allocator the way TilePoolManager::GrowLocked does
+struct MockTilePool {
+    RangeAllocator freeTiles;
+    uint32_t tiles{0};
+    uint32_t grows{0};
+
+    uint32_t Allocate(uint32_t count) {
+        uint32_t first = 0;
+        if (!freeTiles.Allocate(count, &first)) {
+            uint32_t oldTiles = tiles;
+            tiles = tiles * 2 > tiles + count ? tiles * 2 : tiles + count;
+            ++grows;
+            freeTiles.AddFree(oldTiles, tiles - oldTiles);
+            CHECK(freeTiles.Allocate(count, &first));
+        }
+        CHECK(first + count <= tiles);
+        return first;
+    }
+};
+
+void FirstFit() {
+    RangeAllocator allocator;
+    allocator.AddFree(0, 100);
+
+    uint32_t a = 0, b = 0, c = 0;
+    CHECK(allocator.Allocate(10, &a) && a == 0);
+    CHECK(allocator.Allocate(20, &b) && b == 10);
+    CHECK(allocator.Allocate(30, &c) && c == 30);
+
+    // The hole left by b is reused before the tail
+    allocator.AddFree(b, 20);
+    uint32_t d = 0;
+    CHECK(allocator.Allocate(15, &d) && d == 10);
+    CHECK(allocator.GetFreeRangeCount() == 2);
+
+    uint32_t e = 0;
+    CHECK(!allocator.Allocate(41, &e));
+    CHECK(allocator.Allocate(40, &e) && e == 60);
+}
+
+void FreeMergesNeighbours() {
+    RangeAllocator allocator;
+    allocator.AddFree(0, 30);
+
+    uint32_t a = 0, b = 0, c = 0;
+    allocator.Allocate(10, &a);
+    allocator.Allocate(10, &b);
+    allocator.Allocate(10, &c);
+    CHECK(allocator.GetFreeRangeCount() == 0);
+
+    allocator.AddFree(a, 10);
+    allocator.AddFree(c, 10);
+    CHECK(allocator.GetFreeRangeCount() == 2);
+
+    // Freeing the middle joins all three into one range again
+    allocator.AddFree(b, 10);
+    CHECK(allocator.GetFreeRangeCount() == 1);
+    uint32_t all = 0;
+    CHECK(allocator.Allocate(30, &all) && all == 0);
+}
+
+void GrowthExtendsFreeTail() {
+    MockTilePool pool;
+    uint32_t a = pool.Allocate(16);
+    uint32_t b = pool.Allocate(8);
+    CHECK(a == 0 && b == 16);
+    CHECK(pool.grows == 2);
+
+    // The free tail left by growth merges with the new tiles, so a large
+    // request lands right after the live tiles
+    uint32_t c = pool.Allocate(100);
+    CHECK(c == 24);
+    CHECK(pool.grows == 3);
+    CHECK(pool.freeTiles.GetFreeRangeCount() == 1);
+
+    // Everything freed collapses back into a single range
+    pool.freeTiles.AddFree(b, 8);
+    pool.freeTiles.AddFree(a, 16);
+    pool.freeTiles.AddFree(c, 100);
+    CHECK(pool.freeTiles.GetFreeRangeCount() == 1);
+    uint32_t whole = 0;
+    CHECK(pool.freeTiles.Allocate(pool.tiles, &whole) && whole == 0);
+}
+
+void HeapChurnKeepsTilesDisjoint() {
+    MockTilePool pool;
+    struct Range {
+        uint32_t first;
+        uint32_t count;
+    };
+    Range live[16] = {};
+
+    // Heaps of varying size come and go; live ranges must never overlap
+    uint32_t seed = 1;
+    for (int i = 0; i < 2000; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        Range& slot = live[(seed >> 8) % 16];
+        if (slot.count) {
+            pool.freeTiles.AddFree(slot.first, slot.count);
+            slot.count = 0;
+        } else {
+            slot.count = 1 + (seed >> 16) % 64;
+            slot.first = pool.Allocate(slot.count);
+        }
+
+        for (const Range& x : live) {
+            for (const Range& y : live) {
+                if (&x != &y && x.count && y.count) {
+                    CHECK(x.first + x.count <= y.first ||
+                          y.first + y.count <= x.first);
+                }
+            }
+        }
+    }
+    CHECK(pool.tiles <= 2 * 16 * 64);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(FirstFit);
+    RUN_TEST(FreeMergesNeighbours);
+    RUN_TEST(GrowthExtendsFreeTail);
+    RUN_TEST(HeapChurnKeepsTilesDisjoint);
+    return dxiided_test::g_failures;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal checks for the host-side tests, which can't link the Windows-only
+// logging of the layer. Each test binary returns the number of failures.
+namespace dxiided_test {
+
+inline int g_failures = 0;
+
+}  // namespace dxiided_test
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,    \
+                         __LINE__, #cond);                                 \
+            ++dxiided_test::g_failures;                                    \
+        }                                                                  \
+    } while (0)
+
+#define RUN_TEST(fn)                                                       \
+    do {                                                                   \
+        int before = dxiided_test::g_failures;                             \
+        fn();                                                              \
+        std::printf("%s %s\n",                                             \
+                    dxiided_test::g_failures == before ? "PASS" : "FAIL",  \
+                    #fn);                                                  \
+    } while (0)
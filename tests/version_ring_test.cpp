@@ -0,0 +1,134 @@
+#include <cstdint>
+#include <vector>
+
+#include "common/version_ring.hpp"
+#include "test_util.hpp"
+
+using dxiided::VersionRing;
+
+namespace {
+
+// Stands in for the immediate context and submission tracker: serials are
+// signalled in order and the GPU finishes them whenever the test says so
+struct MockQueue {
+    uint64_t submitted{0};
+    uint64_t completed{0};
+    uint64_t waits{0};
+
+    uint64_t Submit() { return ++submitted; }
+    void WaitForSerial(uint64_t serial) {
+        ++waits;
+        completed = serial;
+    }
+};
+
+// What an upload ring flush does with its versions, minus the copies.
+// Returns the version written, checking it isn't read by work in flight.
+size_t Flush(VersionRing* ring, MockQueue* queue) {
+    size_t version = ring->AcquireIdle(queue->completed);
+    if (version == VersionRing::kNoVersion && ring->CanGrow()) {
+        version = ring->Grow();
+    }
+    if (version == VersionRing::kNoVersion) {
+        version = ring->AcquireOldest();
+        if (version == VersionRing::kNoVersion) {
+            return version;
+        }
+        queue->WaitForSerial(ring->GetSerial(version));
+    }
+    CHECK(ring->GetSerial(version) <= queue->completed);
+    ring->MarkFlushed(version);
+    return version;
+}
+
+void ThreeFramesInFlight() {
+    VersionRing ring(4);
+    MockQueue queue;
+    std::vector<uint64_t> frameSerials;
+
+    for (int frame = 0; frame < 32; ++frame) {
+        // The application waits on its own fence for frame N-3 only
+        if (frame >= 3) {
+            queue.completed = frameSerials[frame - 3];
+        }
+        size_t version = Flush(&ring, &queue);
+        CHECK(version != VersionRing::kNoVersion);
+        uint64_t serial = queue.Submit();
+        ring.MarkSubmitted(version, serial);
+        frameSerials.push_back(serial);
+    }
+
+    // One version per frame in flight, and no frame ever waited on the GPU
+    CHECK(ring.GetCount() == 3);
+    CHECK(queue.waits == 0);
+}
+
+void RotatesThroughVersions() {
+    VersionRing ring(4);
+    MockQueue queue;
+
+    for (int i = 0; i < 3; ++i) {
+        size_t version = Flush(&ring, &queue);
+        ring.MarkSubmitted(version, queue.Submit());
+    }
+
+    // Once everything completed the ring keeps rotating rather than
+    // reusing version 0 each time
+    queue.completed = queue.submitted;
+    std::vector<size_t> order;
+    for (int i = 0; i < 6; ++i) {
+        size_t version = Flush(&ring, &queue);
+        ring.MarkSubmitted(version, queue.Submit());
+        queue.completed = queue.submitted;
+        order.push_back(version);
+    }
+    CHECK(order[0] != order[1] && order[1] != order[2] &&
+          order[0] != order[2]);
+    CHECK(order[3] == order[0] && order[4] == order[1]);
+}
+
+void StalledGpuWaitsForOldest() {
+    VersionRing ring(4);
+    MockQueue queue;
+
+    for (int i = 0; i < 4; ++i) {
+        size_t version = Flush(&ring, &queue);
+        ring.MarkSubmitted(version, queue.Submit());
+    }
+    CHECK(ring.GetCount() == 4);
+    CHECK(queue.waits == 0);
+
+    // Nothing completed: the fifth frame waits for the first one only
+    size_t version = Flush(&ring, &queue);
+    CHECK(queue.waits == 1);
+    CHECK(queue.completed == 1);
+    CHECK(version == 0);
+    CHECK(ring.GetCount() == 4);
+}
+
+void UnsubmittedVersionsAreNotWaitedFor() {
+    VersionRing ring(2);
+    MockQueue queue;
+
+    CHECK(Flush(&ring, &queue) != VersionRing::kNoVersion);
+    CHECK(Flush(&ring, &queue) != VersionRing::kNoVersion);
+
+    // Both versions were flushed but never submitted, so no serial exists
+    // that would make either of them free again
+    CHECK(Flush(&ring, &queue) == VersionRing::kNoVersion);
+    CHECK(queue.waits == 0);
+
+    ring.MarkSubmitted(1, queue.Submit());
+    CHECK(Flush(&ring, &queue) == 1);
+    CHECK(queue.waits == 1);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(ThreeFramesInFlight);
+    RUN_TEST(RotatesThroughVersions);
+    RUN_TEST(StalledGpuWaitsForOldest);
+    RUN_TEST(UnsubmittedVersionsAreNotWaitedFor);
+    return dxiided_test::g_failures;
+}